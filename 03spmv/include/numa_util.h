@@ -0,0 +1,346 @@
+/**
+   @file numa_util.h
+   @brief NUMA nodes of pages and CPUs, memory policies and thread pinning
+   @details raw system calls (mbind, move_pages, sched_setaffinity)
+   and /sys/devices/system, so that it does not need libnuma.  the
+   node of a page is found from its physical address, taken from
+   /proc/self/pagemap in the layout of 08mem/get_pfn_info.h (read
+   here rather than by its get_pfn_info, which exits when pagemap
+   cannot be read).  physical addresses are hidden from non-root
+   users (they read as zero), and pagemap may not be readable at
+   all, in which case the node is asked to move_pages instead.
+   anything the environment does not support (e.g., mbind in a
+   container) fails with -1, or makes pages counted as unknown,
+   rather than exiting.
+ */
+
+/* Linux-specific. make it zero on other OSes */
+#if __linux__
+#define HAVE_NUMA 1
+#else
+#define HAVE_NUMA 0
+#endif
+
+#include <dirent.h>
+#include <sched.h>
+#include <errno.h>
+
+#if HAVE_NUMA
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+/* get_pfn_info.h has functions 08mem/mem.cc uses and we do not
+   (we only take pfn_info_t and get_num_pages from it) */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "../../08mem/get_pfn_info.h"
+#pragma GCC diagnostic pop
+#endif
+
+/** @brief the maximum number of nodes we handle */
+enum { numa_max_nodes = 64 };
+/** @brief the maximum number of CPUs we handle */
+enum { numa_max_cpus = 4096 };
+
+/**
+   @brief the number of NUMA nodes
+   @return one plus the largest node number in /sys/devices/system/node
+   (1 if it is not there)
+  */
+static int numa_n_nodes() {
+  int n = 1;
+  for (int d = 0; d < numa_max_nodes; d++) {
+    char path[64];
+    struct stat sb[1];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", d);
+    if (stat(path, sb) == 0) {
+      n = d + 1;
+    }
+  }
+  return n;
+}
+
+/**
+   @brief the node of a CPU
+   @param (cpu) a CPU number
+   @return the node number (0 if it is not found)
+   @details /sys/devices/system/cpu/cpuN has an entry nodeD
+  */
+static int numa_cpu_node(int cpu) {
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR * dp = opendir(path);
+  if (!dp) return 0;
+  int node = 0;
+  struct dirent * de;
+  while ((de = readdir(dp)) != 0) {
+    int d;
+    if (sscanf(de->d_name, "node%d", &d) == 1) {
+      node = d;
+      break;
+    }
+  }
+  closedir(dp);
+  return node;
+}
+
+/**
+   @brief parse a list of CPUs such as 0,2,4-7
+   @param (s) the string to parse
+   @param (cpus) CPU numbers are stored to it
+   @param (max) the number of elements cpus can accomodate
+   @return the number of CPUs, or -1 if s is not a valid list
+  */
+static int numa_parse_cpus(const char * s, int * cpus, int max) {
+  int n = 0;
+  const char * p = s;
+  while (*p) {
+    char * q;
+    long a = strtol(p, &q, 10);
+    long b = a;
+    if (q == p || a < 0) return -1;
+    if (*q == '-') {
+      p = q + 1;
+      b = strtol(p, &q, 10);
+      if (q == p || b < a) return -1;
+    }
+    for (long c = a; c <= b; c++) {
+      if (n == max || c >= numa_max_cpus) return -1;
+      cpus[n++] = (int)c;
+    }
+    if (*q == ',') q++;
+    else if (*q) return -1;
+    p = q;
+  }
+  return n;
+}
+
+/**
+   @brief the CPUs threads are pinned to, in the order of thread numbers
+   @param (spec) compact (CPUs the process may run on, in order),
+   spread (the same CPUs, taking one from each node in turn) or a
+   list of CPUs (see numa_parse_cpus)
+   @param (cpus) CPU numbers are stored to it
+   @param (max) the number of elements cpus can accomodate
+   @return the number of CPUs, or -1 if spec is invalid
+  */
+static int numa_pin_cpus(const char * spec, int * cpus, int max) {
+  if (strcmp(spec, "compact") != 0 && strcmp(spec, "spread") != 0) {
+    return numa_parse_cpus(spec, cpus, max);
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &set) == -1) {
+    perror("sched_getaffinity");
+    return -1;
+  }
+  int n = 0;
+  for (int c = 0; c < CPU_SETSIZE && n < max; c++) {
+    if (CPU_ISSET(c, &set)) {
+      cpus[n++] = c;
+    }
+  }
+  if (strcmp(spec, "spread") == 0) {
+    /* round robin over nodes, keeping the order within a node */
+    int * node = (int *)malloc(sizeof(int) * n);
+    int * taken = (int *)calloc(n, sizeof(int));
+    int * out = (int *)malloc(sizeof(int) * n);
+    for (int i = 0; i < n; i++) {
+      node[i] = numa_cpu_node(cpus[i]);
+    }
+    int m = 0;
+    while (m < n) {
+      int used[numa_max_nodes] = { 0 };
+      for (int i = 0; i < n; i++) {
+        int d = node[i] % numa_max_nodes;
+        if (!taken[i] && !used[d]) {
+          used[d] = 1;
+          taken[i] = 1;
+          out[m++] = cpus[i];
+        }
+      }
+    }
+    memcpy(cpus, out, sizeof(int) * n);
+    free(node);
+    free(taken);
+    free(out);
+  }
+  return n;
+}
+
+/**
+   @brief pin the calling thread to a CPU
+   @param (cpu) the CPU
+   @return 0 if succeed, -1 if failed
+  */
+static int numa_pin_self(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(cpu_set_t), &set);
+}
+
+/**
+   @brief make pages of a range interleaved over all nodes
+   @param (a) the start of the range (page-aligned)
+   @param (sz) the size of the range in bytes
+   @return 0 if succeed, -1 if failed (errno tells why)
+   @details pages not touched yet are placed round robin when they
+   are touched first; pages already touched are moved
+  */
+static int numa_interleave(void * a, size_t sz) {
+#if HAVE_NUMA
+  unsigned long mask = 0;
+  int n = numa_n_nodes();
+  for (int d = 0; d < n; d++) {
+    mask |= 1UL << d;
+  }
+  return (int)syscall(__NR_mbind, a, sz, MPOL_INTERLEAVE, &mask,
+                      (unsigned long)(8 * sizeof(mask)), MPOL_MF_MOVE);
+#else
+  (void)a;
+  (void)sz;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+#if HAVE_NUMA
+/**
+   @brief the node of each memory block (see numa_pfn_node)
+  */
+typedef struct {
+  int ok;                       /**< 1 once read from /sys */
+  unsigned long block_sz;       /**< bytes of a memory block */
+  long n_blocks;                /**< the number of elements of node */
+  signed char * node;           /**< node[b] is the node of block b (-1 if unknown) */
+} numa_block_map_t;
+
+/** @brief the map of memory blocks, read at the first numa_pfn_node */
+static numa_block_map_t numa_block_map = { 0, 0, 0, 0 };
+
+/**
+   @brief the node of a physical page
+   @param (pfn) the page frame number
+   @return the node, or -1 if unknown
+   @details /sys/devices/system/node/nodeD has an entry memoryB for
+   each memory block B (of /sys/devices/system/memory/block_size_bytes)
+   on node D
+  */
+static int numa_pfn_node(uint64_t pfn) {
+  numa_block_map_t * m = &numa_block_map;
+  if (!m->ok) {
+    m->ok = 1;
+    FILE * fp = fopen("/sys/devices/system/memory/block_size_bytes", "r");
+    if (fp) {
+      if (fscanf(fp, "%lx", &m->block_sz) != 1) m->block_sz = 0;
+      fclose(fp);
+    }
+    int n_nodes = numa_n_nodes();
+    for (int d = 0; m->block_sz && d < n_nodes; d++) {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", d);
+      DIR * dp = opendir(path);
+      if (!dp) continue;
+      struct dirent * de;
+      while ((de = readdir(dp)) != 0) {
+        long b;
+        if (sscanf(de->d_name, "memory%ld", &b) != 1 || b < 0) continue;
+        if (b >= m->n_blocks) {
+          long n = (2 * m->n_blocks > b + 1 ? 2 * m->n_blocks : b + 1);
+          m->node = (signed char *)realloc(m->node, n);
+          memset(m->node + m->n_blocks, -1, n - m->n_blocks);
+          m->n_blocks = n;
+        }
+        m->node[b] = (signed char)d;
+      }
+      closedir(dp);
+    }
+  }
+  if (m->block_sz == 0) return -1;
+  uint64_t b = pfn * 4096 / m->block_sz;
+  return (b < (uint64_t)m->n_blocks ? m->node[b] : -1);
+}
+#endif
+
+/**
+   @brief read the pagemap entries of pages of a range
+   @param (begin) the start address of the range
+   @param (end) the end address of the range + 1
+   @param (pfn) the entry of each page is stored to it
+   (get_num_pages(begin, end) elements)
+   @return 0 if succeed, -1 if pagemap cannot be opened or read
+  */
+static int numa_read_pagemap(void * begin, void * end, pfn_info_t * pfn) {
+  long n = get_num_pages(begin, end);
+  int fd = open("/proc/self/pagemap", O_RDONLY);
+  if (fd == -1) return -1;
+  off_t o = (off_t)((uintptr_t)begin / 4096) * (off_t)sizeof(pfn_info_t);
+  size_t sz = sizeof(pfn_info_t) * n;
+  size_t done = 0;
+  while (done < sz) {
+    ssize_t rd = pread(fd, (char *)pfn + done, sz - done, o + done);
+    if (rd <= 0) break;
+    done += rd;
+  }
+  close(fd);
+  return (done == sz ? 0 : -1);
+}
+
+/**
+   @brief count the pages of a range on each node
+   @param (begin) the start address of the range
+   @param (end) the end address of the range + 1
+   @param (count) count[d] (0 <= d < n_nodes) is set to the number
+   of pages on node d, count[n_nodes] to that of pages not present
+   (never touched or swapped out) and count[n_nodes+1] to that of
+   pages whose node is unknown
+   @param (n_nodes) the number of nodes (numa_n_nodes)
+  */
+static void numa_page_nodes(void * begin, void * end, long * count, int n_nodes) {
+  for (int d = 0; d < n_nodes + 2; d++) {
+    count[d] = 0;
+  }
+  if (end <= begin) return;
+#if HAVE_NUMA
+  const long page_size = 4096;
+  long n = get_num_pages(begin, end);
+  pfn_info_t * pfn = (pfn_info_t *)malloc(sizeof(pfn_info_t) * n);
+  /* without pagemap, ask move_pages about all pages */
+  int no_pagemap = (numa_read_pagemap(begin, end, pfn) == -1);
+  char * page0 = (char *)make_a_multiple((off_t)begin, page_size);
+  /* pages whose physical address is hidden */
+  void ** hidden = (void **)malloc(sizeof(void *) * n);
+  long n_hidden = 0;
+  for (long i = 0; i < n; i++) {
+    pfn_info_t pi = pfn[i];
+    if (no_pagemap) {
+      hidden[n_hidden++] = page0 + i * page_size;
+    } else if (!pi.p.present) {
+      count[n_nodes]++;
+    } else if (pi.p.pfn == 0) {
+      hidden[n_hidden++] = page0 + i * page_size;
+    } else {
+      int d = numa_pfn_node(pi.p.pfn);
+      count[(0 <= d && d < n_nodes) ? d : n_nodes + 1]++;
+    }
+  }
+  if (n_hidden > 0) {
+    int * status = (int *)malloc(sizeof(int) * n_hidden);
+    /* nodes == null only asks where the pages are */
+    long r = syscall(__NR_move_pages, 0, n_hidden, hidden, (const int *)0, status, 0);
+    for (long i = 0; i < n_hidden; i++) {
+      int d = (r == 0 ? status[i] : -1);
+      if (r == 0 && d == -ENOENT) {
+        count[n_nodes]++;       /* not present */
+      } else {
+        count[(0 <= d && d < n_nodes) ? d : n_nodes + 1]++;
+      }
+    }
+    free(status);
+  }
+  free(hidden);
+  free(pfn);
+#else
+  count[n_nodes + 1] = ((char *)end - (char *)begin + 4095) / 4096;
+#endif
+}
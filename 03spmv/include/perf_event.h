@@ -0,0 +1,214 @@
+/**
+   @file perf_event.h
+   @brief hardware event counters of the calling thread
+   @details the perf_event_open wrappers of 06axpb/clock.h and
+   08mem/event.h, for a few generic events (see perf_event_names),
+   so that it does not need libpfm.  an event the environment does
+   not support (e.g., in a virtual machine) is left uncounted
+   (its file descriptor is -1), rather than exiting.
+ */
+
+/* Linux-specific. make it zero on other OSes */
+#if __linux__
+#define HAVE_PERF_EVENT 1
+#else
+#define HAVE_PERF_EVENT 0
+#endif
+
+#include <sys/ioctl.h>
+#include <pthread.h>
+
+#if HAVE_PERF_EVENT
+#include <linux/perf_event.h>
+#include <asm/unistd.h>
+#include <sys/syscall.h>
+
+/**
+   this is a wrapper to Linux system call perf_event_open
+ */
+static int perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
+                           int cpu, int group_fd, unsigned long flags) {
+  return (int)syscall(__NR_perf_event_open, hw_event, pid, cpu,
+                      group_fd, flags);
+}
+#endif
+
+/** @brief the maximum number of events counted at a time */
+enum { max_perf_events = 8 };
+
+/**
+   @brief generic events that can be given to mk_perf_event_counters
+ */
+static const char * perf_event_names[] = {
+  "cycles",                     /**< CPU cycles */
+  "instructions",               /**< instructions retired */
+  "llc-loads",                  /**< last level cache read accesses */
+  "llc-misses",                 /**< last level cache read misses */
+  0
+};
+
+/**
+   @brief find the length of the first event name in a comma-separated list
+   @param (p) a comma-separated list of event names
+   @param (len) the length of the first name is stored to it
+   @return the name in perf_event_names, or null if it is not there
+  */
+static const char * perf_event_name_find(const char * p, size_t * len) {
+  const char * q = strchr(p, ',');
+  *len = (q ? (size_t)(q - p) : strlen(p));
+  for (int i = 0; perf_event_names[i]; i++) {
+    if (strlen(perf_event_names[i]) == *len
+        && strncmp(perf_event_names[i], p, *len) == 0) {
+      return perf_event_names[i];
+    }
+  }
+  return 0;
+}
+
+/**
+   @brief check a comma-separated list of event names
+   @param (events) a comma-separated list of event names
+   @return 1 if all of them are in perf_event_names (and there are not
+   too many of them), 0 otherwise
+  */
+static int perf_event_names_ok(const char * events) {
+  int n = 0;
+  for (const char * p = events; *p; n++) {
+    size_t len;
+    if (n == max_perf_events || !perf_event_name_find(p, &len)) {
+      return 0;
+    }
+    p += len + (p[len] == ',');
+  }
+  return 1;
+}
+
+/**
+   @brief counters of the calling thread
+ */
+typedef struct {
+  pthread_t tid;                /**< thread ID this is valid for */
+  int n;                        /**< number of events */
+  const char * events[max_perf_events]; /**< event names */
+  int fds[max_perf_events];     /**< what perf_event_open returned (-1 if not supported) */
+} perf_event_counters_t;
+
+/**
+   @brief values of counters
+ */
+typedef struct {
+  long long values[max_perf_events]; /**< values[i] is the count of events[i] */
+} perf_event_values_t;
+
+/**
+   @brief open a counter of a generic event for the calling thread
+   @param (ev) one of perf_event_names
+   @return the file descriptor, or -1 if ev is unknown or not supported
+  */
+static int mk_perf_event_counter_1(const char * ev) {
+#if HAVE_PERF_EVENT
+  struct perf_event_attr pe;
+  memset(&pe, 0, sizeof(struct perf_event_attr));
+  pe.size = sizeof(struct perf_event_attr);
+  const unsigned long llc_read = (PERF_COUNT_HW_CACHE_LL
+                                  | (PERF_COUNT_HW_CACHE_OP_READ << 8));
+  if (strcmp(ev, "cycles") == 0) {
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.config = PERF_COUNT_HW_CPU_CYCLES;
+  } else if (strcmp(ev, "instructions") == 0) {
+    pe.type = PERF_TYPE_HARDWARE;
+    pe.config = PERF_COUNT_HW_INSTRUCTIONS;
+  } else if (strcmp(ev, "llc-loads") == 0) {
+    pe.type = PERF_TYPE_HW_CACHE;
+    pe.config = llc_read | (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+  } else if (strcmp(ev, "llc-misses") == 0) {
+    pe.type = PERF_TYPE_HW_CACHE;
+    pe.config = llc_read | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+  } else {
+    fprintf(stderr, "%s:%d:warning: unknown event %s\n", __FILE__, __LINE__, ev);
+    return -1;
+  }
+  pe.disabled = 1;
+  pe.exclude_kernel = 1;
+  pe.exclude_hv = 1;
+  int fd = perf_event_open(&pe, 0, -1, -1, 0);
+  if (fd != -1 && (ioctl(fd, PERF_EVENT_IOC_RESET, 0) == -1
+                   || ioctl(fd, PERF_EVENT_IOC_ENABLE, 0) == -1)) {
+    close(fd);
+    fd = -1;
+  }
+  return fd;
+#else
+  (void)ev;
+  return -1;
+#endif
+}
+
+/**
+   @brief make counters of events for the calling thread
+   @param (events) a comma-separated list of perf_event_names
+   (see perf_event_names_ok)
+   @return the counters, whose fds[i] is -1 for an unsupported event
+   @details
+   perf_event_counters_t t = mk_perf_event_counters("cycles,llc-misses");
+   perf_event_values_t v0 = perf_event_counters_get(t);
+      ... do something ...
+   perf_event_values_t v1 = perf_event_counters_get(t);
+   v1.values[0] - v0.values[0] <- the number of CPU cycles in between
+  */
+static perf_event_counters_t mk_perf_event_counters(const char * events) {
+  perf_event_counters_t ec;
+  ec.tid = pthread_self();
+  int n = 0;
+  const char * p = events;
+  while (*p && n < max_perf_events) {
+    size_t len;
+    const char * ev = perf_event_name_find(p, &len);
+    if (ev) {
+      ec.events[n] = ev;
+      ec.fds[n] = mk_perf_event_counter_1(ev);
+      n++;
+    } else {
+      fprintf(stderr, "%s:%d:warning: unknown event %.*s\n",
+              __FILE__, __LINE__, (int)len, p);
+    }
+    p += len + (p[len] == ',');
+  }
+  ec.n = n;
+  return ec;
+}
+
+/**
+   @brief destroy counters
+  */
+static void perf_event_counters_destroy(perf_event_counters_t ec) {
+  for (int i = 0; i < ec.n; i++) {
+    if (ec.fds[i] != -1) {
+      close(ec.fds[i]);
+    }
+  }
+}
+
+/**
+   @brief get all counters
+   @return the values; -1 for events that are not supported or when
+   the caller is not the thread that made ec
+  */
+static perf_event_values_t perf_event_counters_get(perf_event_counters_t ec) {
+  perf_event_values_t v;
+  for (int i = 0; i < max_perf_events; i++) {
+    v.values[i] = -1;
+  }
+  if (!pthread_equal(pthread_self(), ec.tid)) {
+    return v;
+  }
+  for (int i = 0; i < ec.n; i++) {
+    if (ec.fds[i] != -1) {
+      long long c;
+      if (read(ec.fds[i], &c, sizeof(long long)) == (ssize_t)sizeof(long long)) {
+        v.values[i] = c;
+      }
+    }
+  }
+  return v;
+}
@@ -10,9 +10,10 @@
     @returns 1 
     @details multiply each element of v by k
 */
-static int scalar_vec_parallel(real k, vec_t v) {
+template<typename V>
+static int scalar_vec_parallel(real k, basic_vec<V> v) {
   idx_t n = v.n;
-  real * x = v.elems;
+  V * x = v.elems;
 #pragma omp parallel for
   for (idx_t i = 0; i < n; i++) {
     x[i] *= k;
@@ -8,10 +8,17 @@
     @param (k) a scalar
     @param (v) a vector
     @returns 1 
-    @details multiply each element of v by k
+    @details multiply each element of v by k.  there is nothing to
+    reduce, so it is a parallel for whose iterations are also
+    vectorized (simd)
 */
-static int scalar_vec_udr(real k, vec_t v) {
-  /* you don't need to do anything specific for this.
-     just call the parallel version and you are done */
-  return scalar_vec_parallel(k, v);
+template<typename V>
+static int scalar_vec_udr(real k, basic_vec<V> v) {
+  idx_t n = v.n;
+  V * x = v.elems;
+#pragma omp parallel for simd
+  for (idx_t i = 0; i < n; i++) {
+    x[i] *= k;
+  }
+  return 1;
 }
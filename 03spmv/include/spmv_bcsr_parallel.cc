@@ -0,0 +1,40 @@
+/** 
+    @file spmv_bcsr_parallel.cc
+    @brief y = A * x for bcsr with parallel for 
+*/
+
+/** 
+    @brief y = A * x for bcsr with parallel for 
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details each thread computes a contiguous range of block rows
+    taken from A.part, which bcsr_partition has built so that all
+    ranges have about the same number of blocks
+*/
+static int spmv_bcsr_parallel(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_bcsr_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_parts = part->n;
+  int ok = 1;
+#pragma omp parallel for schedule(static, 1) reduction(&&:ok)
+  for (int p = 0; p < n_parts; p++) {
+    long t0 = thread_work_begin();
+    ok = spmv_bcsr_range(A, x, y, part->row_start[p], part->row_start[p + 1]) && ok;
+    /* values of blocks processed, including explicit zeros */
+    thread_work_end(t0, ((A.bcsr.block_row_start[part->row_start[p + 1]]
+                          - A.bcsr.block_row_start[part->row_start[p]])
+                         * A.bcsr.R * A.bcsr.C));
+  }
+  return ok;
+}
+
@@ -0,0 +1,18 @@
+/** 
+    @file spmv_bcsr_task.cc
+    @brief y = A * x for bcsr with tasks
+*/
+
+/** 
+    @brief y = A * x for bcsr with tasks
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_bcsr_task(sparse_t A, vec_t vx, vec_t vy) {
+  /* block rows are already balanced among threads.
+     just call the parallel version */
+  return spmv_bcsr_parallel(A, vx, vy);
+}
+
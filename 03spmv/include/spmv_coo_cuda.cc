@@ -43,14 +43,14 @@ static int spmv_coo_cuda(sparse_t A, vec_t vx, vec_t vy) {
 
   /* this is a serial code for your reference */
   idx_t M = A.M;
-  idx_t nnz = A.nnz;
+  nnz_t nnz = A.nnz;
   coo_elem_t * elems = A.coo.elems;
   real * x = vx.elems;
   real * y = vy.elems;
   for (idx_t i = 0; i < M; i++) {
     y[i] = 0.0;
   }
-  for (idx_t k = 0; k < nnz; k++) {
+  for (nnz_t k = 0; k < nnz; k++) {
     coo_elem_t * e = elems + k;
     idx_t i = e->i;
     idx_t j = e->j;
@@ -3,39 +3,152 @@
   @brief y = A * x for coo with parallel for
  */
 
-/** 
-    @brief y = A * x for coo with parallel for
+/**
+    @brief y = A * x for coo with parallel for, updating y atomically
     @param (A) a sparse matrix
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
 */
-static int spmv_coo_parallel(sparse_t A, vec_t vx, vec_t vy) {
-  fprintf(stderr,
-          "*************************************************************\n"
-          "%s:%d:spmv_coo_parallel:\n"
-          "write a code that performs SPMV for COO format in parallel\n"
-          "using parallel for + atomic directives\n"
-          "*************************************************************\n",
-          __FILE__, __LINE__);
-  exit(1);
-
-  /* this is a serial code for your reference */
+template<typename V>
+static int spmv_coo_parallel_atomic(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
   idx_t M = A.M;
-  idx_t nnz = A.nnz;
-  coo_elem_t * elems = A.coo.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+  nnz_t nnz = A.nnz;
+  basic_coo_elem<V> * elems = A.coo.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+#pragma omp parallel
+  {
+#pragma omp for
+    for (idx_t i = 0; i < M; i++) {
+      y[i] = 0.0;
+    }
+    long t0 = thread_work_begin();
+    nnz_t n_mine = 0;
+#pragma omp for nowait
+    for (nnz_t k = 0; k < nnz; k++) {
+      basic_coo_elem<V> * e = elems + k;
+      idx_t i = e->i;
+      idx_t j = e->j;
+      V ax = (V)((real_acc)e->a * x[j]);
+#pragma omp atomic
+      y[i] += ax;
+      n_mine++;
+    }
+    thread_work_end(t0, n_mine);
   }
-  for (idx_t k = 0; k < nnz; k++) {
-    coo_elem_t * e = elems + k;
+  return 1;
+}
+
+/**
+    @brief b += A * x for elements [k0, k1) of a coo matrix
+    @param (elems) elements of the matrix
+    @param (x) elements of vector x
+    @param (b) y itself or a private copy of y (of type real_acc)
+    @param (k0) the first element
+    @param (k1) the end of elements (one past the last)
+*/
+template<typename V, typename B>
+static inline void spmv_coo_elems(basic_coo_elem<V> * elems, V * x, B * b,
+                                  nnz_t k0, nnz_t k1) {
+  for (nnz_t k = k0; k < k1; k++) {
+    basic_coo_elem<V> * e = elems + k;
     idx_t i = e->i;
     idx_t j = e->j;
-    real  a = e->a;
-    real ax = a * x[j];
-    y[i] += ax;
+    b[i] += (real_acc)e->a * x[j];
+  }
+}
+
+/**
+    @brief y = A * x for coo with parallel for, accumulating into
+    private copies of y
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details chunk p of the elements is accumulated into buffer p
+    without any synchronization (chunk 0 directly into y).  buffers
+    are then combined by a binary tree; in step s, buffer p+s is
+    added to buffer p for every p that is a multiple of 2s.  all
+    threads share the work of each addition, so the reduction takes
+    log(n) steps instead of n additions into y.  see coo_partition
+    for the rows each buffer covers.  the buffers are of real_acc, so
+    with real_lo only chunk 0 accumulates in real_lo.
+*/
+template<typename V>
+static int spmv_coo_parallel_privatized(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  idx_t M = A.M;
+  basic_coo_elem<V> * elems = A.coo.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel
+  {
+#pragma omp for
+    for (idx_t i = 0; i < M; i++) {
+      y[i] = 0.0;
+    }
+#pragma omp for schedule(static, 1)
+    for (int p = 0; p < n_parts; p++) {
+      long t0 = thread_work_begin();
+      if (p == 0) {
+        spmv_coo_elems(elems, x, y, part->elem_start[p], part->elem_start[p + 1]);
+      } else {
+        real_acc * b = part->buf + part->buf_off[p] - part->buf_lo[p];
+        for (idx_t i = part->buf_lo[p]; i < part->buf_hi[p]; i++) {
+          b[i] = 0.0;
+        }
+        spmv_coo_elems(elems, x, b, part->elem_start[p], part->elem_start[p + 1]);
+      }
+      thread_work_end(t0, part->elem_start[p + 1] - part->elem_start[p]);
+    }
+    /* tree reduction of the buffers into y */
+    for (int s = 1; s < n_parts; s *= 2) {
+      for (int p = 0; p + s < n_parts; p += 2 * s) {
+        real_acc * src = part->buf + part->buf_off[p + s] - part->buf_lo[p + s];
+        idx_t lo = part->buf_lo[p + s];
+        idx_t hi = part->buf_hi[p + s];
+        if (p == 0) {
+#pragma omp for nowait
+          for (idx_t i = lo; i < hi; i++) {
+            y[i] += src[i];
+          }
+        } else {
+          real_acc * dst = part->buf + part->buf_off[p] - part->buf_lo[p];
+#pragma omp for nowait
+          for (idx_t i = lo; i < hi; i++) {
+            dst[i] += src[i];
+          }
+        }
+      }
+#pragma omp barrier
+    }
   }
   return 1;
 }
+
+/**
+    @brief y = A * x for coo with parallel for
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details coo_partition has decided whether private copies of y
+    pay off for A; use them if they do and atomic updates otherwise
+*/
+template<typename V>
+static int spmv_coo_parallel(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  if (!A.part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_coo_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  if (A.part->buf) {
+    return spmv_coo_parallel_privatized(A, vx, vy);
+  } else {
+    return spmv_coo_parallel_atomic(A, vx, vy);
+  }
+}
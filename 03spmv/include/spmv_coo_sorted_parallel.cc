@@ -3,16 +3,144 @@
   @brief y = A * x for coo_sorted with parallel for
  */
 
-/** 
+/**
+    @brief y = A * x for a chunk of elements of a coo_sorted matrix
+    @param (A) a sparse matrix in coo_sorted format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (b) the first element of the chunk
+    @param (e) the end of the chunk (one past its last element)
+    @param (carry) an array of two real_accs that receives the sums of
+    the first and last row of the chunk
+    @details this is one segment of a segmented reduction.  rows that
+    lie strictly between the first and the last row of the chunk are
+    complete and are written into y directly.  the first and last row
+    may be shared with the neighboring chunks, so their sums are left
+    in carry[0] and carry[1] and added by spmv_coo_sorted_fixup.
+    the chunk also zeros the empty rows between its elements, the
+    ones between the previous chunk's last row and its first row, and
+    (if it is the last chunk) the ones after its last row, so that y
+    needs no separate initialization pass.
+*/
+template<typename V>
+static void spmv_coo_sorted_chunk(basic_sparse<V> A, V * x, V * y,
+                                  nnz_t b, nnz_t e, real_acc * carry) {
+  basic_coo_elem<V> * elems = A.coo.elems;
+  carry[0] = carry[1] = 0.0;
+  if (b == e) return;
+  long t0 = thread_work_begin();
+  idx_t r0 = elems[b].i;
+  idx_t r1 = elems[e - 1].i;
+  /* empty rows before the first row (the previous chunk zeros none) */
+  for (idx_t i = (b > 0 ? elems[b - 1].i + 1 : 0); i < r0; i++) {
+    y[i] = 0.0;
+  }
+  idx_t cur = r0;
+  real_acc s = 0.0;
+  for (nnz_t k = b; k < e; k++) {
+    basic_coo_elem<V> * el = elems + k;
+    idx_t i = el->i;
+    if (i != cur) {
+      if (cur == r0) {
+        carry[0] = s;
+      } else {
+        y[cur] = (V)s;
+      }
+      for (idx_t h = cur + 1; h < i; h++) {
+        y[h] = 0.0;
+      }
+      cur = i;
+      s = 0.0;
+    }
+    s += (real_acc)el->a * x[el->j];
+  }
+  assert(cur == r1);
+  if (r1 == r0) {
+    carry[0] = s;
+  } else {
+    carry[1] = s;
+  }
+  /* empty rows after the last row of the whole matrix */
+  if (e == A.nnz) {
+    for (idx_t i = r1 + 1; i < A.M; i++) {
+      y[i] = 0.0;
+    }
+  }
+  thread_work_end(t0, e - b);
+}
+
+/**
+    @brief add the sums of rows straddling chunks into y
+    @param (A) a sparse matrix in coo_sorted format
+    @param (y) elements of vector y
+    @param (carry) carry[2p] and carry[2p+1] are the sums of the
+    first and last row of chunk p (see spmv_coo_sorted_chunk)
+    @details it is a serial loop over 2 x (the number of chunks)
+    rows.  all of them are zeroed first, as no chunk wrote them.
+*/
+template<typename V>
+static void spmv_coo_sorted_fixup(basic_sparse<V> A, V * y, real_acc * carry) {
+  sparse_part_t * part = A.part;
+  basic_coo_elem<V> * elems = A.coo.elems;
+  int n_parts = part->n;
+  if (A.nnz == 0) {
+    for (idx_t i = 0; i < A.M; i++) {
+      y[i] = 0.0;
+    }
+    return;
+  }
+  for (int p = 0; p < n_parts; p++) {
+    nnz_t b = part->elem_start[p];
+    nnz_t e = part->elem_start[p + 1];
+    if (b < e) {
+      y[elems[b].i] = 0.0;
+      y[elems[e - 1].i] = 0.0;
+    }
+  }
+  for (int p = 0; p < n_parts; p++) {
+    nnz_t b = part->elem_start[p];
+    nnz_t e = part->elem_start[p + 1];
+    if (b < e) {
+      idx_t r0 = elems[b].i;
+      idx_t r1 = elems[e - 1].i;
+      y[r0] = (V)(y[r0] + carry[2 * p]);
+      if (r1 != r0) {
+        y[r1] = (V)(y[r1] + carry[2 * p + 1]);
+      }
+    }
+  }
+}
+
+/**
     @brief y = A * x for coo_sorted with parallel for
     @param (A) a sparse matrix
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
+    @details a segmented reduction: each thread works on an equal
+    number of elements with no synchronization and only the rows
+    straddling two chunks go through a small serial fix-up.  unlike
+    csr, it never visits empty rows except to zero them.
 */
-static int spmv_coo_sorted_parallel(sparse_t A, vec_t vx, vec_t vy) {
-  /* the same no matter whether elements are sorted or not.
-     call spmv_coo_cuda and we are done */
-  return spmv_coo_parallel(A, vx, vy);
+template<typename V>
+static int spmv_coo_sorted_parallel(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_coo_sorted_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    spmv_coo_sorted_chunk(A, x, y, part->elem_start[p], part->elem_start[p + 1],
+                          part->carry + 2 * p);
+  }
+  spmv_coo_sorted_fixup(A, y, part->carry);
+  return 1;
 }
 
@@ -3,40 +3,85 @@
    @brief y = A * x for coo_sorted with parallel for + user-defined reductions
  */
 
-/** 
+/**
+   @brief a variable-length vector of partial sums of rows straddling
+   chunks, reduced by the user-defined reduction cplus
+ */
+typedef struct {
+  int n;                        /**< number of elements */
+  real_acc * a;                 /**< elements */
+} carry_vec_t;
+
+/* only cplus uses them, which is not there without OpenMP */
+#ifdef _OPENMP
+/**
+   @brief initialize v with zeros, taking the number of elements from orig
+ */
+static void carry_vec_init_from(carry_vec_t * v, carry_vec_t * orig) {
+  int n = orig->n;
+  real_acc * a = (real_acc *)xalloc(sizeof(real_acc) * n);
+  for (int i = 0; i < n; i++) {
+    a[i] = 0.0;
+  }
+  v->n = n;
+  v->a = a;
+}
+
+/**
+   @brief y += x
+   @details x is always a private copy made by carry_vec_init_from
+   and is dead once combined, so we release it here
+ */
+static void carry_vec_add(carry_vec_t * y, carry_vec_t * x) {
+  int n = y->n;
+  for (int i = 0; i < n; i++) {
+    y->a[i] += x->a[i];
+  }
+  xfree(x->a);
+}
+
+#pragma omp declare reduction (cplus : carry_vec_t : carry_vec_add(&omp_out, &omp_in)) \
+  initializer(carry_vec_init_from(&omp_priv, &omp_orig))
+#endif
+
+/**
     @brief y = A * x for coo_sorted with parallel for + user-defined reductions
     @param (A) a sparse matrix
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
+    @details the same segmented reduction as spmv_coo_sorted_parallel.
+    instead of each chunk writing its own slots of a shared carry
+    array, the carries are gathered by a reduction over a small vector
+    (2 elements per chunk), in the same way as vplus reduction of
+    04udr/udr_varlen_vect.c.
 */
-static int spmv_coo_sorted_udr(sparse_t A, vec_t vx, vec_t vy) {
-  fprintf(stderr,
-          "*************************************************************\n"
-          "%s:%d:spmv_coo_sorted_udr:\n"
-          "write a code that performs SPMV for SORTED COO format in parallel\n"
-          "using parallel for directives + user-defined reductions.\n"
-          "*************************************************************\n",
-          __FILE__, __LINE__);
-  exit(1);
-
-  /* this is a serial code for your reference */
-  idx_t M = A.M;
-  idx_t nnz = A.nnz;
-  coo_elem_t * elems = A.coo.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+template<typename V>
+static int spmv_coo_sorted_udr(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_coo_sorted_udr: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+  carry_vec_t c = { 2 * n_parts, part->carry };
+  for (int i = 0; i < c.n; i++) {
+    c.a[i] = 0.0;
   }
-  for (idx_t k = 0; k < nnz; k++) {
-    coo_elem_t * e = elems + k;
-    idx_t i = e->i;
-    idx_t j = e->j;
-    real  a = e->a;
-    real ax = a * x[j];
-    y[i] += ax;
+#pragma omp parallel for schedule(static, 1) reduction(cplus : c)
+  for (int p = 0; p < n_parts; p++) {
+    real_acc carry[2];
+    spmv_coo_sorted_chunk(A, x, y, part->elem_start[p], part->elem_start[p + 1],
+                          carry);
+    c.a[2 * p]     += carry[0];
+    c.a[2 * p + 1] += carry[1];
   }
+  spmv_coo_sorted_fixup(A, y, c.a);
   return 1;
 }
 
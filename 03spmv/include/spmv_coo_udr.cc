@@ -10,7 +10,8 @@
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
 */
-static int spmv_coo_udr(sparse_t A, vec_t vx, vec_t vy) {
+template<typename V>
+static int spmv_coo_udr(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
   fprintf(stderr,
           "*************************************************************\n"
           "%s:%d:spmv_coo_udr: not implemented\n"
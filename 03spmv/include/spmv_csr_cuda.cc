@@ -24,7 +24,7 @@ static int spmv_csr_cuda(sparse_t A, vec_t vx, vec_t vy) {
   
   /* this is a serial code for your reference */
   idx_t M = A.M;
-  idx_t * row_start = A.csr.row_start;
+  nnz_t * row_start = A.csr.row_start;
   csr_elem_t * elems = A.csr.elems;
   real * x = vx.elems;
   real * y = vy.elems;
@@ -32,9 +32,9 @@ static int spmv_csr_cuda(sparse_t A, vec_t vx, vec_t vy) {
     y[i] = 0.0;
   }
   for (idx_t i = 0; i < M; i++) { // conver to kernel + kernel launch
-    idx_t start = row_start[i];
-    idx_t end = row_start[i + 1];
-    for (idx_t k = start; k < end; k++) {
+    nnz_t start = row_start[i];
+    nnz_t end = row_start[i + 1];
+    for (nnz_t k = start; k < end; k++) {
       csr_elem_t * e = elems + k;
       idx_t j = e->j;
       real  a = e->a;
@@ -0,0 +1,37 @@
+/** 
+    @file spmv_csr_delta_parallel.cc
+    @brief y = A * x for csr_delta with parallel for 
+*/
+
+/** 
+    @brief y = A * x for csr_delta with parallel for 
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details each thread computes a contiguous range of rows taken
+    from A.part (see csr_partition).  code_start tells where the
+    columns of the first row of each range begin.
+*/
+static int spmv_csr_delta_parallel(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_delta_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    long t0 = thread_work_begin();
+    spmv_csr_delta_range(A, x, y, part->row_start[p], part->row_start[p + 1]);
+    thread_work_end(t0, (A.csr_delta.row_start[part->row_start[p + 1]]
+                         - A.csr_delta.row_start[part->row_start[p]]));
+  }
+  return 1;
+}
+
@@ -0,0 +1,18 @@
+/** 
+    @file spmv_csr_delta_task.cc
+    @brief y = A * x for csr_delta with tasks
+*/
+
+/** 
+    @brief y = A * x for csr_delta with tasks
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_csr_delta_task(sparse_t A, vec_t vx, vec_t vy) {
+  /* rows are already balanced among threads.
+     just call the parallel version */
+  return spmv_csr_delta_parallel(A, vx, vy);
+}
+
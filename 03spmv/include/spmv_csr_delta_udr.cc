@@ -0,0 +1,18 @@
+/** 
+    @file spmv_csr_delta_udr.cc
+    @brief y = A * x for csr_delta with parallel for + user-defined reductions
+*/
+
+/** 
+    @brief y = A * x for csr_delta with parallel for + user-defined reductions
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_csr_delta_udr(sparse_t A, vec_t vx, vec_t vy) {
+  /* each row is written by exactly one thread, so there is
+     nothing to reduce. just call the parallel version */
+  return spmv_csr_delta_parallel(A, vx, vy);
+}
+
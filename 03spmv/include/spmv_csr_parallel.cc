@@ -9,37 +9,46 @@
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
+    @details each thread computes a contiguous range of rows taken
+    from A.part, which csr_partition has built so that all ranges
+    have about the same number of non-zeros (+ rows).  a plain
+    parallel for over rows would give a thread holding a few heavy
+    rows of an R-MAT matrix most of the work.  each y[i] is written
+    exactly once, so y needs no separate initialization.
 */
-static int spmv_csr_parallel(sparse_t A, vec_t vx, vec_t vy) {
-
-  fprintf(stderr,
-          "*************************************************************\n"
-          "%s:%d:spmv_csr_paralllel:\n"
-          "write a code that performs SPMV with CSR format in parallel\n"
-          "using parallel for directives.\n"
-          "*************************************************************\n",
-          __FILE__, __LINE__);
-  exit(1);
-  
-  /* this is a serial code for your reference */
-  idx_t M = A.M;
-  idx_t * row_start = A.csr.row_start;
-  csr_elem_t * elems = A.csr.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+template<typename V>
+static int spmv_csr_parallel(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
   }
-  for (idx_t i = 0; i < M; i++) {
-    idx_t start = row_start[i];
-    idx_t end = row_start[i + 1];
-    for (idx_t k = start; k < end; k++) {
-      csr_elem_t * e = elems + k;
-      idx_t j = e->j;
-      real  a = e->a;
-      y[i] += a * x[j];
+  nnz_t * row_start = A.csr.row_start;
+  basic_csr_elem<V> * elems = A.csr.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    idx_t row_begin = part->row_start[p];
+    idx_t row_end   = part->row_start[p + 1];
+    long t0 = thread_work_begin();
+    for (idx_t i = row_begin; i < row_end; i++) {
+      nnz_t start = row_start[i];
+      nnz_t end = row_start[i + 1];
+      real_acc s = 0.0;
+      for (nnz_t k = start; k < end; k++) {
+        basic_csr_elem<V> * e = elems + k;
+        idx_t j = e->j;
+        V     a = e->a;
+        s += (real_acc)a * x[j];
+      }
+      y[i] = (V)s;
     }
+    thread_work_end(t0, row_start[row_end] - row_start[row_begin]);
   }
   return 1;
 }
-
@@ -0,0 +1,43 @@
+/** 
+    @file spmv_csr_soa_task.cc
+    @brief y = A * x for csr_soa with tasks
+*/
+
+/** 
+    @brief y = A * x for csr_soa with tasks
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details a task for each range of rows of A.part
+*/
+template<typename V>
+static int spmv_csr_soa_task(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_soa_task: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel
+#pragma omp single
+  {
+    for (int p = 0; p < n_parts; p++) {
+#pragma omp task firstprivate(p)
+      {
+        long t0 = thread_work_begin();
+        spmv_csr_soa_rows(A, x, y, part->row_start[p], part->row_start[p + 1]);
+        thread_work_end(t0, (A.csr_soa.row_start[part->row_start[p + 1]]
+                             - A.csr_soa.row_start[part->row_start[p]]));
+      }
+    }
+#pragma omp taskwait
+  }
+  return 1;
+}
+
@@ -0,0 +1,19 @@
+/** 
+    @file spmv_csr_soa_udr.cc
+    @brief y = A * x for csr_soa with parallel for + user-defined reductions
+*/
+
+/** 
+    @brief y = A * x for csr_soa with parallel for + user-defined reductions
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+template<typename V>
+static int spmv_csr_soa_udr(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  /* each row is written by exactly one thread, so there is
+     nothing to reduce. just call the parallel version */
+  return spmv_csr_soa_parallel(A, vx, vy);
+}
+
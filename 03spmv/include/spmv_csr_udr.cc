@@ -3,16 +3,149 @@
     @brief y = A * x for csr with parallel for + user-defined functions
 */
 
+/** 
+    @brief find hub rows of a csr matrix and partition the others
+    @param (A) a sparse matrix in csr format
+    @param (n) the number of parts
+    @return the hub rows, whose light_row_start has n + 1 elements
+    @details a row is a hub if it has more than a quarter of a
+    part's share of non-zeros (and at least 1024 of them); a single
+    thread computing it would keep all others waiting.  the other
+    rows are partitioned by prefix_partition with hub rows counted
+    as empty, as their non-zeros are split among all threads anyway.
+*/
+template<typename V>
+static csr_hubs_t * mk_csr_hubs(basic_sparse<V> A, int n) {
+  idx_t M = A.M;
+  nnz_t * row_start = A.csr.row_start;
+  nnz_t threshold = A.nnz / (4 * n);
+  if (threshold < 1024) threshold = 1024;
+  /* light[i] = non-zeros of non-hub rows before row i */
+  nnz_t * light = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+  idx_t n_hubs = 0;
+#pragma omp parallel for reduction(+:n_hubs)
+  for (idx_t i = 0; i < M; i++) {
+    nnz_t len = row_start[i + 1] - row_start[i];
+    light[i] = (len > threshold ? 0 : len);
+    n_hubs += (len > threshold);
+  }
+  light[M] = 0;
+  parallel_exclusive_scan(light, M + 1);
+  sparse_part_t * light_part = prefix_partition(M, light, n);
+  xfree(light);
+  csr_hubs_t * H = (csr_hubs_t *)xalloc(sizeof(csr_hubs_t));
+  H->n = n_hubs;
+  H->threshold = threshold;
+  H->row = (idx_t *)xalloc(sizeof(idx_t) * n_hubs);
+  H->elem_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_hubs + 1));
+  H->light_row_start = light_part->row_start;
+  H->sum = (real_acc *)xalloc(sizeof(real_acc) * n_hubs);
+  light_part->row_start = 0;
+  sparse_part_destroy(light_part);
+  idx_t b = 0;
+  H->elem_start[0] = 0;
+  for (idx_t i = 0; i < M; i++) {
+    nnz_t len = row_start[i + 1] - row_start[i];
+    if (len > threshold) {
+      H->row[b] = i;
+      H->elem_start[b + 1] = H->elem_start[b] + len;
+      b++;
+    }
+  }
+  assert(b == n_hubs);
+  printf("%s:%d:mk_csr_hubs: %ld hub rows (> %ld non-zeros) having %ld of %ld non-zeros\n",
+         __FILE__, __LINE__, (long)n_hubs, (long)threshold,
+         (long)H->elem_start[n_hubs], (long)A.nnz);
+  return H;
+}
+
 /** 
     @brief y = A * x for csr with parallel for + user-defined functions
     @param (A) a sparse matrix
     @param (vx) a vector
     @param (vy) a vector
     @returns 1 if succeed, 0 if failed
+    @details ordinary rows are computed as spmv_csr_parallel does,
+    each by a single thread.  the non-zeros of hub rows (see
+    mk_csr_hubs), concatenated, are split into equal chunks, one per
+    thread, and the partial sum of each hub row is accumulated into a
+    vector of hub sums, gathered by the user-defined reduction cplus
+    (spmv_coo_sorted_udr.cc), the same way as vplus of
+    04udr/udr_varlen_vect.c.  when A has no hub rows, it is just
+    spmv_csr_parallel.
 */
-static int spmv_csr_udr(sparse_t A, vec_t vx, vec_t vy) {
-  /* you don't need UDR for CSR format.
-     just call spmv_csr_parallel and you are done */
-  return spmv_csr_parallel(A, vx, vy);
+template<typename V>
+static int spmv_csr_udr(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_csr_udr: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  if (!part->hubs) {
+    part->hubs = mk_csr_hubs(A, part->n);
+  }
+  csr_hubs_t * H = part->hubs;
+  if (H->n == 0) {
+    return spmv_csr_parallel(A, vx, vy);
+  }
+  nnz_t * row_start = A.csr.row_start;
+  basic_csr_elem<V> * elems = A.csr.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+  int n_parts = part->n;
+  nnz_t n_hub_elems = H->elem_start[H->n];
+  carry_vec_t h = { (int)H->n, H->sum };
+  for (int b = 0; b < h.n; b++) {
+    h.a[b] = 0.0;
+  }
+#pragma omp parallel
+  {
+    /* ordinary rows */
+#pragma omp for schedule(static, 1) nowait
+    for (int p = 0; p < n_parts; p++) {
+      long t0 = thread_work_begin();
+      nnz_t n_light = 0;
+      for (idx_t i = H->light_row_start[p]; i < H->light_row_start[p + 1]; i++) {
+        nnz_t start = row_start[i];
+        nnz_t end = row_start[i + 1];
+        if (end - start > H->threshold) continue;
+        real_acc s = 0.0;
+        for (nnz_t k = start; k < end; k++) {
+          s += (real_acc)elems[k].a * x[elems[k].j];
+        }
+        y[i] = (V)s;
+        n_light += end - start;
+      }
+      thread_work_end(t0, n_light);
+    }
+    /* non-zeros of hub rows, split evenly */
+#pragma omp for schedule(static, 1) reduction(cplus : h)
+    for (int p = 0; p < n_parts; p++) {
+      nnz_t q0 = (nnz_t)((long)n_hub_elems * p / n_parts);
+      nnz_t q1 = (nnz_t)((long)n_hub_elems * (p + 1) / n_parts);
+      long t0 = thread_work_begin();
+      /* the hub that has element q0 */
+      int b = 0;
+      while (q0 < q1 && H->elem_start[b + 1] <= q0) b++;
+      for (nnz_t q = q0; q < q1; b++) {
+        nnz_t e = (H->elem_start[b + 1] < q1 ? H->elem_start[b + 1] : q1);
+        /* element q of all hub elements is el[q] */
+        basic_csr_elem<V> * el = elems + row_start[H->row[b]] - H->elem_start[b];
+        real_acc s = 0.0;
+        for (; q < e; q++) {
+          s += (real_acc)el[q].a * x[el[q].j];
+        }
+        h.a[b] += s;
+      }
+      thread_work_end(t0, q1 - q0);
+    }
+  }
+  for (int b = 0; b < h.n; b++) {
+    y[H->row[b]] = (V)h.a[b];
+  }
+  return 1;
 }
 
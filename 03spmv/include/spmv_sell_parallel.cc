@@ -0,0 +1,40 @@
+/** 
+    @file spmv_sell_parallel.cc
+    @brief y = A * x for sell with parallel for 
+*/
+
+/** 
+    @brief y = A * x for sell with parallel for 
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details each thread computes a contiguous range of chunks taken
+    from A.part, which sell_partition has built so that all ranges
+    have about the same number of elements
+*/
+static int spmv_sell_parallel(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_sell_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    long t0 = thread_work_begin();
+    for (idx_t c = part->row_start[p]; c < part->row_start[p + 1]; c++) {
+      spmv_sell_chunk(A, x, y, c);
+    }
+    /* slots processed, including padding */
+    thread_work_end(t0, (A.sell.chunk_start[part->row_start[p + 1]]
+                         - A.sell.chunk_start[part->row_start[p]]));
+  }
+  return 1;
+}
+
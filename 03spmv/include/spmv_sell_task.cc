@@ -0,0 +1,18 @@
+/** 
+    @file spmv_sell_task.cc
+    @brief y = A * x for sell with tasks
+*/
+
+/** 
+    @brief y = A * x for sell with tasks
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_sell_task(sparse_t A, vec_t vx, vec_t vy) {
+  /* chunks are already balanced among threads.
+     just call the parallel version */
+  return spmv_sell_parallel(A, vx, vy);
+}
+
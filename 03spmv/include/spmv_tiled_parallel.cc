@@ -0,0 +1,41 @@
+/** 
+    @file spmv_tiled_parallel.cc
+    @brief y = A * x for tiled with parallel for 
+*/
+
+/** 
+    @brief y = A * x for tiled with parallel for 
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+    @details each thread computes a contiguous range of row blocks
+    taken from A.part (see tiled_partition).  a row block is never
+    shared, so y needs no synchronization.
+*/
+static int spmv_tiled_parallel(sparse_t A, vec_t vx, vec_t vy) {
+  sparse_part_t * part = A.part;
+  if (!part) {
+    fprintf(stderr,
+            "error:%s:%d: spmv_tiled_parallel: matrix not partitioned"
+            " (call sparse_partition first)\n",
+            __FILE__, __LINE__);
+    return 0;
+  }
+  real * x = vx.elems;
+  real * y = vy.elems;
+  int n_parts = part->n;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    long t0 = thread_work_begin();
+    for (idx_t I = part->row_start[p]; I < part->row_start[p + 1]; I++) {
+      spmv_tiled_row_block(A, x, y, I);
+    }
+    nnz_t t_begin = (nnz_t)part->row_start[p] * A.tiled.n_col_segs;
+    nnz_t t_end = (nnz_t)part->row_start[p + 1] * A.tiled.n_col_segs;
+    thread_work_end(t0, (A.tiled.row_start[A.tiled.tile_start[t_end]]
+                         - A.tiled.row_start[A.tiled.tile_start[t_begin]]));
+  }
+  return 1;
+}
+
@@ -0,0 +1,18 @@
+/** 
+    @file spmv_tiled_udr.cc
+    @brief y = A * x for tiled with parallel for + user-defined reductions
+*/
+
+/** 
+    @brief y = A * x for tiled with parallel for + user-defined reductions
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @returns 1 if succeed, 0 if failed
+*/
+static int spmv_tiled_udr(sparse_t A, vec_t vx, vec_t vy) {
+  /* each row block is written by exactly one thread, so there is
+     nothing to reduce. just call the parallel version */
+  return spmv_tiled_parallel(A, vx, vy);
+}
+
@@ -1,16 +1,32 @@
 /**
    @file vec_norm2_task.cc
-   @brief square norm of a vector in serial
+   @brief square norm of a vector with tasks
 */
 
 /** 
-    @brief square norm of a vector in serial
+    @brief the number of elements of a task of vector operations
+    (vec_norm2_task, scalar_vec_task)
+*/
+static const idx_t vec_task_grain = 16384;
+
+/** 
+    @brief square norm of a vector with tasks
     @param (v) a vector
     @returns the square norm of v (v[0]^2 + ... + v[n-1]^2)
+    @details a taskloop of vec_task_grain elements per task, whose
+    partial sums are combined by the taskloop's reduction
 */
-static real vec_norm2_task(vec_t v) {
-  /* you don't need to do anything specific for this.
-     just call the parallel version and you are done */
-  return vec_norm2_parallel(v);
+template<typename V>
+static real_acc vec_norm2_task(basic_vec<V> v) {
+  real_acc s = 0.0;
+  V * x = v.elems;
+  idx_t n = v.n;
+#pragma omp parallel
+#pragma omp single
+#pragma omp taskloop grainsize(vec_task_grain) reduction(+:s)
+  for (idx_t i = 0; i < n; i++) {
+    s += (real_acc)x[i] * x[i];
+  }
+  return s;
 }
 
@@ -3,14 +3,60 @@
    @brief square norm of a vector in parallel using user-defined reduction
 */
 
+/**
+   @brief a compensated (Neumaier) sum, s + c, where c holds the
+   low-order bits lost in s
+ */
+typedef struct {
+  real_acc s;                   /**< the sum */
+  real_acc c;                   /**< the compensation */
+} ksum_t;
+
+/**
+   @brief a += v
+ */
+static inline void ksum_add(ksum_t * a, real_acc v) {
+  real_acc t = a->s + v;
+  if (fabs(a->s) >= fabs(v)) {
+    a->c += (a->s - t) + v;
+  } else {
+    a->c += (v - t) + a->s;
+  }
+  a->s = t;
+}
+
+/* only kplus uses it, which is not there without OpenMP */
+#ifdef _OPENMP
+/**
+   @brief y += x
+ */
+static void ksum_combine(ksum_t * y, ksum_t * x) {
+  ksum_add(y, x->s);
+  y->c += x->c;
+}
+
+#pragma omp declare reduction (kplus : ksum_t : ksum_combine(&omp_out, &omp_in)) \
+  initializer(omp_priv = { 0.0, 0.0 })
+#endif
+
 /** 
     @brief square norm of a vector in parallel using user-defined reduction
     @param (v) a vector
     @returns the square norm of v (v[0]^2 + ... + v[n-1]^2)
+    @details each thread accumulates a compensated sum and they are
+    combined by the user-defined reduction kplus, so the result does
+    not lose digits as n grows, at the price of a few more flops per
+    element than vec_norm2_parallel
 */
-static real vec_norm2_udr(vec_t v) {
-  /* you don't need to do anything specific for this.
-     just call the parallel version and you are done */
-  return vec_norm2_parallel(v);
+template<typename V>
+static real_acc vec_norm2_udr(basic_vec<V> v) {
+  ksum_t s = { 0.0, 0.0 };
+  V * x = v.elems;
+  idx_t n = v.n;
+#pragma omp parallel for reduction(kplus : s)
+  for (idx_t i = 0; i < n; i++) {
+    ksum_add(&s, (real_acc)x[i] * x[i]);
+  }
+  return s.s + s.c;
 }
 
@@ -6,12 +6,24 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if __AVX512F__ || __AVX2__
+#include <x86intrin.h>
+#endif
 
 #if __NVCC__
 /* cuda_util.h incudes various utilities to make CUDA 
@@ -19,14 +31,47 @@
    proceed with rewriting it for CUDA */
 #include "include/cuda_util.h"
 #endif
+/* hardware event counters (--profile) */
+#include "include/perf_event.h"
+/* NUMA nodes of pages and thread pinning (--numa, --pin, --numa-report) */
+#include "include/numa_util.h"
 
 /** @brief type of matrix index (i,j,...)
     @details 
-    for large matrices, we might want to make it 64 bits.
+    for large matrices, we might want to make it 64 bits
+    (compile with -DIDX_64=1).  it is the type of column indices
+    stored for every non-zero, so 32 bits save memory bandwidth.
  */
+#if IDX_64
+typedef long idx_t;
+#define IDX_MAX LONG_MAX
+#else
 typedef int idx_t;
+#define IDX_MAX INT_MAX
+#endif
+/** @brief type of the number of non-zeros and offsets into arrays
+    of non-zeros (row_start etc.)
+    @details 64 bits by default, so a matrix can have more than 2^31
+    non-zeros while rows and columns are still indexed with 32 bits.
+    compile with -DNNZ_32=1 to make it 32 bits (it must not be
+    narrower than idx_t).
+ */
+#if NNZ_32
+typedef int nnz_t;
+#define NNZ_MAX INT_MAX
+#else
+typedef long nnz_t;
+#define NNZ_MAX LONG_MAX
+#endif
+static_assert(sizeof(nnz_t) >= sizeof(idx_t), "nnz_t must not be narrower than idx_t");
 /** @brief type of a matrix element */
 typedef double real;
+/** @brief type in which matrix elements and vectors are stored
+    with --precision mixed */
+typedef float real_lo;
+/** @brief type in which row sums and dot products are accumulated,
+    whichever of real and real_lo the elements are stored in */
+typedef double real_acc;
 
 /** @brief sparse matrix storage format
     @details add more if you want to use another format */
@@ -34,6 +79,12 @@ typedef enum {
   sparse_format_coo,        /**< coordinate list */
   sparse_format_coo_sorted, /**< sorted coordinate list */
   sparse_format_csr,        /**< compressed sparse row */
+  sparse_format_sell,       /**< sliced ELLPACK (SELL-C-sigma) */
+  sparse_format_bcsr,       /**< block compressed sparse row */
+  sparse_format_csr_soa,    /**< compressed sparse row, structure of arrays */
+  sparse_format_csr_delta,  /**< compressed sparse row, delta-encoded columns */
+  sparse_format_tiled,      /**< row blocks x cache-sized column segments */
+  sparse_format_csr_sym,    /**< symmetric, upper triangle (j >= i) in csr */
   sparse_format_invalid,    /**< invalid */
 } sparse_format_t;
 
@@ -56,65 +107,233 @@ typedef enum {
   spmv_algo_invalid             /**< invalid */
 } spmv_algo_t;
 
-/** @brief an element of coordinate list (i, j, a) */
-typedef struct {
+/** @brief how to reorder rows and columns before spmv (--reorder) */
+typedef enum {
+  reorder_kind_none,            /**< keep the order */
+  reorder_kind_rcm,             /**< reverse Cuthill-McKee */
+  reorder_kind_degree,          /**< by decreasing number of non-zeros */
+  reorder_kind_hub,             /**< rows/columns with more non-zeros than average first */
+  reorder_kind_invalid,         /**< invalid */
+} reorder_kind_t;
+
+/** @brief where to place arrays of matrices and vectors (--numa) */
+typedef enum {
+  numa_mode_none,               /**< leave them where they were made */
+  numa_mode_first_touch,        /**< each thread first touches the part it computes */
+  numa_mode_interleave_x,       /**< first-touch, but x interleaved over nodes */
+  numa_mode_invalid,            /**< invalid */
+} numa_mode_t;
+
+/** @brief an element of coordinate list (i, j, a)
+    @details V is the type of the value: real, or real_lo for
+    --precision mixed (the same goes for all the basic_ types below) */
+template<typename V>
+struct basic_coo_elem {
   idx_t i;                      /**< row */
   idx_t j;                      /**< column */
-  real a;                       /**< element */
-} coo_elem_t;
+  V a;                          /**< element */
+};
+typedef basic_coo_elem<real> coo_elem_t;
 
 /** @brief an element of compressed sparse row */
-typedef struct {
+template<typename V>
+struct basic_csr_elem {
   idx_t j;                      /**< column */
-  real a;                       /**< element */
-} csr_elem_t;
+  V a;                          /**< element */
+};
+typedef basic_csr_elem<real> csr_elem_t;
 
 /** @brief sparse matrix in coodinate list format */
-typedef struct {
-  coo_elem_t * elems;           /**< elements array */
+template<typename V>
+struct basic_coo {
+  basic_coo_elem<V> * elems;    /**< elements array */
 #ifdef __NVCC__                 /* defined when compiling with nvcc */
-  coo_elem_t * elems_dev;       /**< copy of elems on device */
+  basic_coo_elem<V> * elems_dev; /**< copy of elems on device */
 #endif
-} coo_t;
+};
+typedef basic_coo<real> coo_t;
 
 /** @brief sparse matrix in compressed row format */
-typedef struct {
-  idx_t * row_start; /**< elems[row_start[i]] is the first element of row i */
-  csr_elem_t * elems;           /**< elements array */
+template<typename V>
+struct basic_csr {
+  nnz_t * row_start; /**< elems[row_start[i]] is the first element of row i */
+  basic_csr_elem<V> * elems;    /**< elements array */
 #ifdef __NVCC__
-  idx_t * row_start_dev;        /**< copy of row_start on device */
-  csr_elem_t * elems_dev;       /**< copy of elems on device */
+  nnz_t * row_start_dev;        /**< copy of row_start on device */
+  basic_csr_elem<V> * elems_dev; /**< copy of elems on device */
 #endif
-} csr_t;
+};
+typedef basic_csr<real> csr_t;
+
+/** @brief sparse matrix in compressed row format, with columns and
+    values in separate arrays
+    @details csr_elem_t pads its 4-byte column to 8 bytes, so a third
+    of csr's element traffic is wasted.  this layout reads exactly
+    sizeof(idx_t) + sizeof(V) bytes per non-zero. */
+template<typename V>
+struct basic_csr_soa {
+  nnz_t * row_start;            /**< col_idx/vals[row_start[i]] is the first element of row i */
+  idx_t * col_idx;              /**< column of each element (64-byte aligned) */
+  V * vals;                     /**< value of each element (64-byte aligned) */
+};
+typedef basic_csr_soa<real> csr_soa_t;
+
+/** @brief sparse matrix in compressed row format, with column
+    indices delta-encoded into 8 or 16-bit words
+    @details the columns of each row are encoded as the differences
+    from the previous column of the row (the first one from 0).  a
+    difference that fits in a word below the escape value (the
+    largest value of the word) takes a single word.  otherwise the
+    escape is followed by the column itself, in sizeof(idx_t)/width
+    words (least significant first).  each row starts at a word of
+    its own, so rows can be decoded independently. */
+typedef struct {
+  int width;                    /**< bytes per word (1 or 2) */
+  nnz_t * row_start;            /**< vals[row_start[i]] is the first value of row i */
+  nnz_t * code_start;           /**< the columns of row i are encoded from word code_start[i] */
+  unsigned char * code;         /**< encoded columns */
+  real * vals;                  /**< value of each element (64-byte aligned) */
+} csr_delta_t;
+
+/** @brief the number of rows in a chunk of sell format 
+    (the number of doubles in an AVX-512 register) */
+static const int sell_C = 8;
+/** @brief rows of sell format are sorted by their lengths 
+    within each window of this many rows (a multiple of sell_C) */
+static const int sell_sigma = 32 * sell_C;
+
+/** @brief sparse matrix in sliced ELLPACK (SELL-C-sigma) format
+    @details rows are sorted by decreasing length within windows of
+    sell_sigma rows, and each sell_C consecutive (sorted) rows make a
+    chunk.  a chunk is padded to the length of its longest row and
+    stored column-major, so the kth elements of its sell_C rows are
+    contiguous and can be processed by a single SIMD instruction.
+    slot r of chunk c holds row row[c * sell_C + r] of A
+    (-1 for slots past the last row). */
+typedef struct {
+  idx_t n_chunks;               /**< number of chunks */
+  nnz_t * chunk_start;          /**< chunk c is col/val[chunk_start[c] ... chunk_start[c+1]-1] */
+  idx_t * row;                  /**< the row stored in each slot */
+  idx_t * row_len;              /**< the number of (non-padding) elements in each slot */
+  idx_t * col;                  /**< column of each element (0 for padding) */
+  real * val;                   /**< value of each element (0 for padding) */
+} sell_t;
 
-/** @brief sparse matrix (in any format) */
+/** @brief sparse matrix in block compressed row format
+    @details the matrix is divided into R x C blocks and those having
+    at least one non-zero are stored in the csr manner, each with its
+    R x C values (row-major) and a single column index.  block row I
+    covers rows [I * R, I * R + R) and a block whose block_col is J
+    covers columns [J * C, J * C + C).  (R, C) is one of the shapes
+    spmv_bcsr_rows is instantiated for (see bcsr_shapes). */
 typedef struct {
+  int R;                        /**< rows of a block */
+  int C;                        /**< columns of a block */
+  idx_t n_block_rows;           /**< number of block rows */
+  nnz_t * block_row_start;      /**< blocks of block row I are [block_row_start[I], block_row_start[I+1]) */
+  idx_t * block_col;            /**< block column of each block */
+  real * val;                   /**< R * C values of each block */
+} bcsr_t;
+
+/** @brief sparse matrix cut into 2D tiles, each reading a cache-sized
+    segment of x
+    @details tile (I, J) covers rows [I * R, I * R + R) and columns
+    [J * W, J * W + W), so the W elements of x it reads stay in the
+    last level cache while it is processed.  the rows of a tile that
+    have elements are stored in the csr manner along with their rows
+    of A, so an empty row costs nothing in any tile.  tile t = I *
+    n_col_segs + J; tiles of a row block are stored one after
+    another, in the order the kernels visit them, so y of a row block
+    stays in the L2 cache until all its tiles are done. */
+typedef struct {
+  idx_t R;                      /**< rows of a row block */
+  idx_t W;                      /**< columns of a column segment */
+  idx_t n_row_blocks;           /**< number of row blocks */
+  idx_t n_col_segs;             /**< number of column segments */
+  nnz_t * tile_start;           /**< rows of tile t are [tile_start[t], tile_start[t+1]) */
+  idx_t * row;                  /**< the row of A of each tile row */
+  nnz_t * row_start;            /**< col/val[row_start[r]] is the first element of tile row r */
+  idx_t * col;                  /**< column of each element (64-byte aligned) */
+  real * val;                   /**< value of each element (64-byte aligned) */
+} tiled_t;
+
+/** @brief rows of a csr matrix so long that their non-zeros are
+    split among threads (see spmv_csr_udr) */
+typedef struct {
+  idx_t n;                 /**< number of hub rows */
+  nnz_t threshold;         /**< rows having more non-zeros than this are hubs */
+  idx_t * row;             /**< the hub rows */
+  nnz_t * elem_start;      /**< non-zeros of all hub rows, concatenated, have those of hub b at [elem_start[b], elem_start[b+1]) */
+  idx_t * light_row_start; /**< part p computes the other rows in [light_row_start[p], light_row_start[p+1]) */
+  real_acc * sum;          /**< the sum of each hub row */
+} csr_hubs_t;
+
+/** @brief partition of a sparse matrix among threads
+    @details built once by sparse_partition before the first
+    parallel spmv and reused in all subsequent iterations */
+typedef struct {
+  int n;                   /**< number of parts */
+  idx_t * row_start;       /**< part p computes rows [row_start[p], row_start[p+1]) */
+  nnz_t * elem_start;      /**< part p reads elems [elem_start[p], elem_start[p+1]) */
+  real_acc * buf;          /**< (coo) private copies of y (null if y is updated atomically) */
+  idx_t * buf_lo;          /**< (coo) buffer p holds rows [buf_lo[p], buf_hi[p]) */
+  idx_t * buf_hi;          /**< (coo) see buf_lo */
+  nnz_t * buf_off;         /**< (coo) buffer p starts at buf[buf_off[p]] */
+  real_acc * carry;        /**< (coo_sorted) partial sums of the first and last row of each part */
+  nnz_t grain;             /**< (csr task) work below which rows are not split into tasks (0 until the first call) */
+  csr_hubs_t * hubs;       /**< (csr udr) hub rows (null until the first call) */
+  int n_colors;            /**< (csr_sym) number of colors of parts (0 if parts scatter into private copies of y) */
+  int * color_start;       /**< (csr_sym) parts of color c are color_part[color_start[c]] ... color_part[color_start[c+1]-1] */
+  int * color_part;        /**< (csr_sym) see color_start */
+} sparse_part_t;
+
+/** @brief sparse matrix (in any format)
+    @details only coo, coo_sorted, csr and csr_soa have instances with
+    V = real_lo (see sparse_lo_t); the other formats always hold
+    real */
+template<typename V>
+struct basic_sparse {
   sparse_format_t format;  /**< format */
   idx_t M;                 /**< number of rows */
   idx_t N;                 /**< number of columns */
-  idx_t nnz;               /**< number of non-zeros */
+  nnz_t nnz;               /**< number of non-zeros */
   union {
-    coo_t coo;             /**< coo or sorted coo */
-    csr_t csr;             /**< csr */
+    basic_coo<V> coo;      /**< coo or sorted coo */
+    basic_csr<V> csr;      /**< csr or csr_sym */
+    sell_t sell;           /**< sell */
+    bcsr_t bcsr;           /**< bcsr */
+    basic_csr_soa<V> csr_soa; /**< csr_soa */
+    csr_delta_t csr_delta; /**< csr_delta */
+    tiled_t tiled;         /**< tiled */
   };
-} sparse_t;
+  sparse_part_t * part;    /**< partition among threads (null until sparse_partition) */
+  int mapped;              /**< 1 if the arrays are not owned by this matrix, i.e., in a cache file mapping (see sparse_cache_load) or shared with another matrix (see csr_sym_transpose), which sparse_destroy does not free */
+};
+typedef basic_sparse<real> sparse_t;
+/** @brief sparse matrix whose elements are rounded to real_lo
+    (--precision mixed) */
+typedef basic_sparse<real_lo> sparse_lo_t;
 
 /** @brief vector */
-typedef struct {
+template<typename V>
+struct basic_vec {
   idx_t n;                 /**< number of elements */
-  real * elems;            /**< array of elements */
+  V * elems;               /**< array of elements */
 #ifdef __NVCC__
-  real * elems_dev;        /**< copy of elems on device */
+  V * elems_dev;           /**< copy of elems on device */
 #endif
-} vec_t;
+};
+typedef basic_vec<real> vec_t;
+/** @brief vector of real_lo (--precision mixed) */
+typedef basic_vec<real_lo> vec_lo_t;
 
 /** 
     @brief command line option
 */
 typedef struct {
-  idx_t M;                 /**< number of rows */
-  idx_t N;                 /**< number of columns */
-  idx_t nnz;               /**< number of non-zero elements */
+  long M;                  /**< number of rows */
+  long N;                  /**< number of columns */
+  long nnz;                /**< number of non-zero elements */
   long repeat;             /**< number of iterations (tA (Ax)) */
   char * format_str;       /**< format string (coo, coo_sorted, csr) */
   sparse_format_t format;  /**< format_str converted to enum */
@@ -125,10 +344,30 @@ typedef struct {
   char * algo_str;         /**< algorithm string (serial, parallel, cuda) */
   spmv_algo_t algo;        /**< algo_str converted to enum */
 
+  char * precision_str;    /**< precision string (double, mixed) */
+  int mixed;               /**< 1 if precision_str is mixed */
+  int fused;               /**< 1 to compute tA (A x) without making tA */
+  int fused_norm;          /**< 1 to fuse normalization of x into the spmv kernels */
+  char * reorder_str;      /**< reordering string (none, rcm, degree, hub) */
+  int reorder;             /**< reorder_str converted to reorder_kind_t */
+  int spmm;                /**< the number of vectors of block power iteration (0 : none) */
+  int profile;             /**< 1 to time each kernel of the main loop and report its roofline position */
+  char * perf_events;      /**< hardware events counted with --profile (see perf_event_names) */
+  double peak_bw;          /**< memory bandwidth --profile compares with (GB/s; 0 : measure it by stream_triad_bw) */
+  int imbalance;           /**< 1 to record the work of each thread in parallel spmv calls (see thread_trace_t) */
+  char * imbalance_dump;   /**< file to dump the per-thread records of --imbalance to */
+  int autotune;            /**< 1 to choose format, algorithm and threads by spmv_autotune */
+  char * tune_file;        /**< file where --autotune looks up and saves its choices */
+  char * numa_str;         /**< placement of arrays (none, first-touch, interleave-x) */
+  int numa;                /**< numa_str converted to numa_mode_t */
+  char * pin;              /**< CPUs threads are pinned to (none, compact, spread or a list) */
+  int numa_report;         /**< 1 to print the nodes of the pages of the matrices and vectors */
+
   char * coo_file;         /**< file */
   char * rmat_str;         /**< a,b,c,d probability of rmat */
   double rmat[2][2];       /**< { { a, b }, { c, d } } probability of rmat */
   char * dump;             /**< file name to dump image (gnuplot) data */
+  char * cache;            /**< file name of the matrix cache (see sparse_cache_load) */
   long dump_points;        /**< max number of points in the dump data */
   long dump_seed;          /**< random number seed to randomly choose elements dumped */
   long seed;               /**< random number generator seed */
@@ -162,6 +401,22 @@ static void * xalloc(size_t sz) {
   return a;
 }
 
+/**
+   @brief aligned malloc + check
+   @param (align) alignment in bytes (a power of two)
+   @param (sz) size to alloc in bytes
+   @return pointer to the allocated memory, which can be freed by xfree
+   @sa xfree
+ */
+static void * xalloc_aligned(size_t align, size_t sz) {
+  void * a = 0;
+  if (posix_memalign(&a, align, (sz > 0 ? sz : 1)) != 0) {
+    perror("posix_memalign");
+    exit(1);
+  }
+  return a;
+}
+
 /**
    @brief wrap free
    @param (a) a pointer returned by calling xalloc
@@ -171,6 +426,42 @@ static void xfree(void * a) {
   free(a);
 }
 
+/**
+   @brief the number of threads a parallel region will use
+   @return the number of threads (1 when compiled without OpenMP)
+ */
+static int get_n_threads() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+/**
+   @brief set the number of threads subsequent parallel regions use
+   @param (n) the number of threads (ignored when compiled without OpenMP)
+ */
+static void set_n_threads(int n) {
+#ifdef _OPENMP
+  omp_set_num_threads(n);
+#else
+  (void)n;
+#endif
+}
+
+/**
+   @brief the number of the calling thread in the current team
+   @return the thread number (0 when compiled without OpenMP)
+ */
+static int get_thread_num() {
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
 /** 
     @brief default values for command line options
 */
@@ -186,10 +477,29 @@ static cmdline_options_t default_opts() {
     .matrix_type = sparse_matrix_type_invalid,
     .algo_str = strdup("serial"),
     .algo = spmv_algo_invalid,
+    .precision_str = strdup("double"),
+    .mixed = 0,
+    .fused = 0,
+    .fused_norm = 0,
+    .reorder_str = strdup("none"),
+    .reorder = 0,
+    .spmm = 0,
+    .profile = 0,
+    .perf_events = strdup("cycles,llc-misses"),
+    .peak_bw = 0.0,
+    .imbalance = 0,
+    .imbalance_dump = 0,
+    .autotune = 0,
+    .tune_file = strdup("spmv_tune.txt"),
+    .numa_str = strdup("none"),
+    .numa = 0,
+    .pin = strdup("none"),
+    .numa_report = 0,
     .coo_file = strdup("mat.txt"),
     .rmat_str = strdup("5,0,1,2"),
     .rmat = { { 0, 0, }, { 0, 0, } },
     .dump = 0,
+    .cache = 0,
     .dump_points = 20000,
     .dump_seed = 91807290723,
     .seed = 4567890123,
@@ -210,9 +520,25 @@ static struct option long_options[] = {
   {"format",      required_argument, 0, 'f' },
   {"matrix-type", required_argument, 0, 't' },
   {"algo",        required_argument, 0, 'a' },
+  {"precision",   required_argument, 0,  0  },
+  {"fused",       no_argument,       0,  0  },
+  {"fused-norm",  no_argument,       0,  0  },
+  {"reorder",     required_argument, 0,  0  },
+  {"spmm",        required_argument, 0,  0  },
+  {"profile",     no_argument,       0,  0  },
+  {"perf-events", required_argument, 0,  0  },
+  {"peak-bw",     required_argument, 0,  0  },
+  {"imbalance",   no_argument,       0,  0  },
+  {"imbalance-dump", required_argument, 0, 0 },
+  {"autotune",    no_argument,       0,  0  },
+  {"tune-file",   required_argument, 0,  0  },
+  {"numa",        required_argument, 0,  0  },
+  {"pin",         required_argument, 0,  0  },
+  {"numa-report", no_argument,       0,  0  },
   {"coo-file",    required_argument, 0,  0  },
   {"rmat",        required_argument, 0,  0  },
   {"dump",        required_argument, 0,  0  },
+  {"cache",       required_argument, 0,  0  },
   {"dump-points", required_argument, 0,  0  },
   {"dump-seed",   required_argument, 0,  0  },
   {"seed",        required_argument, 0, 's'},
@@ -232,6 +558,15 @@ static void cmdline_options_destroy(cmdline_options_t opt) {
   xfree(opt.format_str);
   xfree(opt.matrix_type_str);
   xfree(opt.algo_str);
+  xfree(opt.precision_str);
+  xfree(opt.reorder_str);
+  xfree(opt.perf_events);
+  if (opt.imbalance_dump) {
+    xfree(opt.imbalance_dump);
+  }
+  xfree(opt.tune_file);
+  xfree(opt.numa_str);
+  xfree(opt.pin);
   if (opt.coo_file) {
     xfree(opt.coo_file);
   }
@@ -239,6 +574,9 @@ static void cmdline_options_destroy(cmdline_options_t opt) {
   if (opt.dump) {
     xfree(opt.dump);
   }
+  if (opt.cache) {
+    xfree(opt.cache);
+  }
 }
 
 /**
@@ -259,14 +597,34 @@ static void usage(const char * prog) {
           "  -z,--nnz N         set the number of non-zero elements to N [%ld]\n"
           "  -r,--repeat N      repeat N times [%ld]\n"
           "  -f,--format F      set sparse matrix format to F (%s) [%s]\n"
+          "                     csr is stored in csr_sym if the matrix of -t file or -t one is symmetric\n"
           "  -t,--matrix-type M set matrix type to T (%s) [%s]\n"
           "  -a,--algo A        set algorithm to A (%s) [%s]\n"
-          "  --coo-file F       read matrix from F [%s]\n"
+          "  --fused            compute tA (A x) in a single sweep over A, without making tA (-f csr,csr_soa)\n"
+          "  --fused-norm       take |x| in x = tA y and scale x in the next y = A x, instead of separate passes over x (-f csr,csr_soa)\n"
+          "  --reorder R        reorder rows and columns before spmv and compare with no reordering (none,rcm,degree,hub) [%s]\n"
+          "  --precision P      also run with float values/vectors and double sums and compare lambda (double,mixed; mixed needs -f coo,coo_sorted,csr,csr_soa and no -a cuda) [%s]\n"
+          "  --spmm K           also run block power iteration with K vectors at a time and print K largest lambdas (0,4,8,16) [%d]\n"
+          "  --profile          time each kernel of the main loop, count hardware events and report the roofline position\n"
+          "  --perf-events E    hardware events counted with --profile (cycles,instructions,llc-loads,llc-misses) [%s]\n"
+          "  --peak-bw B        memory bandwidth (GB/s) --profile compares with; 0 measures it by STREAM triad [%.1f]\n"
+          "  --imbalance        record the work of each thread in parallel/task/udr spmv and print the imbalance (max/mean) per format and algorithm\n"
+          "  --imbalance-dump F also write the per-thread records to F (binary; implies --imbalance) [%s]\n"
+          "  --autotune         choose format, algorithm and threads by timing them on a sample of rows (-f and -a are ignored)\n"
+          "  --tune-file F      look up and save the choices of --autotune in F, by matrix fingerprint [%s]\n"
+          "  --numa M           place arrays before spmv (none,first-touch,interleave-x) [%s]\n"
+          "                     first-touch: each thread touches the rows it computes (-f csr,csr_soa,csr_sym)\n"
+          "                     interleave-x: the same, but x is interleaved over all nodes\n"
+          "  --pin P            pin thread t to the t-th CPU of P (none,compact,spread or a list like 0-7,16-23) [%s]\n"
+          "  --numa-report      print how the pages of the matrices and vectors are spread over nodes\n"
+          "  --coo-file F       read matrix from F (use it with -t file), in Matrix Market or\n"
+          "                     lines of 'i j [a]' with 0-based i and j [%s]\n"
           "  --rmat a,b,c,d     set rmat probability [%s]\n"
           "  -s,--seed S        set random seed to S (use it with -t random or -t rmat) [%ld]\n"
           "  --dump F           dump matrix to a gnuplot file [%s]\n"
           "  --dump-points N    dump up to N points to a gnuplot file (use it with --dump) [%ld]\n"
           "  --dump-seed S      set random number seed to S to choose N points (use it with --dump-points) [%ld]\n"
+          "  --cache F          load A and tA from F if it was made with the same options; otherwise make them and save them to F [%s]\n"
           ,
           prog,
           (long)o.M,
@@ -276,12 +634,22 @@ static void usage(const char * prog) {
           sparse_format_strs(),      o.format_str,
           sparse_matrix_type_strs(), o.matrix_type_str, 
           spmv_algo_strs(),          o.algo_str,        
+          o.reorder_str,
+          o.precision_str,
+          o.spmm,
+          o.perf_events,
+          o.peak_bw,
+          (o.imbalance_dump ? o.imbalance_dump : ""),
+          o.tune_file,
+          o.numa_str,
+          o.pin,
           (o.coo_file ? o.coo_file : ""),
           o.rmat_str,
           o.seed,
           (o.dump ? o.dump : ""),
           (long)o.dump_points,
-          o.dump_seed
+          o.dump_seed,
+          (o.cache ? o.cache : "")
           );
   cmdline_options_destroy(o);
 }
@@ -309,6 +677,12 @@ static sparse_format_table_t sparse_format_table = {
     { sparse_format_coo,        "coo" },
     { sparse_format_coo_sorted, "coo_sorted" },
     { sparse_format_csr,        "csr" },
+    { sparse_format_sell,       "sell" },
+    { sparse_format_bcsr,       "bcsr" },
+    { sparse_format_csr_soa,    "csr_soa" },
+    { sparse_format_csr_delta,  "csr_delta" },
+    { sparse_format_tiled,      "tiled" },
+    { sparse_format_csr_sym,    "csr_sym" },
   }
 };
 
@@ -491,6 +865,54 @@ static spmv_algo_t parse_spmv_algo(char * s) {
   return spmv_algo_invalid;
 }
 
+/** 
+    @brief names of reorder_kind_t values
+*/
+static const char * reorder_kind_names[reorder_kind_invalid] = {
+  "none", "rcm", "degree", "hub",
+};
+
+/** 
+    @brief parse a string for reordering and return an enum value
+    @param (s) the string to parse
+*/
+static int parse_reorder_kind(char * s) {
+  for (int i = 0; i < (int)reorder_kind_invalid; i++) {
+    if (strcasecmp(s, reorder_kind_names[i]) == 0) {
+      return i;
+    }
+  }
+  fprintf(stderr,
+          "error:%s:%d: invalid reordering (%s)\n",
+          __FILE__, __LINE__, s);
+  fprintf(stderr, "  must be one of { none,rcm,degree,hub }\n");
+  return reorder_kind_invalid;
+}
+
+/** 
+    @brief names of numa_mode_t values
+*/
+static const char * numa_mode_names[numa_mode_invalid] = {
+  "none", "first-touch", "interleave-x",
+};
+
+/** 
+    @brief parse a string for --numa and return an enum value
+    @param (s) the string to parse
+*/
+static int parse_numa_mode(char * s) {
+  for (int i = 0; i < (int)numa_mode_invalid; i++) {
+    if (strcasecmp(s, numa_mode_names[i]) == 0) {
+      return i;
+    }
+  }
+  fprintf(stderr,
+          "error:%s:%d: invalid NUMA placement (%s)\n",
+          __FILE__, __LINE__, s);
+  fprintf(stderr, "  must be one of { none,first-touch,interleave-x }\n");
+  return numa_mode_invalid;
+}
+
 /** 
     @brief print error meessage during rmat string (a,b,c,d)
 */
@@ -548,6 +970,20 @@ static int parse_rmat_probability(char * rmat_str, double rmat[2][2]) {
   return 1;
 }
 
+/** 
+    @brief check if a format has kernels instantiated with real_lo
+    (--precision mixed)
+    @param (format) a sparse format
+    @return 1 for coo, coo_sorted, csr and csr_soa
+    @sa spmv_lo
+*/
+static int sparse_lo_format_ok(sparse_format_t format) {
+  return (format == sparse_format_coo
+          || format == sparse_format_coo_sorted
+          || format == sparse_format_csr
+          || format == sparse_format_csr_soa);
+}
+
 /** 
     @brief parse command line args
     @param (argc) size of argv
@@ -568,6 +1004,46 @@ static cmdline_options_t parse_args(int argc, char ** argv) {
         if (strcmp(o, "rmat") == 0) {
           xfree(opt.rmat_str);
           opt.rmat_str = strdup(optarg);
+        } else if (strcmp(o, "reorder") == 0) {
+          xfree(opt.reorder_str);
+          opt.reorder_str = strdup(optarg);
+        } else if (strcmp(o, "spmm") == 0) {
+          opt.spmm = atoi(optarg);
+        } else if (strcmp(o, "profile") == 0) {
+          opt.profile = 1;
+        } else if (strcmp(o, "perf-events") == 0) {
+          xfree(opt.perf_events);
+          opt.perf_events = strdup(optarg);
+        } else if (strcmp(o, "peak-bw") == 0) {
+          opt.peak_bw = atof(optarg);
+        } else if (strcmp(o, "autotune") == 0) {
+          opt.autotune = 1;
+        } else if (strcmp(o, "tune-file") == 0) {
+          xfree(opt.tune_file);
+          opt.tune_file = strdup(optarg);
+        } else if (strcmp(o, "numa") == 0) {
+          xfree(opt.numa_str);
+          opt.numa_str = strdup(optarg);
+        } else if (strcmp(o, "pin") == 0) {
+          xfree(opt.pin);
+          opt.pin = strdup(optarg);
+        } else if (strcmp(o, "numa-report") == 0) {
+          opt.numa_report = 1;
+        } else if (strcmp(o, "imbalance") == 0) {
+          opt.imbalance = 1;
+        } else if (strcmp(o, "imbalance-dump") == 0) {
+          if (opt.imbalance_dump) {
+            xfree(opt.imbalance_dump);
+          }
+          opt.imbalance_dump = strdup(optarg);
+          opt.imbalance = 1;
+        } else if (strcmp(o, "fused") == 0) {
+          opt.fused = 1;
+        } else if (strcmp(o, "fused-norm") == 0) {
+          opt.fused_norm = 1;
+        } else if (strcmp(o, "precision") == 0) {
+          xfree(opt.precision_str);
+          opt.precision_str = strdup(optarg);
         } else if (strcmp(o, "coo-file") == 0) {
           xfree(opt.coo_file);
           opt.coo_file = strdup(optarg);
@@ -576,6 +1052,11 @@ static cmdline_options_t parse_args(int argc, char ** argv) {
             xfree(opt.dump);
           }
           opt.dump = strdup(optarg);
+        } else if (strcmp(o, "cache") == 0) {
+          if (opt.cache) {
+            xfree(opt.cache);
+          }
+          opt.cache = strdup(optarg);
         } else if (strcmp(o, "dump-points") == 0) {
           opt.dump_points = atol(optarg);
         } else if (strcmp(o, "dump-seed") == 0) {
@@ -644,6 +1125,126 @@ static cmdline_options_t parse_args(int argc, char ** argv) {
     opt.error = 1;
     return opt;
   }
+  /* --autotune chooses the format itself */
+  if (opt.fused && !opt.autotune
+      && opt.format != sparse_format_csr
+      && opt.format != sparse_format_csr_soa) {
+    fprintf(stderr,
+            "error:%s:%d: --fused needs a row-major format (csr or csr_soa)\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  if (opt.fused_norm && !opt.autotune
+      && opt.format != sparse_format_csr
+      && opt.format != sparse_format_csr_soa) {
+    fprintf(stderr,
+            "error:%s:%d: --fused-norm needs a row-major format (csr or csr_soa)\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  if ((opt.fused || opt.fused_norm) && opt.algo == spmv_algo_cuda) {
+    fprintf(stderr,
+            "error:%s:%d: --fused and --fused-norm are not supported with cuda\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  if (opt.spmm != 0 && opt.spmm != 4 && opt.spmm != 8 && opt.spmm != 16) {
+    fprintf(stderr,
+            "error:%s:%d: invalid number of vectors for --spmm (%d)\n",
+            __FILE__, __LINE__, opt.spmm);
+    fprintf(stderr, "  must be one of { 0,4,8,16 }\n");
+    opt.error = 1;
+    return opt;
+  }
+  if (opt.spmm && opt.algo == spmv_algo_cuda) {
+    fprintf(stderr,
+            "error:%s:%d: --spmm is not supported with cuda\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  if (!perf_event_names_ok(opt.perf_events)) {
+    fprintf(stderr,
+            "error:%s:%d: invalid events for --perf-events (%s)\n",
+            __FILE__, __LINE__, opt.perf_events);
+    fprintf(stderr, "  must be a comma-separated list of { ");
+    for (int i = 0; perf_event_names[i]; i++) {
+      fprintf(stderr, "%s%s", (i ? "," : ""), perf_event_names[i]);
+    }
+    fprintf(stderr, " }\n");
+    opt.error = 1;
+    return opt;
+  }
+  if (opt.autotune && opt.algo == spmv_algo_cuda) {
+    fprintf(stderr,
+            "error:%s:%d: --autotune does not consider cuda\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  if (!(opt.peak_bw >= 0.0)) {
+    fprintf(stderr,
+            "error:%s:%d: invalid bandwidth for --peak-bw (%f)\n",
+            __FILE__, __LINE__, opt.peak_bw);
+    opt.error = 1;
+    return opt;
+  }
+  if (opt.profile && opt.algo == spmv_algo_cuda) {
+    /* kernel launches return before kernels finish */
+    fprintf(stderr,
+            "error:%s:%d: --profile is not supported with cuda\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
+  opt.reorder = parse_reorder_kind(opt.reorder_str);
+  if (opt.reorder == reorder_kind_invalid) {
+    opt.error = 1;
+    return opt;
+  }
+  opt.numa = parse_numa_mode(opt.numa_str);
+  if (opt.numa == numa_mode_invalid) {
+    opt.error = 1;
+    return opt;
+  }
+  if (strcmp(opt.pin, "none") != 0) {
+    int * cpus = (int *)xalloc(sizeof(int) * numa_max_cpus);
+    int n_cpus = numa_pin_cpus(opt.pin, cpus, numa_max_cpus);
+    xfree(cpus);
+    if (n_cpus < 1) {
+      fprintf(stderr,
+              "error:%s:%d: invalid CPUs for --pin (%s)\n",
+              __FILE__, __LINE__, opt.pin);
+      fprintf(stderr, "  must be one of { none,compact,spread } or a list like 0-7,16-23\n");
+      opt.error = 1;
+      return opt;
+    }
+  }
+  if (strcasecmp(opt.precision_str, "mixed") == 0) {
+    opt.mixed = 1;
+  } else if (strcasecmp(opt.precision_str, "double") != 0) {
+    fprintf(stderr,
+            "error:%s:%d: invalid precision (%s)\n",
+            __FILE__, __LINE__, opt.precision_str);
+    fprintf(stderr, "  must be one of { double,mixed }\n");
+    opt.error = 1;
+    return opt;
+  }
+  /* the real_lo kernels exist only for these (see spmv_lo);
+     --autotune chooses among them */
+  if (opt.mixed
+      && ((!opt.autotune && !sparse_lo_format_ok(opt.format))
+          || opt.algo == spmv_algo_cuda)) {
+    fprintf(stderr,
+            "error:%s:%d: --precision mixed needs -f coo, coo_sorted, csr or csr_soa"
+            " and an algorithm other than cuda\n",
+            __FILE__, __LINE__);
+    opt.error = 1;
+    return opt;
+  }
   return opt;
 }
 
@@ -651,37 +1252,174 @@ static cmdline_options_t parse_args(int argc, char ** argv) {
     @brief make an invalid matrix
 */
 static sparse_t mk_sparse_invalid() {
-  sparse_t A = { sparse_format_invalid, 0, 0, 0, { } };
+  sparse_t A = { sparse_format_invalid, 0, 0, 0, { }, 0, 0 };
   return A;
 }
 
+/** 
+    @brief check if a matrix of the given shape can be represented
+    @param (what) the function asking (for the error message)
+    @param (M) the number of rows
+    @param (N) the number of columns
+    @param (nnz) the number of non-zeros
+    @return 1 if M and N fit in idx_t and nnz in nnz_t, 0 otherwise
+    @details M + 1 and N + 1 must fit too, as row_start and
+    transposes have that many elements.  call it before making a
+    matrix, so that an index does not silently wrap around.
+*/
+static int sparse_shape_ok(const char * what, long M, long N, long nnz) {
+  if (M < 0 || N < 0 || nnz < 0) {
+    fprintf(stderr,
+            "error:%s:%d: %s: negative shape %ld x %ld with %ld non-zeros\n",
+            __FILE__, __LINE__, what, M, N, nnz);
+    return 0;
+  }
+  if (M >= (long)IDX_MAX || N >= (long)IDX_MAX) {
+    fprintf(stderr,
+            "error:%s:%d: %s: %ld x %ld matrix does not fit %d-bit indices"
+            " (compile with -DIDX_64=1)\n",
+            __FILE__, __LINE__, what, M, N, (int)(8 * sizeof(idx_t)));
+    return 0;
+  }
+  if (nnz > (long)NNZ_MAX) {
+    fprintf(stderr,
+            "error:%s:%d: %s: %ld non-zeros do not fit %d-bit offsets"
+            " (compile without -DNNZ_32)\n",
+            __FILE__, __LINE__, what, nnz, (int)(8 * sizeof(nnz_t)));
+    return 0;
+  }
+  return 1;
+}
+
 /** 
     @brief destroy coo 
 */
-static void coo_destroy(sparse_t A) {
+template<typename V>
+static void coo_destroy(basic_sparse<V> A) {
   xfree(A.coo.elems);
 }
 
 /** 
     @brief destroy csr
 */
-static void csr_destroy(sparse_t A) {
+template<typename V>
+static void csr_destroy(basic_sparse<V> A) {
   xfree(A.csr.row_start);
   xfree(A.csr.elems);
 }
 
+/** 
+    @brief destroy sell
+*/
+static void sell_destroy(sparse_t A) {
+  xfree(A.sell.chunk_start);
+  xfree(A.sell.row);
+  xfree(A.sell.row_len);
+  xfree(A.sell.col);
+  xfree(A.sell.val);
+}
+
+/** 
+    @brief destroy bcsr
+*/
+static void bcsr_destroy(sparse_t A) {
+  xfree(A.bcsr.block_row_start);
+  xfree(A.bcsr.block_col);
+  xfree(A.bcsr.val);
+}
+
+/** 
+    @brief destroy csr_soa
+*/
+template<typename V>
+static void csr_soa_destroy(basic_sparse<V> A) {
+  xfree(A.csr_soa.row_start);
+  xfree(A.csr_soa.col_idx);
+  xfree(A.csr_soa.vals);
+}
+
+/** 
+    @brief destroy csr_delta
+*/
+static void csr_delta_destroy(sparse_t A) {
+  xfree(A.csr_delta.row_start);
+  xfree(A.csr_delta.code_start);
+  xfree(A.csr_delta.code);
+  xfree(A.csr_delta.vals);
+}
+
+/** 
+    @brief destroy tiled
+*/
+static void tiled_destroy(sparse_t A) {
+  xfree(A.tiled.tile_start);
+  xfree(A.tiled.row);
+  xfree(A.tiled.row_start);
+  xfree(A.tiled.col);
+  xfree(A.tiled.val);
+}
+
+/** 
+    @brief destroy the partition of a sparse matrix
+*/
+static void sparse_part_destroy(sparse_part_t * part) {
+  if (part) {
+    xfree(part->row_start);
+    xfree(part->elem_start);
+    if (part->buf) {
+      xfree(part->buf);
+      xfree(part->buf_lo);
+      xfree(part->buf_hi);
+      xfree(part->buf_off);
+    }
+    if (part->carry) {
+      xfree(part->carry);
+    }
+    if (part->hubs) {
+      xfree(part->hubs->row);
+      xfree(part->hubs->elem_start);
+      xfree(part->hubs->light_row_start);
+      xfree(part->hubs->sum);
+      xfree(part->hubs);
+    }
+    if (part->color_start) {
+      xfree(part->color_start);
+      xfree(part->color_part);
+    }
+    xfree(part);
+  }
+}
+
 /** 
     @brief destroy sparse matrix in any format
 */
 static void sparse_destroy(sparse_t A) {
+  sparse_part_destroy(A.part);
+  if (A.mapped) return;
   switch (A.format) {
   case sparse_format_coo:
   case sparse_format_coo_sorted:
     coo_destroy(A);
     break;
   case sparse_format_csr:
+  case sparse_format_csr_sym:
     csr_destroy(A);
     break;
+  case sparse_format_sell:
+    sell_destroy(A);
+    break;
+  case sparse_format_bcsr:
+    bcsr_destroy(A);
+    break;
+  case sparse_format_csr_soa:
+    csr_soa_destroy(A);
+    break;
+  case sparse_format_csr_delta:
+    csr_delta_destroy(A);
+    break;
+  case sparse_format_tiled:
+    tiled_destroy(A);
+    break;
   default:
     fprintf(stderr,
             "error:%s:%d: sparse_destroy: invalid format %d\n",
@@ -695,8 +1433,9 @@ static void sparse_destroy(sparse_t A) {
     @param (A) a sparse matrix in coo format
     @return size of the matrix in bytes
 */
-static size_t sparse_coo_size(sparse_t A) {
-  size_t sz = sizeof(coo_elem_t) * A.nnz;
+template<typename V>
+static size_t sparse_coo_size(basic_sparse<V> A) {
+  size_t sz = sizeof(basic_coo_elem<V>) * A.nnz;
   return sz;
 }
 
@@ -705,12 +1444,78 @@ static size_t sparse_coo_size(sparse_t A) {
     @param (A) a sparse matrix in csr format
     @return size of the matrix in bytes
 */
-static size_t sparse_csr_size(sparse_t A) {
-  size_t nnz_sz = sizeof(csr_elem_t) * A.nnz;
-  size_t row_start_sz = sizeof(idx_t) * (A.M + 1);
+template<typename V>
+static size_t sparse_csr_size(basic_sparse<V> A) {
+  size_t nnz_sz = sizeof(basic_csr_elem<V>) * A.nnz;
+  size_t row_start_sz = sizeof(nnz_t) * (A.M + 1);
+  return nnz_sz + row_start_sz;
+}
+
+/** 
+    @brief size (in bytes) of a sparse matrix in sell format
+    @param (A) a sparse matrix in sell format
+    @return size of the matrix in bytes (including padding)
+*/
+static size_t sparse_sell_size(sparse_t A) {
+  idx_t n_chunks = A.sell.n_chunks;
+  size_t n_elems = A.sell.chunk_start[n_chunks];
+  size_t elems_sz = (sizeof(idx_t) + sizeof(real)) * n_elems;
+  size_t chunk_sz = sizeof(nnz_t) * (n_chunks + 1);
+  size_t row_sz = 2 * sizeof(idx_t) * n_chunks * sell_C;
+  return elems_sz + chunk_sz + row_sz;
+}
+
+/** 
+    @brief size (in bytes) of a sparse matrix in bcsr format
+    @param (A) a sparse matrix in bcsr format
+    @return size of the matrix in bytes (including explicit zeros in blocks)
+*/
+static size_t sparse_bcsr_size(sparse_t A) {
+  idx_t n_block_rows = A.bcsr.n_block_rows;
+  size_t n_blocks = A.bcsr.block_row_start[n_block_rows];
+  size_t block_sz = (sizeof(idx_t) + sizeof(real) * A.bcsr.R * A.bcsr.C) * n_blocks;
+  size_t row_start_sz = sizeof(nnz_t) * (n_block_rows + 1);
+  return block_sz + row_start_sz;
+}
+
+/** 
+    @brief size (in bytes) of a sparse matrix in csr_soa format
+    @param (A) a sparse matrix in csr_soa format
+    @return size of the matrix in bytes
+*/
+template<typename V>
+static size_t sparse_csr_soa_size(basic_sparse<V> A) {
+  size_t nnz_sz = (sizeof(idx_t) + sizeof(V)) * A.nnz;
+  size_t row_start_sz = sizeof(nnz_t) * (A.M + 1);
   return nnz_sz + row_start_sz;
 }
 
+/** 
+    @brief size (in bytes) of a sparse matrix in csr_delta format
+    @param (A) a sparse matrix in csr_delta format
+    @return size of the matrix in bytes (with columns compressed)
+*/
+static size_t sparse_csr_delta_size(sparse_t A) {
+  size_t code_sz = (size_t)A.csr_delta.width * A.csr_delta.code_start[A.M];
+  size_t vals_sz = sizeof(real) * A.nnz;
+  size_t row_start_sz = 2 * sizeof(nnz_t) * (A.M + 1);
+  return code_sz + vals_sz + row_start_sz;
+}
+
+/** 
+    @brief size (in bytes) of a sparse matrix in tiled format
+    @param (A) a sparse matrix in tiled format
+    @return size of the matrix in bytes
+*/
+static size_t sparse_tiled_size(sparse_t A) {
+  size_t n_tiles = (size_t)A.tiled.n_row_blocks * A.tiled.n_col_segs;
+  size_t n_rows = A.tiled.tile_start[n_tiles];
+  size_t nnz_sz = (sizeof(idx_t) + sizeof(real)) * A.nnz;
+  size_t row_sz = sizeof(idx_t) * n_rows + sizeof(nnz_t) * (n_rows + 1);
+  size_t tile_sz = sizeof(nnz_t) * (n_tiles + 1);
+  return nnz_sz + row_sz + tile_sz;
+}
+
 /** 
     @brief size (in bytes) of a sparse matrix
     @param (A) a sparse matrix
@@ -722,7 +1527,18 @@ static size_t sparse_size(sparse_t A) {
   case sparse_format_coo_sorted:
     return sparse_coo_size(A);
   case sparse_format_csr:
+  case sparse_format_csr_sym:
     return sparse_csr_size(A);
+  case sparse_format_sell:
+    return sparse_sell_size(A);
+  case sparse_format_bcsr:
+    return sparse_bcsr_size(A);
+  case sparse_format_csr_soa:
+    return sparse_csr_soa_size(A);
+  case sparse_format_csr_delta:
+    return sparse_csr_delta_size(A);
+  case sparse_format_tiled:
+    return sparse_tiled_size(A);
   default:
     fprintf(stderr,
             "error:%s:%d: sparse_size: invalid format %d\n",
@@ -731,37 +1547,148 @@ static size_t sparse_size(sparse_t A) {
   }
 }
 
+/** 
+    @brief the number of non-zeros of the matrix A represents
+    @param (A) a sparse matrix
+    @return A.nnz, except for csr_sym, where each element off the
+    diagonal stands for two
+    @details the columns of a row of csr_sym are sorted and j >= i,
+    so a diagonal element is the first of its row
+*/
+static nnz_t sparse_nnz_full(sparse_t A) {
+  if (A.format != sparse_format_csr_sym) return A.nnz;
+  nnz_t * row_start = A.csr.row_start;
+  csr_elem_t * elems = A.csr.elems;
+  nnz_t n_diag = 0;
+#pragma omp parallel for reduction(+:n_diag)
+  for (idx_t i = 0; i < A.M; i++) {
+    n_diag += (row_start[i] < row_start[i + 1] && elems[row_start[i]].j == i);
+  }
+  return 2 * A.nnz - n_diag;
+}
+
+/** 
+    @brief how much smaller A is than the same matrix in csr format
+    @param (A) a sparse matrix
+    @return (size in csr) / sparse_size(A)
+*/
+static double sparse_compression_ratio(sparse_t A) {
+  size_t csr_sz = sizeof(csr_elem_t) * sparse_nnz_full(A) + sizeof(nnz_t) * (A.M + 1);
+  size_t sz = sparse_size(A);
+  return (sz > 0 ? csr_sz / (double)sz : 1.0);
+}
+
+/** 
+    @brief the number of bytes y = A * x moves between the memory and
+    the processor at least
+    @param (A) a sparse matrix
+    @return the size of A, plus x read once and y written once
+*/
+static size_t sparse_spmv_traffic(sparse_t A) {
+  return sparse_size(A) + sizeof(real) * ((size_t)A.N + (size_t)A.M);
+}
+
 /**
    @brief destroy vector
  */
-static void vec_destroy(vec_t x) {
+template<typename V>
+static void vec_destroy(basic_vec<V> x) {
   xfree(x.elems);
 }
 
 /** 
-    @brief make a uniform random coo matrix
-    @param (M) number of rows
-    @param (N) number of columns
-    @param (nnz) number of non-zeros
-    @param (rg) random number state (passed to erand48)
-    @return a sparse matrix in coo format
+    @brief the next number of a splitmix64 sequence
+    @param (s) the state
+    @return a 64-bit pseudo random number
 */
-static sparse_t mk_coo_random(idx_t M, idx_t N, idx_t nnz,
-                              unsigned short rg[3]) {
-  printf("%s:%d:mk_coo_random starts ...\n", __FILE__, __LINE__);
-  long t0 = cur_time_ns();
-  coo_elem_t * elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
-  for (idx_t k = 0; k < nnz; k++) {
-    idx_t i = nrand48(rg) % M;
-    idx_t j = nrand48(rg) % N;
-    real  a = erand48(rg);
-    coo_elem_t * e = elems + k;
-    e->i = i;
-    e->j = j;
+static inline uint64_t splitmix64(uint64_t * s) {
+  uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/** 
+    @brief a counter-based random number generator state
+    @details the numbers for the kth element are a function of
+    (key, k) only (see ctr_rng_at), so elements can be generated in
+    any order by any number of threads and still come out the same
+*/
+typedef struct {
+  uint64_t s;                   /**< splitmix64 state */
+} ctr_rng_t;
+
+/** 
+    @brief make a key for ctr_rng_at from an erand48 state
+    @param (rg) random number state (passed to erand48).  it is
+    advanced once, so the numbers drawn from it afterwards (e.g.,
+    for x) do not depend on how many elements were generated
+    @return a key
+*/
+static uint64_t ctr_rng_key(unsigned short rg[3]) {
+  uint64_t key = ((uint64_t)rg[0] << 32) | ((uint64_t)rg[1] << 16) | (uint64_t)rg[2];
+  key ^= (uint64_t)nrand48(rg) << 48;
+  return key;
+}
+
+/** 
+    @brief the generator of the kth element
+    @param (key) a key made by ctr_rng_key
+    @param (k) the index of the element
+    @return a generator from which the kth element draws its numbers
+*/
+static inline ctr_rng_t ctr_rng_at(uint64_t key, uint64_t k) {
+  uint64_t s = key;
+  uint64_t h = splitmix64(&s) ^ k;
+  ctr_rng_t g = { splitmix64(&h) };
+  return g;
+}
+
+/** 
+    @brief a uniform random number in [0,1)
+*/
+static inline double ctr_rng_real(ctr_rng_t * g) {
+  return (splitmix64(&g->s) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/** 
+    @brief a uniform random integer in [0,n)
+*/
+static inline idx_t ctr_rng_idx(ctr_rng_t * g, idx_t n) {
+  return (idx_t)(((splitmix64(&g->s) >> 32) * (uint64_t)n) >> 32);
+}
+
+/** 
+    @brief make a uniform random coo matrix
+    @param (M) number of rows
+    @param (N) number of columns
+    @param (nnz) number of non-zeros
+    @param (rg) random number state (the key of the counter-based
+    generator is drawn from it; see ctr_rng_key)
+    @return a sparse matrix in coo format
+    @details elements are generated in parallel, the kth one from
+    ctr_rng_at(key, k), so the matrix is the same whatever the
+    number of threads is
+*/
+static sparse_t mk_coo_random(idx_t M, idx_t N, nnz_t nnz,
+                              unsigned short rg[3]) {
+  printf("%s:%d:mk_coo_random starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  coo_elem_t * elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+  uint64_t key = ctr_rng_key(rg);
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    ctr_rng_t g = ctr_rng_at(key, k);
+    idx_t i = ctr_rng_idx(&g, M);
+    idx_t j = ctr_rng_idx(&g, N);
+    real  a = ctr_rng_real(&g);
+    coo_elem_t * e = elems + k;
+    e->i = i;
+    e->j = j;
     e->a = a;
   }
   coo_t coo = { elems };
-  sparse_t A = { sparse_format_coo, M, N, nnz, { .coo = coo } };
+  sparse_t A = { sparse_format_coo, M, N, nnz, { .coo = coo }, 0, 0 };
   long t1 = cur_time_ns();
   printf("%s:%d:mk_coo_random ends. took %.3f sec\n",
          __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -785,8 +1712,8 @@ typedef struct {
    {1,0} with probability p[1][0] and
    {1,1} with probability p[1][1]
  */
-static idx_pair_t rmat_choose_01(double p[2][2], unsigned short rg[3]) {
-  double x = erand48(rg);
+static idx_pair_t rmat_choose_01(double p[2][2], ctr_rng_t * g) {
+  double x = ctr_rng_real(g);
   double q = 0.0;
   for (int i = 0; i < 2; i++) {
     for (int j = 0; j < 2; j++) {
@@ -807,7 +1734,7 @@ static idx_pair_t rmat_choose_01(double p[2][2], unsigned short rg[3]) {
     @param (M) the maximum value i can take plus 1
     @param (N) the maximum value j can take plus 1
     @param (p) 2x2 matrix designating the probability
-    @param (rg) random number state (passed to erand48)
+    @param (g) random number generator of the element
     @details
     with probability p[0][0], 0 <= i < M/2 and 0 <= j < N/2.
     with probability p[0][1], 0 <= i < M/2 and N/2 <= j < N.
@@ -816,10 +1743,10 @@ static idx_pair_t rmat_choose_01(double p[2][2], unsigned short rg[3]) {
     we apply this recursively.
 */
 static idx_pair_t rmat_choose_pair(idx_t M, idx_t N, double p[2][2],
-                                   unsigned short rg[3]) {
+                                   ctr_rng_t * g) {
   idx_t M0 = 0, M1 = M, N0 = 0, N1 = N;
   while (M1 - M0 > 1 || N1 - N0 > 1) {
-    idx_pair_t zo = rmat_choose_01(p, rg);
+    idx_pair_t zo = rmat_choose_01(p, g);
     if (M1 - M0 > 1) {
       idx_t Mh = (M0 + M1) / 2;
       if (zo.i) {
@@ -851,29 +1778,34 @@ static idx_pair_t rmat_choose_pair(idx_t M, idx_t N, double p[2][2],
     @param (N) the number of columns
     @param (nnz) the number of non-zeros
     @param (p) 2x2 matrix designating the probability
-    @param (rg) random number state (passed to erand48)
+    @param (rg) random number state (the key of the counter-based
+    generator is drawn from it; see ctr_rng_key)
 
     @return a sparse matrix in coo fromat
     @details generate R-MAT 
     (https://epubs.siam.org/doi/abs/10.1137/1.9781611972740.43)
-    with the specified probability p.
+    with the specified probability p.  as in mk_coo_random, the kth
+    element comes from ctr_rng_at(key, k), in parallel.
     @sa rmat_choose_pair
 */
-static sparse_t mk_coo_rmat(idx_t M, idx_t N, idx_t nnz,
+static sparse_t mk_coo_rmat(idx_t M, idx_t N, nnz_t nnz,
                             double p[2][2], 
                             unsigned short rg[3]) {
   printf("%s:%d:mk_coo_rmat starts ...\n", __FILE__, __LINE__);
   long t0 = cur_time_ns();
   coo_elem_t * elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
-  for (idx_t k = 0; k < nnz; k++) {
-    idx_pair_t ij = rmat_choose_pair(M, N, p, rg);
+  uint64_t key = ctr_rng_key(rg);
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    ctr_rng_t g = ctr_rng_at(key, k);
+    idx_pair_t ij = rmat_choose_pair(M, N, p, &g);
     coo_elem_t * e = elems + k;
     e->i = ij.i;
     e->j = ij.j;
-    e->a = erand48(rg);
+    e->a = ctr_rng_real(&g);
   }
   coo_t coo = { elems };
-  sparse_t A = { sparse_format_coo, M, N, nnz, { .coo = coo } };
+  sparse_t A = { sparse_format_coo, M, N, nnz, { .coo = coo }, 0, 0 };
   long t1 = cur_time_ns();
   printf("%s:%d:mk_coo_rmat ends. took %.3f sec\n",
          __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -911,7 +1843,7 @@ static sparse_t mk_coo_rmat(idx_t M, idx_t N, idx_t nnz,
     ..., 98 }
 
 */
-static sparse_t mk_coo_one(idx_t M, idx_t N, idx_t nnz) {
+static sparse_t mk_coo_one(idx_t M, idx_t N, nnz_t nnz) {
   printf("%s:%d:mk_coo_one starts ...\n", __FILE__, __LINE__);
   long t0 = cur_time_ns();
   idx_t nnz_M = 0;
@@ -919,16 +1851,16 @@ static sparse_t mk_coo_one(idx_t M, idx_t N, idx_t nnz) {
   int cont = 1;
   while (cont) {
     cont = 0;
-    if (nnz_M < M && (nnz_M + 1) * nnz_N <= nnz) {
+    if (nnz_M < M && (nnz_t)(nnz_M + 1) * nnz_N <= nnz) {
       nnz_M++;
       cont = 1;
     }
-    if (nnz_N < N && nnz_M * (nnz_N + 1) <= nnz) {
+    if (nnz_N < N && (nnz_t)nnz_M * (nnz_N + 1) <= nnz) {
       nnz_N++;
       cont = 1;
     }
   }
-  idx_t real_nnz = nnz_M * nnz_N;
+  nnz_t real_nnz = (nnz_t)nnz_M * nnz_N;
   assert(real_nnz <= nnz);
   assert(nnz_M <= M);
   assert(nnz_N <= N);
@@ -940,7 +1872,7 @@ static sparse_t mk_coo_one(idx_t M, idx_t N, idx_t nnz) {
   coo_elem_t * elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * real_nnz);
   idx_t skip_M = (nnz_M > 1 ? (M - 1) / (nnz_M - 1) : M);
   idx_t skip_N = (nnz_N > 1 ? (N - 1) / (nnz_N - 1) : N);
-  idx_t k = 0;
+  nnz_t k = 0;
   for (idx_t i = 0; i < nnz_M; i++) {
     for (idx_t j = 0; j < nnz_N; j++) {
       real  a = 1.0;
@@ -955,7 +1887,7 @@ static sparse_t mk_coo_one(idx_t M, idx_t N, idx_t nnz) {
   }
   assert(k == real_nnz);
   coo_t coo = { elems };
-  sparse_t A = { sparse_format_coo_sorted, M, N, real_nnz, { .coo = coo } };
+  sparse_t A = { sparse_format_coo_sorted, M, N, real_nnz, { .coo = coo }, 0, 0 };
   long t1 = cur_time_ns();
   printf("%s:%d:mk_coo_one ends. took %.3f sec\n",
          __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -976,20 +1908,123 @@ static sparse_t mk_coo_one(idx_t M, idx_t N, idx_t nnz) {
 
 
 /** 
-    @brief compare two coo elements 
-    @details callback used to sort coo elements in the dictionary order
-    @return -1 if a_ < b, 1 if a_ > b and 0 if a_ = b
+    @brief replace each element of an array with the sum of the elements before it
+    @param (a) the array
+    @param (n) the number of elements
+    @return the sum of all elements
+    @details the array is split into as many blocks as threads.  each
+    block is summed, the block sums are scanned (serially, there are
+    only a few), then each block is scanned starting from its sum.
 */
-static int coo_elem_cmp(const void * a_, const void * b_) {
-  coo_elem_t * a = (coo_elem_t *)a_;
-  coo_elem_t * b = (coo_elem_t *)b_;
-  if (a->i < b->i) return -1;
-  if (a->i > b->i) return 1;
-  if (a->j < b->j) return -1;
-  if (a->j > b->j) return 1;
-  if (a->a < b->a) return -1;
-  if (a->a > b->a) return 1;
-  return 0;
+static nnz_t parallel_exclusive_scan(nnz_t * a, nnz_t n) {
+  int n_parts = get_n_threads();
+  nnz_t * sums = (nnz_t *)xalloc(sizeof(nnz_t) * (n_parts + 1));
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    nnz_t b = (nnz_t)((long)n * p / n_parts);
+    nnz_t e = (nnz_t)((long)n * (p + 1) / n_parts);
+    nnz_t s = 0;
+    for (nnz_t k = b; k < e; k++) {
+      s += a[k];
+    }
+    sums[p] = s;
+  }
+  nnz_t s = 0;
+  for (int p = 0; p < n_parts; p++) {
+    nnz_t t = s + sums[p];
+    sums[p] = s;
+    s = t;
+  }
+  sums[n_parts] = s;
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n_parts; p++) {
+    nnz_t b = (nnz_t)((long)n * p / n_parts);
+    nnz_t e = (nnz_t)((long)n * (p + 1) / n_parts);
+    nnz_t s = sums[p];
+    for (nnz_t k = b; k < e; k++) {
+      nnz_t t = s + a[k];
+      a[k] = s;
+      s = t;
+    }
+  }
+  s = sums[n_parts];
+  xfree(sums);
+  return s;
+}
+
+/** @brief the number of key bits coo_radix_sort sorts in a pass */
+static const int coo_radix_bits = 8;
+
+/** 
+    @brief the number of bits to represent 0 .. n-1
+*/
+static int n_bits(long n) {
+  int b = 0;
+  while (b < 63 && (1L << b) < n) b++;
+  return b;
+}
+
+/** 
+    @brief sort coo elements in the dictionary order of (i,j)
+    @param (elems) the elements to sort
+    @param (tmp) a buffer of the same number of elements
+    @param (nnz) the number of elements
+    @param (M) the number of rows
+    @param (N) the number of columns
+    @return elems or tmp, whichever has the sorted elements (the
+    other has garbage)
+    @details a least significant digit radix sort on the 64-bit key
+    (i << bits of N) | j, coo_radix_bits bits per pass.  only the
+    bits M and N need are sorted, so a 20000 x 10000 matrix takes
+    four passes.  each pass is a parallel histogram of digits over
+    equal blocks of elements, a parallel exclusive scan of the
+    (digit, block) counts in digit-major order, which gives every
+    block the position of its first element of each digit, and a
+    parallel scatter.  it is stable, so elements of the same (i,j)
+    keep their input order whatever the number of threads is.
+*/
+static coo_elem_t * coo_radix_sort(coo_elem_t * elems, coo_elem_t * tmp,
+                                   nnz_t nnz, idx_t M, idx_t N) {
+  const int n_buckets = 1 << coo_radix_bits;
+  int bits_j = n_bits(N);
+  int bits = n_bits(M) + bits_j;
+  int n_passes = (bits + coo_radix_bits - 1) / coo_radix_bits;
+  int n_parts = get_n_threads();
+  nnz_t * count = (nnz_t *)xalloc(sizeof(nnz_t) * n_buckets * n_parts);
+  coo_elem_t * src = elems;
+  coo_elem_t * dst = tmp;
+  for (int pass = 0; pass < n_passes; pass++) {
+    int shift = pass * coo_radix_bits;
+#pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < n_parts; p++) {
+      nnz_t b = (nnz_t)((long)nnz * p / n_parts);
+      nnz_t e = (nnz_t)((long)nnz * (p + 1) / n_parts);
+      for (int d = 0; d < n_buckets; d++) {
+        count[d * n_parts + p] = 0;
+      }
+      for (nnz_t k = b; k < e; k++) {
+        uint64_t key = ((uint64_t)src[k].i << bits_j) | (uint64_t)src[k].j;
+        int d = (key >> shift) & (n_buckets - 1);
+        count[d * n_parts + p]++;
+      }
+    }
+    parallel_exclusive_scan(count, n_buckets * n_parts);
+#pragma omp parallel for schedule(static, 1)
+    for (int p = 0; p < n_parts; p++) {
+      nnz_t b = (nnz_t)((long)nnz * p / n_parts);
+      nnz_t e = (nnz_t)((long)nnz * (p + 1) / n_parts);
+      for (nnz_t k = b; k < e; k++) {
+        uint64_t key = ((uint64_t)src[k].i << bits_j) | (uint64_t)src[k].j;
+        int d = (key >> shift) & (n_buckets - 1);
+        dst[count[d * n_parts + p]++] = src[k];
+      }
+    }
+    coo_elem_t * t = src;
+    src = dst;
+    dst = t;
+  }
+  xfree(count);
+  return src;
 }
 
 /** 
@@ -1008,61 +2043,27 @@ static sparse_t sparse_coo_to_coo(sparse_t A, sparse_format_t format) {
        format == sparse_format_coo_sorted)) {
     int need_sort = (A.format == sparse_format_coo && format == sparse_format_coo_sorted);
     sparse_format_t out_format = (A.format == sparse_format_coo ? format : sparse_format_coo_sorted);
-    idx_t nnz = A.nnz;
+    nnz_t nnz = A.nnz;
     idx_t M = A.M;
     coo_elem_t * A_elems = A.coo.elems;
     coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
     /* sort if src is coo and dest is coo_sorted. otherwise copy */
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      B_elems[k] = A_elems[k];
+    }
     if (need_sort) {
-      idx_t * row_p     = (idx_t *)xalloc(sizeof(idx_t) * M);
-      idx_t * row_start = (idx_t *)xalloc(sizeof(idx_t) * M);
-      idx_t * row_end   = (idx_t *)xalloc(sizeof(idx_t) * M);
-      /* count the number of nnz in each row */
-#pragma omp parallel for 
-      for (idx_t i = 0; i < M; i++) {
-        row_p[i] = 0;
-      }
-#pragma omp parallel for 
-      for (idx_t k = 0; k < nnz; k++) {
-        idx_t i = A_elems[k].i;
-        __sync_fetch_and_add(&row_p[i], 1);
-      }
-      /* row_count[i] = the number of non-zeros in ith row.
-         now calculate where ith row should start. */
-      idx_t s = 0;
-      for (idx_t i = 0; i < M; i++) {
-        idx_t e = s + row_p[i];
-        row_start[i] = s;
-        row_end[i] = e;
-        row_p[i] = s;           /* set p to the start for the next scan */
-        s = e;
-      }
-      assert(s == nnz);
-#pragma omp parallel for 
-      for (idx_t k = 0; k < nnz; k++) {
-        idx_t i = A_elems[k].i;
-        idx_t p = __sync_fetch_and_add(&row_p[i], 1);
-        assert(p < row_end[i]);
-        B_elems[p] = A_elems[k];
-      }
-      for (idx_t i = 0; i < M; i++) {
-        assert(row_p[i] == row_end[i]);
+      coo_elem_t * tmp = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+      coo_elem_t * sorted = coo_radix_sort(B_elems, tmp, nnz, M, A.N);
+      if (sorted == tmp) {
+        xfree(B_elems);
+        B_elems = tmp;
+      } else {
+        xfree(tmp);
       }
-#pragma omp parallel for
-      for (idx_t i = 0; i < M; i++) {
-        idx_t s = row_start[i];
-        idx_t e = row_end[i];
-        qsort((void*)&B_elems[s], e - s, sizeof(coo_elem_t), coo_elem_cmp);
-      }
-      xfree(row_p);
-      xfree(row_start);
-      xfree(row_end);
-    } else {
-      /* either already sorted or not asked to sort. just copy */
-      memcpy(B_elems, A_elems, sizeof(coo_elem_t) * nnz);
     }
     coo_t coo = { B_elems };
-    sparse_t B = { out_format, A.M, A.N, A.nnz, { .coo = coo } };
+    sparse_t B = { out_format, A.M, A.N, A.nnz, { .coo = coo }, 0, 0 };
     long t1 = cur_time_ns();
     printf("%s:%d:sparse_coo_to_coo ends. took %.3f sec\n",
            __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -1086,33 +2087,32 @@ static sparse_t sparse_coo_sorted_to_csr(sparse_t A) {
   if (A.format == sparse_format_coo_sorted) {
     idx_t M = A.M;
     idx_t N = A.N;
-    idx_t nnz = A.nnz;
-    idx_t * row_start = (idx_t *)xalloc(sizeof(idx_t) * (M + 1));
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
     coo_elem_t * A_elems = A.coo.elems;
     csr_elem_t * B_elems = (csr_elem_t *)xalloc(sizeof(csr_elem_t) * nnz);
-    for (idx_t i = 0; i < M + 1; i++) {
-      row_start[i] = 0;
-    }
-    /* scan A's elements (in the dictionary order).
-       count the number of non-zeros in each row along the way */
-    for (idx_t k = 0; k < nnz; k++) {
+    /* A's elements are in the dictionary order, so row i starts at
+       the first element whose row is i or later.  element k is that
+       for rows (the row of element k-1, the row of element k], so
+       each row_start[i] is written exactly once, by the thread that
+       has that boundary in its chunk, without atomics or a scan */
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
       coo_elem_t * e = A_elems + k;
-      row_start[e->i]++;
+      idx_t i0 = (k == 0 ? 0 : A_elems[k - 1].i + 1);
+      for (idx_t i = i0; i <= e->i; i++) {
+        row_start[i] = k;
+      }
       B_elems[k].j = e->j;
       B_elems[k].a = e->a;
     }
-    /* row_start[i] = the number of non-zeros in ith row.
-       now calculate where ith row starts. */
-    idx_t s = 0;
-    for (idx_t i = 0; i < M; i++) {
-      idx_t t = s + row_start[i];
-      row_start[i] = s;
-      s = t;
+    /* rows after the last non-zero (all rows if there is none) */
+    for (idx_t i = (nnz == 0 ? 0 : A_elems[nnz - 1].i + 1); i <= M; i++) {
+      row_start[i] = nnz;
     }
-    row_start[M] = s;
-    assert(s == nnz);
+    assert(row_start[M] == nnz);
     csr_t csr = { row_start, B_elems };
-    sparse_t B = { sparse_format_csr, M, N, nnz, { .csr = csr } };
+    sparse_t B = { sparse_format_csr, M, N, nnz, { .csr = csr }, 0, 0 };
     long t1 = cur_time_ns();
     printf("%s:%d:sparse_coo_sorted_to_csr ends. took %.3f sec\n",
            __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -1148,6 +2148,120 @@ static sparse_t sparse_coo_to_csr(sparse_t A) {
   }
 }
 
+/** 
+    @brief check if a matrix in coo format is symmetric
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @return 1 if A is square and has (j,i,a) for each element (i,j,a),
+    0 otherwise
+    @details the elements and their transposes are sorted by
+    coo_radix_sort and compared one by one.  the sort is stable, so
+    duplicates of an element must appear in the same order as those
+    of its mirror; a matrix that has them in a different order is
+    judged asymmetric, which only makes it stored in full.
+*/
+static int coo_is_symmetric(sparse_t A) {
+  if (A.M != A.N) return 0;
+  printf("%s:%d:coo_is_symmetric starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  idx_t M = A.M;
+  nnz_t nnz = A.nnz;
+  coo_elem_t * A_elems = A.coo.elems;
+  coo_elem_t * E = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+  coo_elem_t * T = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+  coo_elem_t * tmp = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    E[k] = A_elems[k];
+    T[k].i = A_elems[k].j;
+    T[k].j = A_elems[k].i;
+    T[k].a = A_elems[k].a;
+  }
+  coo_elem_t * sE = coo_radix_sort(E, tmp, nnz, M, M);
+  coo_elem_t * sT = coo_radix_sort(T, (sE == E ? tmp : E), nnz, M, M);
+  nnz_t n_diff = 0;
+#pragma omp parallel for reduction(+:n_diff)
+  for (nnz_t k = 0; k < nnz; k++) {
+    n_diff += (sE[k].i != sT[k].i || sE[k].j != sT[k].j || sE[k].a != sT[k].a);
+  }
+  xfree(E);
+  xfree(T);
+  xfree(tmp);
+  long t1 = cur_time_ns();
+  printf("%s:%d:coo_is_symmetric ends. %s. took %.3f sec\n",
+         __FILE__, __LINE__, (n_diff == 0 ? "symmetric" : "not symmetric"),
+         (t1 - t0) * 1.0e-9);
+  return n_diff == 0;
+}
+
+/**
+   @brief convert a sparse matrix in coo format, known to be
+   symmetric, to csr_sym format.
+   @param (A) a symmetric sparse matrix in coo or coo_sorted format
+   @return a sparse matrix in the csr_sym format, which has the
+   elements (i,j) of A such that i <= j
+   @details A is not checked; the lower triangle is just dropped.
+   use sparse_coo_to_csr_sym unless the caller has already checked
+   A by coo_is_symmetric.
+ */
+static sparse_t sparse_coo_sym_to_csr_sym(sparse_t A) {
+  printf("%s:%d:sparse_coo_sym_to_csr_sym starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  nnz_t nnz = A.nnz;
+  coo_elem_t * A_elems = A.coo.elems;
+  nnz_t n_upper = 0;
+#pragma omp parallel for reduction(+:n_upper)
+  for (nnz_t k = 0; k < nnz; k++) {
+    n_upper += (A_elems[k].i <= A_elems[k].j);
+  }
+  coo_elem_t * U_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * n_upper);
+  nnz_t u = 0;
+  for (nnz_t k = 0; k < nnz; k++) {
+    if (A_elems[k].i <= A_elems[k].j) {
+      U_elems[u++] = A_elems[k];
+    }
+  }
+  assert(u == n_upper);
+  coo_t coo = { U_elems };
+  sparse_t U = { A.format, A.M, A.N, n_upper, { .coo = coo }, 0, 0 };
+  sparse_t B = sparse_coo_to_csr(U);
+  sparse_destroy(U);
+  B.format = sparse_format_csr_sym;
+  long t1 = cur_time_ns();
+  printf("%s:%d:sparse_coo_sym_to_csr_sym ends. kept %ld of %ld non-zeros."
+         " took %.3f sec\n",
+         __FILE__, __LINE__, (long)n_upper, (long)nnz, (t1 - t0) * 1.0e-9);
+  return B;
+}
+
+/**
+   @brief convert a symmetric sparse matrix in coo format to csr_sym format.
+   @param (A) a sparse matrix in coo or coo_sorted format
+   @return a sparse matrix in the csr_sym format, which has the
+   elements (i,j) of A such that i <= j.  invalid if A is not symmetric
+ */
+static sparse_t sparse_coo_to_csr_sym(sparse_t A) {
+  if (A.format != sparse_format_coo
+      && A.format != sparse_format_coo_sorted) {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in coo format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+  if (!coo_is_symmetric(A)) {
+    fprintf(stderr,
+            "error:%s:%d: csr_sym needs a symmetric matrix\n",
+            __FILE__, __LINE__);
+    return mk_sparse_invalid();
+  }
+  return sparse_coo_sym_to_csr_sym(A);
+}
+
+static sparse_t sparse_csr_to_sell(sparse_t A);
+static sparse_t sparse_csr_to_bcsr(sparse_t A);
+static sparse_t sparse_csr_to_csr_soa(sparse_t A);
+static sparse_t sparse_csr_to_csr_delta(sparse_t A);
+static sparse_t sparse_csr_to_tiled(sparse_t A);
+
 /**
    @brief convert sparse matrix in coo format to any specified format.
    @param (A) a sparse matrix in coo format
@@ -1164,6 +2278,38 @@ static sparse_t sparse_coo_to_any(sparse_t A, sparse_format_t format) {
       return sparse_coo_to_coo(A, format);
     case sparse_format_csr:
       return sparse_coo_to_csr(A);
+    case sparse_format_sell: {
+      sparse_t B = sparse_coo_to_csr(A);
+      sparse_t C = sparse_csr_to_sell(B);
+      sparse_destroy(B);
+      return C;
+    }
+    case sparse_format_bcsr: {
+      sparse_t B = sparse_coo_to_csr(A);
+      sparse_t C = sparse_csr_to_bcsr(B);
+      sparse_destroy(B);
+      return C;
+    }
+    case sparse_format_csr_soa: {
+      sparse_t B = sparse_coo_to_csr(A);
+      sparse_t C = sparse_csr_to_csr_soa(B);
+      sparse_destroy(B);
+      return C;
+    }
+    case sparse_format_csr_delta: {
+      sparse_t B = sparse_coo_to_csr(A);
+      sparse_t C = sparse_csr_to_csr_delta(B);
+      sparse_destroy(B);
+      return C;
+    }
+    case sparse_format_tiled: {
+      sparse_t B = sparse_coo_to_csr(A);
+      sparse_t C = sparse_csr_to_tiled(B);
+      sparse_destroy(B);
+      return C;
+    }
+    case sparse_format_csr_sym:
+      return sparse_coo_to_csr_sym(A);
     default:
       fprintf(stderr,
               "error:%s:%d: invalid output format %d\n",
@@ -1190,14 +2336,15 @@ static sparse_t sparse_csr_to_coo_sorted(sparse_t A) {
   if (A.format == sparse_format_csr) {
     idx_t M = A.M;
     idx_t N = A.N;
-    idx_t nnz = A.nnz;
-    idx_t * row_start = A.csr.row_start;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = A.csr.row_start;
     csr_elem_t * A_elems = A.csr.elems;
     coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+#pragma omp parallel for schedule(dynamic, 1024)
     for (idx_t i = 0; i < M; i++) {
-      idx_t start = row_start[i];
-      idx_t end = row_start[i + 1];
-      for (idx_t k = start; k < end; k++) {
+      nnz_t start = row_start[i];
+      nnz_t end = row_start[i + 1];
+      for (nnz_t k = start; k < end; k++) {
         csr_elem_t * e = A_elems + k;
         B_elems[k].i = i;
         B_elems[k].j = e->j;
@@ -1205,7 +2352,7 @@ static sparse_t sparse_csr_to_coo_sorted(sparse_t A) {
       }
     }
     coo_t coo = { B_elems };
-    sparse_t B = { sparse_format_coo_sorted, M, N, nnz, { .coo = coo } };
+    sparse_t B = { sparse_format_coo_sorted, M, N, nnz, { .coo = coo }, 0, 0 };
     long t1 = cur_time_ns();
     printf("%s:%d:sparse_csr_to_coo_sorted ends. took %.3f sec\n",
            __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
@@ -1219,846 +2366,6438 @@ static sparse_t sparse_csr_to_coo_sorted(sparse_t A) {
 }
 
 /**
-   @brief convert sparse matrix in csr format to any specified format
+   @brief a row and its length, used to sort rows by their lengths
+ */
+typedef struct {
+  idx_t len;                    /**< the number of non-zeros in the row */
+  idx_t i;                      /**< row number */
+} row_len_t;
+
+/** 
+    @brief compare two rows by their lengths
+    @details callback used to sort rows in the decreasing order of
+    their lengths (and increasing order of row numbers among rows of
+    the same length)
+*/
+static int row_len_cmp(const void * a_, const void * b_) {
+  row_len_t * a = (row_len_t *)a_;
+  row_len_t * b = (row_len_t *)b_;
+  if (a->len > b->len) return -1;
+  if (a->len < b->len) return 1;
+  if (a->i < b->i) return -1;
+  if (a->i > b->i) return 1;
+  return 0;
+}
+
+/**
+   @brief convert a sparse matrix in csr format to sell format.
    @param (A) a sparse matrix in csr format
-   @param (format) the destination format
-   @return a sparse format in the specified format
+   @return a sparse matrix in sell format
+   @sa sell_t
  */
-static sparse_t sparse_csr_to_any(sparse_t A, sparse_format_t format) {
+static sparse_t sparse_csr_to_sell(sparse_t A) {
+  printf("%s:%d:sparse_csr_to_sell starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
   if (A.format == sparse_format_csr) {
-    switch (format) {
-    case sparse_format_coo:
-      return sparse_csr_to_coo_sorted(A);
-    case sparse_format_coo_sorted:
-      return sparse_csr_to_coo_sorted(A);
-    case sparse_format_csr:
-      return A;
-    default:
-      fprintf(stderr,
-              "error:%s:%d: invalid output format %d\n",
-              __FILE__, __LINE__, format);
-      return mk_sparse_invalid();
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = A.csr.row_start;
+    csr_elem_t * A_elems = A.csr.elems;
+    idx_t n_chunks = (M + sell_C - 1) / sell_C;
+    idx_t n_slots = n_chunks * sell_C;
+    idx_t * row = (idx_t *)xalloc(sizeof(idx_t) * n_slots);
+    idx_t * row_len = (idx_t *)xalloc(sizeof(idx_t) * n_slots);
+    nnz_t * chunk_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_chunks + 1));
+    /* sort rows by their lengths within each window */
+    idx_t n_windows = (M + sell_sigma - 1) / sell_sigma;
+#pragma omp parallel for schedule(dynamic)
+    for (idx_t w = 0; w < n_windows; w++) {
+      idx_t begin = w * sell_sigma;
+      idx_t end = (begin + sell_sigma < M ? begin + sell_sigma : M);
+      row_len_t rows[sell_sigma];
+      for (idx_t i = begin; i < end; i++) {
+        rows[i - begin].len = (idx_t)(row_start[i + 1] - row_start[i]);
+        rows[i - begin].i = i;
+      }
+      qsort((void *)rows, end - begin, sizeof(row_len_t), row_len_cmp);
+      for (idx_t i = begin; i < end; i++) {
+        row[i] = rows[i - begin].i;
+        row_len[i] = rows[i - begin].len;
+      }
+    }
+    for (idx_t i = M; i < n_slots; i++) {
+      row[i] = -1;
+      row_len[i] = 0;
     }
+    /* chunk c is as wide as its longest row */
+    nnz_t s = 0;
+    for (idx_t c = 0; c < n_chunks; c++) {
+      idx_t width = 0;
+      for (int r = 0; r < sell_C; r++) {
+        idx_t len = row_len[c * sell_C + r];
+        if (len > width) width = len;
+      }
+      chunk_start[c] = s;
+      s += (nnz_t)width * sell_C;
+    }
+    chunk_start[n_chunks] = s;
+    idx_t * col = (idx_t *)xalloc_aligned(64, sizeof(idx_t) * s);
+    real * val = (real *)xalloc_aligned(64, sizeof(real) * s);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (idx_t c = 0; c < n_chunks; c++) {
+      idx_t width = (idx_t)((chunk_start[c + 1] - chunk_start[c]) / sell_C);
+      for (int r = 0; r < sell_C; r++) {
+        idx_t slot = c * sell_C + r;
+        idx_t i = row[slot];
+        idx_t len = row_len[slot];
+        for (idx_t w = 0; w < width; w++) {
+          nnz_t k = chunk_start[c] + (nnz_t)w * sell_C + r;
+          if (w < len) {
+            csr_elem_t * e = A_elems + row_start[i] + w;
+            col[k] = e->j;
+            val[k] = e->a;
+          } else {
+            col[k] = 0;
+            val[k] = 0.0;
+          }
+        }
+      }
+    }
+    sell_t sell = { n_chunks, chunk_start, row, row_len, col, val };
+    sparse_t B = { sparse_format_sell, M, N, nnz, { .sell = sell }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_to_sell ends. %ld elements for %ld non-zeros"
+           " (%.1f%% padding). took %.3f sec\n",
+           __FILE__, __LINE__, (long)s, (long)nnz,
+           (s > 0 ? 100.0 * (s - nnz) / s : 0.0), (t1 - t0) * 1.0e-9);
+    return B;
   } else {
     fprintf(stderr,
             "error:%s:%d: input matrix not in csr format %d\n",
-            __FILE__, __LINE__, format);
+            __FILE__, __LINE__, A.format);
     return mk_sparse_invalid();
   }
 }
 
 /**
-   @brief convert a sparse matrix of any format to any specified format
-   @param (A) a sparse matrix in csr format
-   @param (format) the destination format
-   @return a sparse format in the specified format
+   @brief block shapes (R x C) bcsr format can take
  */
-sparse_t sparse_any_to_any(sparse_t A, sparse_format_t format) {
-  switch (A.format) {
-  case sparse_format_coo:
-    return sparse_coo_to_any(A, format);
-  case sparse_format_coo_sorted:
-    return sparse_coo_to_any(A, format);
-  case sparse_format_csr:
-    return sparse_csr_to_any(A, format);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid input format %d\n",
-            __FILE__, __LINE__, format);
-    return mk_sparse_invalid();
+static const int bcsr_shapes[][2] = { { 1, 1 }, { 2, 2 }, { 4, 4 }, { 8, 1 } };
+
+/**
+   @brief list the block columns of a block row of a csr matrix
+   @param (A) a sparse matrix in csr format (columns sorted in each row)
+   @param (R) rows of a block
+   @param (C) columns of a block
+   @param (I) the block row
+   @param (block_col) if not null, the block columns are written to it
+   @return the number of distinct block columns in block row I
+   @details merges the (sorted) columns of the R rows
+*/
+static idx_t csr_block_row_cols(sparse_t A, int R, int C, idx_t I,
+                                idx_t * block_col) {
+  nnz_t * row_start = A.csr.row_start;
+  csr_elem_t * elems = A.csr.elems;
+  nnz_t cur[8], end[8];
+  int n_rows = 0;
+  for (int r = 0; r < R && I * R + r < A.M; r++) {
+    cur[r] = row_start[I * R + r];
+    end[r] = row_start[I * R + r + 1];
+    n_rows++;
+  }
+  idx_t n = 0;
+  while (1) {
+    idx_t m = -1;
+    for (int r = 0; r < n_rows; r++) {
+      if (cur[r] < end[r]) {
+        idx_t J = elems[cur[r]].j / C;
+        if (m < 0 || J < m) m = J;
+      }
+    }
+    if (m < 0) break;
+    if (block_col) block_col[n] = m;
+    n++;
+    for (int r = 0; r < n_rows; r++) {
+      while (cur[r] < end[r] && elems[cur[r]].j / C == m) {
+        cur[r]++;
+      }
+    }
   }
+  return n;
 }
-/*********************************************************
- *
- * make (generate or read) a sparse matrix
- *
- *********************************************************/
 
 /**
-   @brief read a matrix file and return a sparse matrix in coo formated
-   @param (M) the number of rows
-   @param (N) the number of columns
-   @param (nnz) the number of non-zeros
-   @param (file) filename
-   @return a sparse matrix in coo format
- */
-static sparse_t read_coo_file(idx_t M, idx_t N, idx_t nnz, char * file) {
-  (void)M;
-  (void)N;
-  (void)nnz;
-  (void)file;
-  fprintf(stderr, ":%s:%d:read_coo_file: sorry, not implemented yet\n",
-          __FILE__, __LINE__);
-  return mk_sparse_invalid();
+   @brief choose the block shape of bcsr for a csr matrix
+   @param (A) a sparse matrix in csr format
+   @return the index of the chosen shape in bcsr_shapes
+   @details for each shape, the number of blocks is estimated by
+   counting those of a sample of (up to about 1000) block rows.  the
+   estimated fill ratio (stored values / non-zeros) tells how much
+   the shape inflates the values, while it saves one index per block
+   instead of one per non-zero.  we pick the shape with the fewest
+   estimated bytes, i.e., blocks x (R x C x sizeof(real) + sizeof(idx_t)).
+*/
+static int bcsr_choose_shape(sparse_t A) {
+  int n_shapes = sizeof(bcsr_shapes) / sizeof(bcsr_shapes[0]);
+  int best = 0;
+  double best_bytes = 0.0;
+  for (int h = 0; h < n_shapes; h++) {
+    int R = bcsr_shapes[h][0];
+    int C = bcsr_shapes[h][1];
+    idx_t n_block_rows = (A.M + R - 1) / R;
+    idx_t stride = (n_block_rows + 999) / 1000;
+    if (stride < 1) stride = 1;
+    long sample_blocks = 0;
+    long sample_nnz = 0;
+    for (idx_t I = 0; I < n_block_rows; I += stride) {
+      sample_blocks += csr_block_row_cols(A, R, C, I, 0);
+      idx_t i1 = (I * R + R < A.M ? I * R + R : A.M);
+      sample_nnz += A.csr.row_start[i1] - A.csr.row_start[I * R];
+    }
+    double fill = (sample_nnz > 0 ? sample_blocks * R * C / (double)sample_nnz : 1.0);
+    double blocks = fill * (double)A.nnz / (R * C);
+    double bytes = blocks * (R * C * sizeof(real) + sizeof(idx_t));
+    printf("%s:%d:bcsr_choose_shape: %dx%d fill ratio %.3f, %.0f bytes\n",
+           __FILE__, __LINE__, R, C, fill, bytes);
+    if (h == 0 || bytes < best_bytes) {
+      best = h;
+      best_bytes = bytes;
+    }
+  }
+  return best;
 }
 
 /**
-   @brief make a sparse matrix in coo format by the desiginated generation
-   method
-   @param (opt) command line options specifying matrix type and other
-   parameters necessary for some matrix types
-   @param (M) the number of rows
-   @param (N) the number of columns
-   @param (nnz) the number of non-zeros
-   @param (rg) random number generator state (passed to erand48)
-   @return a sparse matrix in coo format
+   @brief convert a sparse matrix in csr format to bcsr format.
+   @param (A) a sparse matrix in csr format
+   @return a sparse matrix in bcsr format
+   @details the block shape is chosen by bcsr_choose_shape.  
+   duplicated elements are summed into the same block value.
+   @sa bcsr_t
  */
-static sparse_t mk_sparse_matrix_coo(cmdline_options_t opt,
-                                     idx_t M, idx_t N, idx_t nnz,
-                                     unsigned short rg[3]) {
-  switch (opt.matrix_type) {
-  case sparse_matrix_type_random:
-    return mk_coo_random(M, N, nnz, rg);
-  case sparse_matrix_type_rmat:
-    return mk_coo_rmat(M, N, nnz, opt.rmat, rg);
-  case sparse_matrix_type_one:
-    return mk_coo_one(M, N, nnz);
-  case sparse_matrix_type_coo_file:
-    return read_coo_file(M, N, nnz, opt.coo_file);
-  default:
+static sparse_t sparse_csr_to_bcsr(sparse_t A) {
+  printf("%s:%d:sparse_csr_to_bcsr starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = A.csr.row_start;
+    csr_elem_t * A_elems = A.csr.elems;
+    int h = bcsr_choose_shape(A);
+    int R = bcsr_shapes[h][0];
+    int C = bcsr_shapes[h][1];
+    idx_t n_block_rows = (M + R - 1) / R;
+    nnz_t * block_row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_block_rows + 1));
+    /* count blocks in each block row */
+#pragma omp parallel for schedule(dynamic, 64)
+    for (idx_t I = 0; I < n_block_rows; I++) {
+      block_row_start[I] = csr_block_row_cols(A, R, C, I, 0);
+    }
+    nnz_t s = 0;
+    for (idx_t I = 0; I < n_block_rows; I++) {
+      nnz_t t = s + block_row_start[I];
+      block_row_start[I] = s;
+      s = t;
+    }
+    block_row_start[n_block_rows] = s;
+    idx_t * block_col = (idx_t *)xalloc(sizeof(idx_t) * s);
+    real * val = (real *)xalloc_aligned(64, sizeof(real) * R * C * s);
+    /* fill blocks */
+#pragma omp parallel for schedule(dynamic, 64)
+    for (idx_t I = 0; I < n_block_rows; I++) {
+      nnz_t b0 = block_row_start[I];
+      nnz_t b1 = block_row_start[I + 1];
+      csr_block_row_cols(A, R, C, I, block_col + b0);
+      for (nnz_t k = b0 * R * C; k < b1 * R * C; k++) {
+        val[k] = 0.0;
+      }
+      for (int r = 0; r < R && I * R + r < M; r++) {
+        nnz_t b = b0;
+        idx_t i = I * R + r;
+        for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+          idx_t j = A_elems[k].j;
+          while (block_col[b] < j / C) b++;
+          assert(b < b1 && block_col[b] == j / C);
+          val[b * R * C + r * C + j % C] += A_elems[k].a;
+        }
+      }
+    }
+    bcsr_t bcsr = { R, C, n_block_rows, block_row_start, block_col, val };
+    sparse_t B = { sparse_format_bcsr, M, N, nnz, { .bcsr = bcsr }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_to_bcsr ends. %dx%d blocks, %ld blocks for"
+           " %ld non-zeros (fill ratio %.3f). took %.3f sec\n",
+           __FILE__, __LINE__, R, C, (long)s, (long)nnz,
+           (nnz > 0 ? (double)s * R * C / nnz : 1.0), (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
     fprintf(stderr,
-            "error:%s:%d: invalid matrix_type %d\n",
-            __FILE__, __LINE__, opt.matrix_type);
+            "error:%s:%d: input matrix not in csr format %d\n",
+            __FILE__, __LINE__, A.format);
     return mk_sparse_invalid();
   }
 }
 
-/** 
-    @brief make (read or generate) a sparse matrix with the specified 
-    matrix generation method
-
-    @param (opt) command line options specifying matrix format, 
-    matrix type, and other parameters necessary for some matrix types
-    @param (M) the number of rows
-    @param (N) the number of columns
-    @param (nnz) the number of non-zeros
-    @param (rg) random number generator state (passed to erand48)
-    @return a sparse matrix in coo format
-    @sa mk_sparse_matrix_coo
-    @sa sparse_coo_to
+/**
+   @brief convert a sparse matrix in csr format to csr_soa format.
+   @param (A) a sparse matrix in csr format
+   @return a sparse matrix in csr_soa format
+ */
+static sparse_t sparse_csr_to_csr_soa(sparse_t A) {
+  printf("%s:%d:sparse_csr_to_csr_soa starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    idx_t * col_idx = (idx_t *)xalloc_aligned(64, sizeof(idx_t) * nnz);
+    real * vals = (real *)xalloc_aligned(64, sizeof(real) * nnz);
+    csr_elem_t * A_elems = A.csr.elems;
+    memcpy(row_start, A.csr.row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      col_idx[k] = A_elems[k].j;
+      vals[k] = A_elems[k].a;
+    }
+    csr_soa_t csr_soa = { row_start, col_idx, vals };
+    sparse_t B = { sparse_format_csr_soa, M, N, nnz, { .csr_soa = csr_soa }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_to_csr_soa ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief encode the columns of a row of a csr matrix (see csr_delta_t)
+   @param (A) a sparse matrix in csr format (columns sorted in each row)
+   @param (i) the row
+   @param (code) if not null, the words are written to it
+   @return the number of words of row i
+*/
+template<typename W>
+static nnz_t csr_delta_encode_row(sparse_t A, idx_t i, W * code) {
+  const W esc = (W)~(W)0;
+  const int n_esc_words = sizeof(idx_t) / sizeof(W);
+  csr_elem_t * elems = A.csr.elems;
+  nnz_t n = 0;
+  idx_t prev = 0;
+  for (nnz_t k = A.csr.row_start[i]; k < A.csr.row_start[i + 1]; k++) {
+    idx_t j = elems[k].j;
+    assert(j >= prev);
+    if ((unsigned long)(j - prev) < (unsigned long)esc) {
+      if (code) code[n] = (W)(j - prev);
+      n++;
+    } else {
+      if (code) {
+        code[n] = esc;
+        unsigned long u = (unsigned long)j;
+        for (int q = 0; q < n_esc_words; q++) {
+          code[n + 1 + q] = (W)(u >> (8 * sizeof(W) * q));
+        }
+      }
+      n += 1 + n_esc_words;
+    }
+    prev = j;
+  }
+  return n;
+}
+
+/**
+   @brief encode the columns of a csr matrix with words of type W
+   @param (A) a sparse matrix in csr format
+   @param (B) the csr_delta matrix whose code_start and code are set
+*/
+template<typename W>
+static void csr_delta_encode(sparse_t A, csr_delta_t * B) {
+  idx_t M = A.M;
+  nnz_t * code_start = B->code_start;
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (idx_t i = 0; i < M; i++) {
+    code_start[i] = csr_delta_encode_row<W>(A, i, 0);
+  }
+  nnz_t s = 0;
+  for (idx_t i = 0; i < M; i++) {
+    nnz_t t = s + code_start[i];
+    code_start[i] = s;
+    s = t;
+  }
+  code_start[M] = s;
+  W * code = (W *)xalloc_aligned(64, sizeof(W) * s);
+#pragma omp parallel for schedule(dynamic, 1024)
+  for (idx_t i = 0; i < M; i++) {
+    csr_delta_encode_row<W>(A, i, code + code_start[i]);
+  }
+  B->width = sizeof(W);
+  B->code = (unsigned char *)code;
+}
+
+/**
+   @brief convert a sparse matrix in csr format to csr_delta format.
+   @param (A) a sparse matrix in csr format
+   @return a sparse matrix in csr_delta format
+   @details encodes columns with both 8 and 16-bit words and keeps the
+   smaller.  8-bit words win when most columns of a row are near each
+   other (e.g., after reordering or for banded matrices); otherwise
+   escapes for large jumps make 16-bit words smaller.
+   @sa csr_delta_t
+ */
+static sparse_t sparse_csr_to_csr_delta(sparse_t A) {
+  printf("%s:%d:sparse_csr_to_csr_delta starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    long words8 = 0, words16 = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+:words8,words16)
+    for (idx_t i = 0; i < M; i++) {
+      words8  += csr_delta_encode_row<uint8_t>(A, i, 0);
+      words16 += csr_delta_encode_row<uint16_t>(A, i, 0);
+    }
+    csr_delta_t csr_delta;
+    csr_delta.row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    csr_delta.code_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    csr_delta.vals = (real *)xalloc_aligned(64, sizeof(real) * nnz);
+    memcpy(csr_delta.row_start, A.csr.row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      csr_delta.vals[k] = A.csr.elems[k].a;
+    }
+    if (words8 <= 2 * words16) {
+      csr_delta_encode<uint8_t>(A, &csr_delta);
+    } else {
+      csr_delta_encode<uint16_t>(A, &csr_delta);
+    }
+    sparse_t B = { sparse_format_csr_delta, M, N, nnz, { .csr_delta = csr_delta }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_to_csr_delta ends. %d-bit words,"
+           " %.3f bytes/column (compression ratio %.3f). took %.3f sec\n",
+           __FILE__, __LINE__, 8 * csr_delta.width,
+           (nnz > 0 ? (double)csr_delta.width * csr_delta.code_start[M] / (double)nnz : 0.0),
+           sparse_compression_ratio(B), (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief the size of a cache reported by the OS
+   @param (name) _SC_LEVEL2_CACHE_SIZE, _SC_LEVEL3_CACHE_SIZE, etc.
+   @param (dflt) the size assumed when the OS does not tell
+   @return the size in bytes
+*/
+static long cache_size(int name, long dflt) {
+  long sz = sysconf(name);
+  return (sz > 0 ? sz : dflt);
+}
+
+/**
+   @brief choose the tile shape of tiled format
+   @param (M) the number of rows
+   @param (N) the number of columns
+   @param (R) the rows of a row block are stored to it
+   @param (W) the columns of a column segment are stored to it
+   @details a column segment is half of a thread's share of the last
+   level cache, which leaves the other half for the matrix elements
+   streaming through and the y block.  a row block is a quarter of
+   the L2 cache, but small enough to give each thread 4 row blocks
+   to balance.
+*/
+static void tiled_choose_shape(idx_t M, idx_t N, idx_t * R, idx_t * W) {
+#if defined(_SC_LEVEL2_CACHE_SIZE) && defined(_SC_LEVEL3_CACHE_SIZE)
+  long l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 1L << 20);
+  long llc = cache_size(_SC_LEVEL3_CACHE_SIZE, l2);
+#else
+  long l2 = 1L << 20;
+  long llc = 8L << 20;
+#endif
+  long n = get_n_threads();
+  long w = llc / 2 / n / (long)sizeof(real);
+  if (w < 1024) w = 1024;
+  if (w > N) w = (N > 0 ? N : 1);
+  long r = l2 / 4 / (long)sizeof(real);
+  long r_max = (M + 4 * n - 1) / (4 * n);
+  if (r > r_max) r = r_max;
+  if (r < 1) r = 1;
+  *R = (idx_t)r;
+  *W = (idx_t)w;
+}
+
+/**
+   @brief convert a sparse matrix in csr format to tiled format.
+   @param (A) a sparse matrix in csr format
+   @return a sparse matrix in tiled format
+   @details the tile shape is chosen by tiled_choose_shape.  elements
+   are counted for each tile and then scattered, one row block per
+   thread at a time, so the output needs no synchronization.
+   @sa tiled_t
+ */
+static sparse_t sparse_csr_to_tiled(sparse_t A) {
+  printf("%s:%d:sparse_csr_to_tiled starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * A_row_start = A.csr.row_start;
+    csr_elem_t * A_elems = A.csr.elems;
+    idx_t R, W;
+    tiled_choose_shape(M, N, &R, &W);
+    idx_t n_row_blocks = (M + R - 1) / R;
+    idx_t S = (N + W - 1) / W;
+    if (S < 1) S = 1;
+    idx_t n_tiles = n_row_blocks * S;
+    /* the (non-empty) rows and elements of each tile */
+    nnz_t * tile_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_tiles + 1));
+    nnz_t * tile_elem_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_tiles + 1));
+#pragma omp parallel
+    {
+      idx_t * last = (idx_t *)xalloc(sizeof(idx_t) * S);
+#pragma omp for schedule(dynamic, 1)
+      for (idx_t I = 0; I < n_row_blocks; I++) {
+        nnz_t * rows = tile_start + I * S;
+        nnz_t * elems = tile_elem_start + I * S;
+        for (idx_t J = 0; J < S; J++) {
+          rows[J] = elems[J] = 0;
+          last[J] = -1;
+        }
+        idx_t i1 = (I * R + R < M ? I * R + R : M);
+        for (idx_t i = I * R; i < i1; i++) {
+          for (nnz_t k = A_row_start[i]; k < A_row_start[i + 1]; k++) {
+            idx_t J = A_elems[k].j / W;
+            elems[J]++;
+            if (last[J] != i) {
+              last[J] = i;
+              rows[J]++;
+            }
+          }
+        }
+      }
+      xfree(last);
+    }
+    tile_start[n_tiles] = tile_elem_start[n_tiles] = 0;
+    nnz_t n_rows = parallel_exclusive_scan(tile_start, n_tiles + 1);
+    parallel_exclusive_scan(tile_elem_start, n_tiles + 1);
+    idx_t * row = (idx_t *)xalloc(sizeof(idx_t) * n_rows);
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_rows + 1));
+    idx_t * col = (idx_t *)xalloc_aligned(64, sizeof(idx_t) * nnz);
+    real * val = (real *)xalloc_aligned(64, sizeof(real) * nnz);
+    /* scatter rows and elements to their tiles */
+#pragma omp parallel
+    {
+      idx_t * last = (idx_t *)xalloc(sizeof(idx_t) * S);
+      nnz_t * rpos = (nnz_t *)xalloc(sizeof(nnz_t) * S);
+      nnz_t * pos = (nnz_t *)xalloc(sizeof(nnz_t) * S);
+#pragma omp for schedule(dynamic, 1)
+      for (idx_t I = 0; I < n_row_blocks; I++) {
+        for (idx_t J = 0; J < S; J++) {
+          last[J] = -1;
+          rpos[J] = tile_start[I * S + J];
+          pos[J] = tile_elem_start[I * S + J];
+        }
+        idx_t i1 = (I * R + R < M ? I * R + R : M);
+        for (idx_t i = I * R; i < i1; i++) {
+          for (nnz_t k = A_row_start[i]; k < A_row_start[i + 1]; k++) {
+            idx_t j = A_elems[k].j;
+            idx_t J = j / W;
+            if (last[J] != i) {
+              last[J] = i;
+              row[rpos[J]] = i;
+              row_start[rpos[J]] = pos[J];
+              rpos[J]++;
+            }
+            col[pos[J]] = j;
+            val[pos[J]] = A_elems[k].a;
+            pos[J]++;
+          }
+        }
+      }
+      xfree(last);
+      xfree(rpos);
+      xfree(pos);
+    }
+    row_start[n_rows] = nnz;
+    xfree(tile_elem_start);
+    tiled_t tiled = { R, W, n_row_blocks, S, tile_start, row, row_start, col, val };
+    sparse_t B = { sparse_format_tiled, M, N, nnz, { .tiled = tiled }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_to_tiled ends. %ld x %ld tiles of %ld rows x %ld columns"
+           " (%.1f KB of x per tile), %ld tile rows for %ld rows. took %.3f sec\n",
+           __FILE__, __LINE__, (long)n_row_blocks, (long)S, (long)R, (long)W,
+           W * sizeof(real) / 1024.0, (long)n_rows, (long)M, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in csr format to any specified format
+   @param (A) a sparse matrix in csr format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_csr_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_csr) {
+    switch (format) {
+    case sparse_format_coo:
+      return sparse_csr_to_coo_sorted(A);
+    case sparse_format_coo_sorted:
+      return sparse_csr_to_coo_sorted(A);
+    case sparse_format_csr:
+      return A;
+    case sparse_format_sell:
+      return sparse_csr_to_sell(A);
+    case sparse_format_bcsr:
+      return sparse_csr_to_bcsr(A);
+    case sparse_format_csr_soa:
+      return sparse_csr_to_csr_soa(A);
+    case sparse_format_csr_delta:
+      return sparse_csr_to_csr_delta(A);
+    case sparse_format_tiled:
+      return sparse_csr_to_tiled(A);
+    case sparse_format_csr_sym: {
+      sparse_t B = sparse_csr_to_coo_sorted(A);
+      sparse_t C = sparse_coo_to_csr_sym(B);
+      sparse_destroy(B);
+      return C;
+    }
+    default:
+      fprintf(stderr,
+              "error:%s:%d: invalid output format %d\n",
+              __FILE__, __LINE__, format);
+      return mk_sparse_invalid();
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix in sell format to coo sorted format.
+   @param (A) a sparse matrix in sell format
+   @return a sparse matrix in coo_sorted format
+ */
+static sparse_t sparse_sell_to_coo_sorted(sparse_t A) {
+  printf("%s:%d:sparse_sell_to_coo_sorted starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_sell) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    idx_t n_chunks = A.sell.n_chunks;
+    idx_t n_slots = n_chunks * sell_C;
+    nnz_t * chunk_start = A.sell.chunk_start;
+    idx_t * row = A.sell.row;
+    idx_t * row_len = A.sell.row_len;
+    /* where each row starts in the output */
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    for (idx_t slot = 0; slot < n_slots; slot++) {
+      if (row[slot] >= 0) {
+        row_start[row[slot]] = row_len[slot];
+      }
+    }
+    nnz_t s = 0;
+    for (idx_t i = 0; i < M; i++) {
+      nnz_t t = s + row_start[i];
+      row_start[i] = s;
+      s = t;
+    }
+    row_start[M] = s;
+    assert(s == nnz);
+    coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+#pragma omp parallel for schedule(dynamic, 16)
+    for (idx_t c = 0; c < n_chunks; c++) {
+      for (int r = 0; r < sell_C; r++) {
+        idx_t slot = c * sell_C + r;
+        idx_t i = row[slot];
+        for (idx_t w = 0; w < row_len[slot]; w++) {
+          nnz_t k = chunk_start[c] + (nnz_t)w * sell_C + r;
+          coo_elem_t * e = B_elems + row_start[i] + w;
+          e->i = i;
+          e->j = A.sell.col[k];
+          e->a = A.sell.val[k];
+        }
+      }
+    }
+    xfree(row_start);
+    coo_t coo = { B_elems };
+    sparse_t B = { sparse_format_coo_sorted, M, N, nnz, { .coo = coo }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_sell_to_coo_sorted ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in sell format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in sell format to any specified format
+   @param (A) a sparse matrix in sell format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_sell_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_sell) {
+    switch (format) {
+    case sparse_format_coo:
+    case sparse_format_coo_sorted:
+      return sparse_sell_to_coo_sorted(A);
+    case sparse_format_sell:
+      return A;
+    default: {
+      sparse_t B = sparse_sell_to_coo_sorted(A);
+      sparse_t C = sparse_coo_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in sell format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix in bcsr format to coo sorted format.
+   @param (A) a sparse matrix in bcsr format
+   @return a sparse matrix in coo_sorted format
+   @details zeros in blocks are not output, so the result has fewer
+   elements than A.nnz if A had explicit zeros or duplicated elements
+ */
+static sparse_t sparse_bcsr_to_coo_sorted(sparse_t A) {
+  printf("%s:%d:sparse_bcsr_to_coo_sorted starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_bcsr) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    int R = A.bcsr.R;
+    int C = A.bcsr.C;
+    nnz_t * block_row_start = A.bcsr.block_row_start;
+    idx_t * block_col = A.bcsr.block_col;
+    real * val = A.bcsr.val;
+    nnz_t nnz = 0;
+    for (nnz_t k = 0; k < block_row_start[A.bcsr.n_block_rows] * R * C; k++) {
+      if (val[k] != 0.0) nnz++;
+    }
+    coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+    nnz_t k = 0;
+    for (idx_t i = 0; i < M; i++) {
+      idx_t I = i / R;
+      int r = i % R;
+      for (nnz_t b = block_row_start[I]; b < block_row_start[I + 1]; b++) {
+        for (int c = 0; c < C; c++) {
+          real a = val[b * R * C + r * C + c];
+          if (a != 0.0) {
+            B_elems[k].i = i;
+            B_elems[k].j = block_col[b] * C + c;
+            B_elems[k].a = a;
+            k++;
+          }
+        }
+      }
+    }
+    assert(k == nnz);
+    coo_t coo = { B_elems };
+    sparse_t B = { sparse_format_coo_sorted, M, N, nnz, { .coo = coo }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_bcsr_to_coo_sorted ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in bcsr format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in bcsr format to any specified format
+   @param (A) a sparse matrix in bcsr format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_bcsr_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_bcsr) {
+    switch (format) {
+    case sparse_format_coo:
+    case sparse_format_coo_sorted:
+      return sparse_bcsr_to_coo_sorted(A);
+    case sparse_format_bcsr:
+      return A;
+    default: {
+      sparse_t B = sparse_bcsr_to_coo_sorted(A);
+      sparse_t C = sparse_coo_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in bcsr format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix in csr_soa format to csr format.
+   @param (A) a sparse matrix in csr_soa format
+   @return a sparse matrix in csr format
+ */
+static sparse_t sparse_csr_soa_to_csr(sparse_t A) {
+  printf("%s:%d:sparse_csr_soa_to_csr starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr_soa) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    csr_elem_t * B_elems = (csr_elem_t *)xalloc(sizeof(csr_elem_t) * nnz);
+    memcpy(row_start, A.csr_soa.row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      B_elems[k].j = A.csr_soa.col_idx[k];
+      B_elems[k].a = A.csr_soa.vals[k];
+    }
+    csr_t csr = { row_start, B_elems };
+    sparse_t B = { sparse_format_csr, M, N, nnz, { .csr = csr }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_soa_to_csr ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_soa format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in csr_soa format to any specified format
+   @param (A) a sparse matrix in csr_soa format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_csr_soa_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_csr_soa) {
+    switch (format) {
+    case sparse_format_csr:
+      return sparse_csr_soa_to_csr(A);
+    case sparse_format_csr_soa:
+      return A;
+    default: {
+      sparse_t B = sparse_csr_soa_to_csr(A);
+      sparse_t C = sparse_csr_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_soa format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief decode the columns of a row of a csr_delta matrix
+   @param (code) the words of the row
+   @param (n) the number of columns of the row
+   @param (col) the columns are written to it
+*/
+template<typename W>
+static void csr_delta_decode_row(W * code, idx_t n, idx_t * col) {
+  const W esc = (W)~(W)0;
+  const int n_esc_words = sizeof(idx_t) / sizeof(W);
+  idx_t j = 0;
+  idx_t p = 0;
+  for (idx_t k = 0; k < n; k++) {
+    W w = code[p++];
+    if (w != esc) {
+      j += w;
+    } else {
+      unsigned long u = 0;
+      for (int q = 0; q < n_esc_words; q++) {
+        u |= (unsigned long)code[p++] << (8 * sizeof(W) * q);
+      }
+      j = (idx_t)u;
+    }
+    col[k] = j;
+  }
+}
+
+/**
+   @brief convert a sparse matrix in csr_delta format to csr format.
+   @param (A) a sparse matrix in csr_delta format
+   @return a sparse matrix in csr format
+ */
+static sparse_t sparse_csr_delta_to_csr(sparse_t A) {
+  printf("%s:%d:sparse_csr_delta_to_csr starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr_delta) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    csr_elem_t * B_elems = (csr_elem_t *)xalloc(sizeof(csr_elem_t) * nnz);
+    idx_t * col = (idx_t *)xalloc(sizeof(idx_t) * nnz);
+    csr_delta_t * D = &A.csr_delta;
+    memcpy(row_start, D->row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (idx_t i = 0; i < M; i++) {
+      idx_t n = (idx_t)(row_start[i + 1] - row_start[i]);
+      if (D->width == 1) {
+        csr_delta_decode_row<uint8_t>((uint8_t *)D->code + D->code_start[i],
+                                      n, col + row_start[i]);
+      } else {
+        csr_delta_decode_row<uint16_t>((uint16_t *)D->code + D->code_start[i],
+                                       n, col + row_start[i]);
+      }
+      for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+        B_elems[k].j = col[k];
+        B_elems[k].a = D->vals[k];
+      }
+    }
+    xfree(col);
+    csr_t csr = { row_start, B_elems };
+    sparse_t B = { sparse_format_csr, M, N, nnz, { .csr = csr }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_delta_to_csr ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_delta format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in csr_delta format to any specified format
+   @param (A) a sparse matrix in csr_delta format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_csr_delta_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_csr_delta) {
+    switch (format) {
+    case sparse_format_csr:
+      return sparse_csr_delta_to_csr(A);
+    case sparse_format_csr_delta:
+      return A;
+    default: {
+      sparse_t B = sparse_csr_delta_to_csr(A);
+      sparse_t C = sparse_csr_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_delta format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix in tiled format to coo format.
+   @param (A) a sparse matrix in tiled format
+   @return a sparse matrix in coo format
+   @details elements come out in the order of tiles, so the result
+   is not sorted by rows unless A has a single column segment
+ */
+static sparse_t sparse_tiled_to_coo(sparse_t A) {
+  printf("%s:%d:sparse_tiled_to_coo starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_tiled) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t nnz = A.nnz;
+    tiled_t * T = &A.tiled;
+    nnz_t n_rows = T->tile_start[T->n_row_blocks * T->n_col_segs];
+    coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (nnz_t r = 0; r < n_rows; r++) {
+      for (nnz_t k = T->row_start[r]; k < T->row_start[r + 1]; k++) {
+        B_elems[k].i = T->row[r];
+        B_elems[k].j = T->col[k];
+        B_elems[k].a = T->val[k];
+      }
+    }
+    coo_t coo = { B_elems };
+    sparse_t B = { sparse_format_coo, M, N, nnz, { .coo = coo }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_tiled_to_coo ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in tiled format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in tiled format to any specified format
+   @param (A) a sparse matrix in tiled format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_tiled_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_tiled) {
+    switch (format) {
+    case sparse_format_coo:
+      return sparse_tiled_to_coo(A);
+    case sparse_format_tiled:
+      return A;
+    default: {
+      sparse_t B = sparse_tiled_to_coo(A);
+      sparse_t C = sparse_coo_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in tiled format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix in csr_sym format to coo format.
+   @param (A) a sparse matrix in csr_sym format
+   @return a sparse matrix in coo format, having both (i,j) and (j,i)
+   for each element off the diagonal
+ */
+static sparse_t sparse_csr_sym_to_coo(sparse_t A) {
+  printf("%s:%d:sparse_csr_sym_to_coo starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  if (A.format == sparse_format_csr_sym) {
+    idx_t M = A.M;
+    idx_t N = A.N;
+    nnz_t * row_start = A.csr.row_start;
+    csr_elem_t * A_elems = A.csr.elems;
+    /* where the elements of each row and their mirrors start in the output */
+    nnz_t * out_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (idx_t i = 0; i < M; i++) {
+      nnz_t len = row_start[i + 1] - row_start[i];
+      int diag = (len > 0 && A_elems[row_start[i]].j == i);
+      out_start[i] = 2 * len - diag;
+    }
+    out_start[M] = 0;
+    nnz_t nnz = parallel_exclusive_scan(out_start, M + 1);
+    coo_elem_t * B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (idx_t i = 0; i < M; i++) {
+      nnz_t o = out_start[i];
+      for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+        csr_elem_t * e = A_elems + k;
+        B_elems[o].i = i;
+        B_elems[o].j = e->j;
+        B_elems[o].a = e->a;
+        o++;
+        if (e->j != i) {
+          B_elems[o].i = e->j;
+          B_elems[o].j = i;
+          B_elems[o].a = e->a;
+          o++;
+        }
+      }
+      assert(o == out_start[i + 1]);
+    }
+    xfree(out_start);
+    coo_t coo = { B_elems };
+    sparse_t B = { sparse_format_coo, M, N, nnz, { .coo = coo }, 0, 0 };
+    long t1 = cur_time_ns();
+    printf("%s:%d:sparse_csr_sym_to_coo ends. took %.3f sec\n",
+           __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+    return B;
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_sym format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert sparse matrix in csr_sym format to any specified format
+   @param (A) a sparse matrix in csr_sym format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+static sparse_t sparse_csr_sym_to_any(sparse_t A, sparse_format_t format) {
+  if (A.format == sparse_format_csr_sym) {
+    switch (format) {
+    case sparse_format_coo:
+      return sparse_csr_sym_to_coo(A);
+    case sparse_format_csr_sym:
+      return A;
+    default: {
+      sparse_t B = sparse_csr_sym_to_coo(A);
+      sparse_t C = sparse_coo_to_any(B, format);
+      sparse_destroy(B);
+      return C;
+    }
+    }
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: input matrix not in csr_sym format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+
+/**
+   @brief convert a sparse matrix of any format to any specified format
+   @param (A) a sparse matrix in csr format
+   @param (format) the destination format
+   @return a sparse format in the specified format
+ */
+sparse_t sparse_any_to_any(sparse_t A, sparse_format_t format) {
+  switch (A.format) {
+  case sparse_format_coo:
+    return sparse_coo_to_any(A, format);
+  case sparse_format_coo_sorted:
+    return sparse_coo_to_any(A, format);
+  case sparse_format_csr:
+    return sparse_csr_to_any(A, format);
+  case sparse_format_sell:
+    return sparse_sell_to_any(A, format);
+  case sparse_format_bcsr:
+    return sparse_bcsr_to_any(A, format);
+  case sparse_format_csr_soa:
+    return sparse_csr_soa_to_any(A, format);
+  case sparse_format_csr_delta:
+    return sparse_csr_delta_to_any(A, format);
+  case sparse_format_tiled:
+    return sparse_tiled_to_any(A, format);
+  case sparse_format_csr_sym:
+    return sparse_csr_sym_to_any(A, format);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid input format %d\n",
+            __FILE__, __LINE__, format);
+    return mk_sparse_invalid();
+  }
+}
+/*********************************************************
+ *
+ * make (generate or read) a sparse matrix
+ *
+ *********************************************************/
+
+/** 
+    @brief the header of a matrix file, parsed by read_coo_header
+*/
+typedef struct {
+  int mm;                       /**< 1 if Matrix Market, 0 if plain coo */
+  int pattern;                  /**< 1 if elements have no values (all 1.0) */
+  int symm;                     /**< 0 : general, 1 : symmetric, -1 : skew-symmetric */
+  long M;                       /**< rows (Matrix Market only) */
+  long N;                       /**< columns (Matrix Market only) */
+  long nnz;                     /**< entries (Matrix Market only) */
+  size_t data;                  /**< offset of the first entry */
+} coo_file_header_t;
+
+/** 
+    @brief skip spaces and tabs
+    @param (p) the current position
+    @param (end) the end of the buffer
+    @return the first position that is neither a space nor a tab
+*/
+static inline const char * skip_blanks(const char * p, const char * end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+  return p;
+}
+
+/** 
+    @brief the position just after the next newline
+*/
+static inline const char * next_line(const char * p, const char * end) {
+  const char * q = (const char *)memchr(p, '\n', end - p);
+  return (q ? q + 1 : end);
+}
+
+/** 
+    @brief 1 if p is at the end of a line or at a comment
+*/
+static inline int at_line_end(const char * p, const char * end) {
+  return (p == end || *p == '\n' || *p == '%' || *p == '#');
+}
+
+/** 
+    @brief parse a non-negative decimal integer
+    @param (p) the current position
+    @param (end) the end of the buffer
+    @param (x) the parsed value
+    @return the position after the integer, or 0 if there is none
+    or it does not fit in long
+*/
+static inline const char * parse_long(const char * p, const char * end, long * x) {
+  p = skip_blanks(p, end);
+  if (p == end || *p < '0' || *p > '9') return 0;
+  long v = 0;
+  while (p < end && *p >= '0' && *p <= '9') {
+    long d = *p - '0';
+    if (v > (LONG_MAX - d) / 10) return 0;
+    v = v * 10 + d;
+    p++;
+  }
+  *x = v;
+  return p;
+}
+
+/** 
+    @brief parse a decimal floating point number ([-+]d[.d][(e|E)[-+]d])
+    @param (p) the current position
+    @param (end) the end of the buffer
+    @param (x) the parsed value
+    @return the position after the number, or 0 if there is none
+    @details the first 19 significant digits go into an integer
+    mantissa, which is then scaled by a power of ten.  the result
+    may differ from strtod's correctly rounded one in the last bit
+    or so, which is more than good enough for matrix elements.
+*/
+static inline const char * parse_real(const char * p, const char * end, real * x) {
+  p = skip_blanks(p, end);
+  int neg = 0;
+  if (p < end && (*p == '-' || *p == '+')) {
+    neg = (*p == '-');
+    p++;
+  }
+  uint64_t m = 0;
+  int n_digits = 0;             /* significant digits in m */
+  int e10 = 0;                  /* x = m * 10^e10 */
+  int any = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    any = 1;
+    if (n_digits < 19) {
+      m = m * 10 + (*p - '0');
+      if (m) n_digits++;
+    } else {
+      e10++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      any = 1;
+      if (n_digits < 19) {
+        m = m * 10 + (*p - '0');
+        if (m) n_digits++;
+        e10--;
+      }
+    }
+  }
+  if (!any) return 0;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    p++;
+    int eneg = 0;
+    if (p < end && (*p == '-' || *p == '+')) {
+      eneg = (*p == '-');
+      p++;
+    }
+    long e;
+    p = parse_long(p, end, &e);
+    if (!p) return 0;
+    if (e > 10000) e = 10000;
+    e10 += (eneg ? -e : e);
+  }
+  static const double pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  double v = (double)m;
+  if (m == 0) {
+    v = 0.0;
+  } else if (e10 >= 0 && e10 <= 22) {
+    v *= pow10[e10];
+  } else if (e10 < 0 && e10 >= -22) {
+    v /= pow10[-e10];
+  } else {
+    v *= pow(10.0, e10);
+  }
+  *x = (real)(neg ? -v : v);
+  return p;
+}
+
+/** 
+    @brief parse the header of a matrix file
+    @param (buf) the contents of the file
+    @param (sz) the size of the file
+    @param (file) the file name (for error messages)
+    @param (h) the parsed header
+    @return 1 if succeed, 0 if failed
+    @details a Matrix Market file starts with a banner
+    (%%MatrixMarket matrix coordinate real|integer|pattern
+    general|symmetric|skew-symmetric), comments (%...) and the size
+    line (M N nnz).  any other file is plain coo; its comments (#...
+    or %...) need not be skipped here, as the parser skips them
+    anyway.
+*/
+static int read_coo_header(const char * buf, size_t sz, const char * file,
+                           coo_file_header_t * h) {
+  const char * end = buf + sz;
+  const char * banner = "%%MatrixMarket";
+  size_t bl = strlen(banner);
+  h->mm = 0;
+  h->pattern = 0;
+  h->symm = 0;
+  h->M = h->N = h->nnz = 0;
+  h->data = 0;
+  if (sz < bl || strncasecmp(buf, banner, bl) != 0) {
+    return 1;
+  }
+  h->mm = 1;
+  const char * eol = next_line(buf, end);
+  char line[256];
+  size_t ll = eol - buf;
+  if (ll >= sizeof(line)) ll = sizeof(line) - 1;
+  memcpy(line, buf, ll);
+  line[ll] = 0;
+  char obj[64] = "", fmt[64] = "", field[64] = "", symm[64] = "";
+  sscanf(line + bl, "%63s %63s %63s %63s", obj, fmt, field, symm);
+  if (strcasecmp(obj, "matrix") != 0 || strcasecmp(fmt, "coordinate") != 0) {
+    fprintf(stderr,
+            "error:%s:%d: %s: only \"matrix coordinate\" Matrix Market files"
+            " are supported (got \"%s %s\")\n",
+            __FILE__, __LINE__, file, obj, fmt);
+    return 0;
+  }
+  if (strcasecmp(field, "pattern") == 0) {
+    h->pattern = 1;
+  } else if (strcasecmp(field, "real") != 0
+             && strcasecmp(field, "integer") != 0
+             && strcasecmp(field, "double") != 0) {
+    fprintf(stderr,
+            "error:%s:%d: %s: unsupported field \"%s\""
+            " (must be real, integer or pattern)\n",
+            __FILE__, __LINE__, file, field);
+    return 0;
+  }
+  if (strcasecmp(symm, "symmetric") == 0) {
+    h->symm = 1;
+  } else if (strcasecmp(symm, "skew-symmetric") == 0) {
+    h->symm = -1;
+  } else if (strcasecmp(symm, "general") != 0) {
+    fprintf(stderr,
+            "error:%s:%d: %s: unsupported symmetry \"%s\""
+            " (must be general, symmetric or skew-symmetric)\n",
+            __FILE__, __LINE__, file, symm);
+    return 0;
+  }
+  /* skip comments up to the size line */
+  const char * p = eol;
+  while (p < end) {
+    const char * q = skip_blanks(p, end);
+    if (q < end && *q != '%' && *q != '\n') break;
+    p = next_line(p, end);
+  }
+  const char * q = p;
+  if (!(q = parse_long(q, end, &h->M))
+      || !(q = parse_long(q, end, &h->N))
+      || !(q = parse_long(q, end, &h->nnz))) {
+    fprintf(stderr,
+            "error:%s:%d: %s: invalid size line (must be M N nnz)\n",
+            __FILE__, __LINE__, file);
+    return 0;
+  }
+  h->data = next_line(q, end) - buf;
+  return 1;
+}
+
+/** 
+    @brief parse the entries in a range of lines of a matrix file
+    @param (p) the first line
+    @param (end) the end of the range (just after a newline or the
+    end of the file)
+    @param (h) the header of the file
+    @param (elems) if not null, the elements are written to it
+    @param (ij_max) the largest row and column indices are stored
+    to ij_max[0] and ij_max[1] (0-based)
+    @param (err) the position of a malformed line is stored to it
+    @return the number of elements (counting mirrored ones of
+    symmetric matrices), or -1 on a malformed line
+*/
+static long parse_coo_lines(const char * p, const char * end,
+                            const coo_file_header_t * h, coo_elem_t * elems,
+                            long ij_max[2], const char ** err) {
+  long n = 0;
+  long base = (h->mm ? 1 : 0);
+  while (p < end) {
+    const char * q = skip_blanks(p, end);
+    if (at_line_end(q, end)) {
+      p = next_line(q, end);
+      continue;
+    }
+    long i, j;
+    real a = 1.0;
+    if (!(q = parse_long(q, end, &i))
+        || !(q = parse_long(q, end, &j))
+        || i < base || j < base) {
+      *err = p;
+      return -1;
+    }
+    i -= base;
+    j -= base;
+    if (!h->pattern) {
+      /* a plain coo line may end after i j (a = 1.0) */
+      const char * r = skip_blanks(q, end);
+      if (h->mm || !at_line_end(r, end)) {
+        if (!(q = parse_real(r, end, &a))) {
+          *err = p;
+          return -1;
+        }
+      }
+    }
+    q = skip_blanks(q, end);
+    if (!at_line_end(q, end)) {
+      *err = p;
+      return -1;
+    }
+    if (i > ij_max[0]) ij_max[0] = i;
+    if (j > ij_max[1]) ij_max[1] = j;
+    if (elems) {
+      elems[n].i = (idx_t)i;
+      elems[n].j = (idx_t)j;
+      elems[n].a = a;
+    }
+    n++;
+    if (h->symm && i != j) {
+      if (elems) {
+        elems[n].i = (idx_t)j;
+        elems[n].j = (idx_t)i;
+        elems[n].a = (h->symm > 0 ? a : -a);
+      }
+      n++;
+    }
+    p = next_line(q, end);
+  }
+  return n;
+}
+
+/**
+   @brief read a matrix file and return a sparse matrix in coo formated
+   @param (M) the number of rows (unused; taken from the file)
+   @param (N) the number of columns (unused; taken from the file)
+   @param (nnz) the number of non-zeros (unused; taken from the file)
+   @param (file) filename
+   @return a sparse matrix in coo format
+   @details the file is either Matrix Market (see read_coo_header)
+   or plain coo, in which each line is i j [a] with 0-based i and j
+   (a is 1.0 if omitted), and the matrix is as large as its largest
+   indices.  both of symmetric and skew-symmetric Matrix Market
+   matrices are expanded to general ones.
+
+   the file is mmapped and split into a few chunks per thread, each
+   starting just after a newline.  every chunk is parsed twice in
+   parallel; first to count its elements and then, after a scan of
+   the counts, to write them right at their final place in the
+   elements array.  nothing is copied in between, so it is bound by
+   how fast the pages come in (from the page cache or the disk).
+ */
+static sparse_t read_coo_file(idx_t M, idx_t N, nnz_t nnz, char * file) {
+  (void)M;
+  (void)N;
+  (void)nnz;
+  printf("%s:%d:read_coo_file starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  int fd = open(file, O_RDONLY);
+  if (fd == -1) {
+    perror(file);
+    return mk_sparse_invalid();
+  }
+  struct stat sb[1];
+  if (fstat(fd, sb) == -1) {
+    perror(file);
+    close(fd);
+    return mk_sparse_invalid();
+  }
+  size_t sz = sb->st_size;
+  const char * buf = 0;
+  if (sz > 0) {
+    void * m = mmap(0, sz, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (m == MAP_FAILED) {
+      perror("mmap");
+      close(fd);
+      return mk_sparse_invalid();
+    }
+    madvise(m, sz, MADV_SEQUENTIAL | MADV_WILLNEED);
+    buf = (const char *)m;
+  }
+  close(fd);
+  coo_file_header_t h[1];
+  if (!read_coo_header(buf, sz, file, h)) {
+    if (buf) munmap((void *)buf, sz);
+    return mk_sparse_invalid();
+  }
+  /* split entries into chunks beginning just after a newline */
+  const char * data = buf + h->data;
+  const char * end = buf + sz;
+  size_t data_sz = end - data;
+  int n_chunks = 4 * get_n_threads();
+  const char ** chunk = (const char **)xalloc(sizeof(const char *) * (n_chunks + 1));
+  nnz_t * count = (nnz_t *)xalloc(sizeof(nnz_t) * (n_chunks + 1));
+  long * ij_max = (long *)xalloc(sizeof(long) * 2 * n_chunks);
+  const char ** err = (const char **)xalloc(sizeof(const char *) * n_chunks);
+  chunk[0] = data;
+  chunk[n_chunks] = end;
+  for (int c = 1; c < n_chunks; c++) {
+    const char * p = data + data_sz * c / n_chunks;
+    chunk[c] = (p == data ? data : next_line(p - 1, end));
+  }
+  for (int c = 1; c < n_chunks; c++) {
+    if (chunk[c] < chunk[c - 1]) chunk[c] = chunk[c - 1];
+  }
+  int ok = 1;
+  long n_total = 0;
+  /* count */
+#pragma omp parallel for schedule(dynamic, 1) reduction(&&:ok) reduction(+:n_total)
+  for (int c = 0; c < n_chunks; c++) {
+    ij_max[2 * c] = ij_max[2 * c + 1] = -1;
+    err[c] = 0;
+    long n = parse_coo_lines(chunk[c], chunk[c + 1], h, 0, ij_max + 2 * c, err + c);
+    count[c] = (nnz_t)n;
+    n_total += (n > 0 ? n : 0);
+    ok = ok && (n >= 0);
+  }
+  if (!ok) {
+    for (int c = 0; c < n_chunks; c++) {
+      if (err[c]) {
+        fprintf(stderr,
+                "error:%s:%d: %s: malformed entry at byte %ld\n",
+                __FILE__, __LINE__, file, (long)(err[c] - buf));
+        break;
+      }
+    }
+  }
+  long rows = 0, cols = 0;
+  for (int c = 0; c < n_chunks; c++) {
+    if (ij_max[2 * c] + 1 > rows) rows = ij_max[2 * c] + 1;
+    if (ij_max[2 * c + 1] + 1 > cols) cols = ij_max[2 * c + 1] + 1;
+  }
+  if (ok && h->mm) {
+    if (rows > h->M || cols > h->N) {
+      fprintf(stderr,
+              "error:%s:%d: %s: index (%ld,%ld) out of the %ld x %ld matrix\n",
+              __FILE__, __LINE__, file, rows, cols, h->M, h->N);
+      ok = 0;
+    }
+    rows = h->M;
+    cols = h->N;
+  }
+  /* the entries must not overflow idx_t/nnz_t before we store them */
+  if (ok) {
+    ok = sparse_shape_ok(file, rows, cols, n_total);
+  }
+  nnz_t n_elems = (ok ? parallel_exclusive_scan(count, n_chunks) : 0);
+  coo_elem_t * elems = 0;
+  if (ok) {
+    /* parse again, this time writing elements */
+    elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * n_elems);
+#pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n_chunks; c++) {
+      long ij[2] = { -1, -1 };
+      const char * e = 0;
+      parse_coo_lines(chunk[c], chunk[c + 1], h, elems + count[c], ij, &e);
+    }
+  }
+  xfree(chunk);
+  xfree(count);
+  xfree(ij_max);
+  xfree(err);
+  if (buf) munmap((void *)buf, sz);
+  if (!ok) {
+    return mk_sparse_invalid();
+  }
+  if (h->mm) {
+    long n_entries = (h->symm ? -1 : (long)n_elems);
+    if (n_entries >= 0 && n_entries != h->nnz) {
+      fprintf(stderr,
+              "warning:%s:%d: %s: the header says %ld entries but has %ld\n",
+              __FILE__, __LINE__, file, h->nnz, n_entries);
+    }
+  }
+  coo_t coo = { elems };
+  sparse_t A = { sparse_format_coo, (idx_t)rows, (idx_t)cols, n_elems,
+                 { .coo = coo }, 0, 0 };
+  long t1 = cur_time_ns();
+  printf("%s:%d:read_coo_file ends. %ld bytes, %ld x %ld with %ld non-zeros."
+         " took %.3f sec (%.3f GB/s)\n",
+         __FILE__, __LINE__, (long)sz, rows, cols, (long)n_elems,
+         (t1 - t0) * 1.0e-9, sz / (double)(t1 - t0));
+  return A;
+}
+
+static sparse_t mk_sparse_matrix_coo(cmdline_options_t opt,
+                                     idx_t M, idx_t N, nnz_t nnz,
+                                     unsigned short rg[3]) {
+  switch (opt.matrix_type) {
+  case sparse_matrix_type_random:
+    return mk_coo_random(M, N, nnz, rg);
+  case sparse_matrix_type_rmat:
+    return mk_coo_rmat(M, N, nnz, opt.rmat, rg);
+  case sparse_matrix_type_one:
+    return mk_coo_one(M, N, nnz);
+  case sparse_matrix_type_coo_file:
+    return read_coo_file(M, N, nnz, opt.coo_file);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid matrix_type %d\n",
+            __FILE__, __LINE__, opt.matrix_type);
+    return mk_sparse_invalid();
+  }
+}
+
+/** 
+    @brief check if a matrix made with the options may be stored in
+    csr_sym when it is symmetric
+    @param (opt) command line options
+    @return 1 if csr is asked for, the matrix is read from a file or
+    made by mk_coo_one, and nothing that needs csr (--fused,
+    --fused-norm, --precision mixed or cuda) is specified
+*/
+static int sparse_sym_detect(cmdline_options_t opt) {
+  return (opt.format == sparse_format_csr
+          && (opt.matrix_type == sparse_matrix_type_coo_file
+              || opt.matrix_type == sparse_matrix_type_one)
+          && !opt.fused && !opt.fused_norm && !opt.mixed
+          && opt.algo != spmv_algo_cuda);
+}
+
+/** 
+    @brief make (read or generate) a sparse matrix with the specified 
+    matrix generation method
+
+    @param (opt) command line options specifying matrix format, 
+    matrix type, and other parameters necessary for some matrix types
+    @param (M) the number of rows
+    @param (N) the number of columns
+    @param (nnz) the number of non-zeros
+    @param (rg) random number generator state (passed to erand48)
+    @return a sparse matrix in coo format
+    @details a symmetric matrix is stored in csr_sym in place of csr
+    (see sparse_sym_detect)
+    @sa mk_sparse_matrix_coo
+    @sa sparse_coo_to
+*/
+static sparse_t mk_sparse_matrix(cmdline_options_t opt,
+                                 idx_t M, idx_t N, nnz_t nnz,
+                                 unsigned short rg[3]) {
+  sparse_t A = mk_sparse_matrix_coo(opt, M, N, nnz, rg);
+  if (A.format == sparse_format_invalid) return A;
+  sparse_t B;
+  if (sparse_sym_detect(opt) && coo_is_symmetric(A)) {
+    printf("%s:%d:mk_sparse_matrix: A is symmetric, stored in csr_sym\n",
+           __FILE__, __LINE__);
+    /* checked just now; sparse_coo_to_any would check it again */
+    B = sparse_coo_sym_to_csr_sym(A);
+  } else {
+    B = sparse_coo_to_any(A, opt.format);
+  }
+  sparse_destroy(A);
+  return B;
+}
+
+/*********************************************************
+ *
+ * transpose a sparse matrix
+ *
+ *********************************************************/
+
+/** 
+    @brief transpose a matrix in coordinate list format
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @return the transposed sparse matrix in coo format
+    @sa sparse_transpose
+*/
+static sparse_t coo_transpose(sparse_t A) {
+  printf("%s:%d:coo_transpose starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  assert(A.format == sparse_format_coo
+         || A.format == sparse_format_coo_sorted);
+  nnz_t nnz = A.nnz;
+  coo_elem_t * B_elems = 0;
+  B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
+  coo_elem_t * A_elems = A.coo.elems;
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    B_elems[k].i = A_elems[k].j;
+    B_elems[k].j = A_elems[k].i;
+    B_elems[k].a = A_elems[k].a;
+  }
+  coo_t coo = { B_elems };
+  sparse_t B = { sparse_format_coo, A.N, A.M, nnz, { .coo = coo }, 0, 0 };
+  long t1 = cur_time_ns();
+  printf("%s:%d:coo_transpose ends. took %.3f sec\n",
+         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+  return B;
+}
+
+/** 
+    @brief transpose a matrix in csr_sym format
+    @param (A) a sparse matrix in csr_sym format
+    @return A itself without its partition, as A is symmetric
+    @details the result shares the arrays of A and is marked mapped,
+    so destroying it does not free them.  it must not outlive A.
+*/
+static sparse_t csr_sym_transpose(sparse_t A) {
+  assert(A.format == sparse_format_csr_sym);
+  sparse_t B = A;
+  B.part = 0;
+  B.mapped = 1;
+  return B;
+}
+
+/** 
+    @brief transpose a matrix in any format
+    @param (A) a sparse matrix
+    @return the transposed matrix in the same format with A
+    @sa coo_transpose
+*/
+static sparse_t sparse_transpose(sparse_t A) {
+  switch (A.format) {
+  case sparse_format_csr_sym:
+    return csr_sym_transpose(A);
+  case sparse_format_coo: {
+    return coo_transpose(A);
+  }
+  case sparse_format_coo_sorted: {
+    sparse_t B = coo_transpose(A);
+    sparse_t C = sparse_coo_to_coo(B, sparse_format_coo_sorted);
+    sparse_destroy(B);
+    return C;
+  }
+  case sparse_format_csr: {
+    sparse_t B = sparse_csr_to_coo_sorted(A);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_csr(C);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  case sparse_format_sell: {
+    sparse_t B = sparse_sell_to_coo_sorted(A);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_any(C, sparse_format_sell);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  case sparse_format_bcsr: {
+    sparse_t B = sparse_bcsr_to_coo_sorted(A);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_any(C, sparse_format_bcsr);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  case sparse_format_csr_soa: {
+    sparse_t B = sparse_csr_soa_to_any(A, sparse_format_coo_sorted);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_any(C, sparse_format_csr_soa);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  case sparse_format_csr_delta: {
+    sparse_t B = sparse_csr_delta_to_any(A, sparse_format_coo_sorted);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_any(C, sparse_format_csr_delta);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  case sparse_format_tiled: {
+    sparse_t B = sparse_tiled_to_coo(A);
+    sparse_t C = coo_transpose(B);
+    sparse_t D = sparse_coo_to_any(C, sparse_format_tiled);
+    sparse_destroy(B);
+    sparse_destroy(C);
+    return D;
+  }
+  default: {
+    fprintf(stderr,
+            "error:%s:%d: invalid format %d\n",
+            __FILE__, __LINE__, A.format);
+    return mk_sparse_invalid();
+  }
+  }
+}
+
+/*********************************************************
+ *
+ * partition a sparse matrix among threads
+ *
+ *********************************************************/
+
+/** 
+    @brief allocate a partition of n parts
+    @param (n) the number of parts
+    @return a partition whose arrays are not initialized yet
+*/
+static sparse_part_t * mk_sparse_part(int n) {
+  sparse_part_t * part = (sparse_part_t *)xalloc(sizeof(sparse_part_t));
+  part->n = n;
+  part->row_start  = (idx_t *)xalloc(sizeof(idx_t) * (n + 1));
+  part->elem_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n + 1));
+  part->buf = 0;
+  part->buf_lo = part->buf_hi = 0;
+  part->buf_off = 0;
+  part->carry = 0;
+  part->grain = 0;
+  part->hubs = 0;
+  part->n_colors = 0;
+  part->color_start = 0;
+  part->color_part = 0;
+  return part;
+}
+
+/** 
+    @brief partition rows (or any items whose elements are given by a
+    prefix sum) into n ranges of equal work
+    @param (M) the number of rows
+    @param (row_start) elements of row i are [row_start[i], row_start[i+1])
+    @param (n) the number of parts
+    @return the partition
+    @details the work of rows [0,i) is counted as i + row_start[i],
+    i.e., a row costs one plus the number of its non-zeros, which is
+    the merge path of the row_start array and the elements.  the
+    boundary of part p is the first row whose work reaches p/n of the
+    total, found by a binary search on row_start.  counting rows too
+    keeps a part with many empty rows from getting all non-zeros of
+    its neighbors on top of them.  a single row is never split, so a
+    row with more than 1/n of all non-zeros makes its part heavier
+    than the others.
+*/
+static sparse_part_t * prefix_partition(idx_t M, nnz_t * row_start, int n) {
+  sparse_part_t * part = mk_sparse_part(n);
+  long work = (long)M + (long)row_start[M];
+  for (int p = 0; p <= n; p++) {
+    long w = work * p / n;
+    /* the first row i such that i + row_start[i] >= w */
+    idx_t lo = 0, hi = M;
+    while (lo < hi) {
+      idx_t mid = lo + (hi - lo) / 2;
+      if ((long)mid + (long)row_start[mid] < w) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    part->row_start[p] = lo;
+    part->elem_start[p] = row_start[lo];
+  }
+  assert(part->row_start[0] == 0);
+  assert(part->row_start[n] == M);
+  return part;
+}
+
+/** 
+    @brief partition rows of a csr matrix into n ranges of equal work
+    @param (A) a sparse matrix in csr format
+    @param (n) the number of parts
+    @return the partition
+    @sa prefix_partition
+*/
+static sparse_part_t * csr_partition(sparse_t A, int n) {
+  return prefix_partition(A.M, A.csr.row_start, n);
+}
+
+/** 
+    @brief partition chunks of a sell matrix into n ranges of equal work
+    @param (A) a sparse matrix in sell format
+    @param (n) the number of parts
+    @return the partition, whose row_start is in the unit of chunks
+    @details the same as csr_partition, with chunks in place of rows
+    (padding elements count as work, as they are processed too)
+*/
+static sparse_part_t * sell_partition(sparse_t A, int n) {
+  return prefix_partition(A.sell.n_chunks, A.sell.chunk_start, n);
+}
+
+/** 
+    @brief partition block rows of a bcsr matrix into n ranges of equal work
+    @param (A) a sparse matrix in bcsr format
+    @param (n) the number of parts
+    @return the partition, whose row_start is in the unit of block rows
+    and elem_start in the unit of blocks
+*/
+static sparse_part_t * bcsr_partition(sparse_t A, int n) {
+  return prefix_partition(A.bcsr.n_block_rows, A.bcsr.block_row_start, n);
+}
+
+/** 
+    @brief partition rows of a csr_soa matrix into n ranges of equal work
+    @param (A) a sparse matrix in csr_soa format
+    @param (n) the number of parts
+    @return the partition
+    @sa prefix_partition
+*/
+static sparse_part_t * csr_soa_partition(sparse_t A, int n) {
+  return prefix_partition(A.M, A.csr_soa.row_start, n);
+}
+
+/** 
+    @brief partition rows of a csr_delta matrix into n ranges of equal work
+    @param (A) a sparse matrix in csr_delta format
+    @param (n) the number of parts
+    @return the partition
+    @sa prefix_partition
+*/
+static sparse_part_t * csr_delta_partition(sparse_t A, int n) {
+  return prefix_partition(A.M, A.csr_delta.row_start, n);
+}
+
+/** 
+    @brief partition row blocks of a tiled matrix into n ranges of equal work
+    @param (A) a sparse matrix in tiled format
+    @param (n) the number of parts
+    @return the partition, whose row_start is in the unit of row blocks
+    @sa prefix_partition
+*/
+static sparse_part_t * tiled_partition(sparse_t A, int n) {
+  tiled_t * T = &A.tiled;
+  idx_t n_row_blocks = T->n_row_blocks;
+  idx_t S = T->n_col_segs;
+  /* elements of row block I are [block_start[I], block_start[I+1]) */
+  nnz_t * block_start = (nnz_t *)xalloc(sizeof(nnz_t) * (n_row_blocks + 1));
+  for (idx_t I = 0; I <= n_row_blocks; I++) {
+    block_start[I] = T->row_start[T->tile_start[I * S]];
+  }
+  sparse_part_t * part = prefix_partition(n_row_blocks, block_start, n);
+  xfree(block_start);
+  return part;
+}
+
+/** @brief csr_sym_partition colors this many row blocks per thread */
+static const int csr_sym_blocks_per_thread = 4;
+/** @brief csr_sym_partition uses colors only when it needs at most
+    this many of them; each is a barrier, and fewer blocks per color
+    leave threads idle */
+static const int csr_sym_max_colors = 4;
+
+/** 
+    @brief the rows each part of a csr_sym matrix writes
+    @param (A) a sparse matrix in csr_sym format
+    @param (part) a partition of its rows
+    @return an array whose pth element is one past the last row part
+    p writes (its last row or the largest column of its rows)
+*/
+static idx_t * csr_sym_part_reach(sparse_t A, sparse_part_t * part) {
+  nnz_t * row_start = A.csr.row_start;
+  csr_elem_t * elems = A.csr.elems;
+  idx_t * reach = (idx_t *)xalloc(sizeof(idx_t) * part->n);
+#pragma omp parallel for schedule(dynamic, 1)
+  for (int p = 0; p < part->n; p++) {
+    idx_t hi = part->row_start[p + 1];
+    for (idx_t i = part->row_start[p]; i < part->row_start[p + 1]; i++) {
+      /* columns are sorted, so the last one is the largest */
+      if (row_start[i] < row_start[i + 1]) {
+        idx_t j = elems[row_start[i + 1] - 1].j;
+        if (j + 1 > hi) hi = j + 1;
+      }
+    }
+    reach[p] = hi;
+  }
+  return reach;
+}
+
+/** 
+    @brief partition rows of a csr_sym matrix for a conflict-free
+    parallel spmv
+    @param (A) a sparse matrix in csr_sym format
+    @param (n) the number of threads
+    @return the partition
+    @details rows [r0, r1) of a part write y[r0] ... y[hi-1] (hi from
+    csr_sym_part_reach), as each element (i,j) is scattered to y[j]
+    too.  the rows are first split into csr_sym_blocks_per_thread x n
+    blocks of equal work, which are colored greedily in the order of
+    rows, so that no two blocks of a color write the same element
+    (intervals, so this uses the fewest colors).  a banded matrix
+    needs only two or three of them.  if it needs more than
+    csr_sym_max_colors, the rows are split into n parts instead, and
+    part p writes y[r1] ... y[hi-1] to a private copy of y
+    (buf_lo[p] = r1, buf_hi[p] = hi), later added to y by the parts
+    owning those rows (see spmv_csr_sym_parallel).
+*/
+static sparse_part_t * csr_sym_partition(sparse_t A, int n) {
+  idx_t M = A.M;
+  nnz_t * row_start = A.csr.row_start;
+  int n_blocks = csr_sym_blocks_per_thread * n;
+  sparse_part_t * part = prefix_partition(M, row_start, n_blocks);
+  idx_t * reach = csr_sym_part_reach(A, part);
+  int * color = (int *)xalloc(sizeof(int) * n_blocks);
+  /* the reach of the last block of each color */
+  idx_t * color_reach = (idx_t *)xalloc(sizeof(idx_t) * n_blocks);
+  int n_colors = 0;
+  for (int b = 0; b < n_blocks; b++) {
+    int c = 0;
+    while (c < n_colors && color_reach[c] > part->row_start[b]) c++;
+    if (c == n_colors) n_colors++;
+    color[b] = c;
+    color_reach[c] = reach[b];
+  }
+  xfree(color_reach);
+  xfree(reach);
+  if (n_colors <= csr_sym_max_colors) {
+    part->n_colors = n_colors;
+    part->color_start = (int *)xalloc(sizeof(int) * (n_colors + 1));
+    part->color_part = (int *)xalloc(sizeof(int) * n_blocks);
+    for (int c = 0; c <= n_colors; c++) {
+      part->color_start[c] = 0;
+    }
+    for (int b = 0; b < n_blocks; b++) {
+      part->color_start[color[b] + 1]++;
+    }
+    for (int c = 0; c < n_colors; c++) {
+      part->color_start[c + 1] += part->color_start[c];
+    }
+    int * pos = (int *)xalloc(sizeof(int) * n_colors);
+    memcpy(pos, part->color_start, sizeof(int) * n_colors);
+    for (int b = 0; b < n_blocks; b++) {
+      part->color_part[pos[color[b]]++] = b;
+    }
+    xfree(pos);
+    xfree(color);
+    printf("%s:%d:csr_sym_partition: %d blocks in %d colors\n",
+           __FILE__, __LINE__, n_blocks, n_colors);
+    return part;
+  }
+  xfree(color);
+  sparse_part_destroy(part);
+  part = prefix_partition(M, row_start, n);
+  reach = csr_sym_part_reach(A, part);
+  part->buf_lo  = (idx_t *)xalloc(sizeof(idx_t) * n);
+  part->buf_hi  = (idx_t *)xalloc(sizeof(idx_t) * n);
+  part->buf_off = (nnz_t *)xalloc(sizeof(nnz_t) * n);
+  long buf_sz = 0;
+  for (int p = 0; p < n; p++) {
+    part->buf_lo[p] = part->row_start[p + 1];
+    part->buf_hi[p] = reach[p];
+    part->buf_off[p] = buf_sz;
+    buf_sz += reach[p] - part->row_start[p + 1];
+  }
+  xfree(reach);
+  part->buf = (real_acc *)xalloc(sizeof(real_acc) * (buf_sz > 0 ? buf_sz : 1));
+  printf("%s:%d:csr_sym_partition: %d colors would be needed;"
+         " %d parts with %ld private elements\n",
+         __FILE__, __LINE__, n_colors, n, buf_sz);
+  return part;
+}
+
+/** 
+    @brief partition elements of a coo matrix into n equal chunks and
+    decide if the chunks accumulate into private copies of y
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @param (n) the number of parts
+    @return the partition
+    @details the private copies are combined by a binary tree
+    (see spmv_coo_parallel).  buffer p (p > 0) absorbs the buffers
+    of parts p+1 ... p+lowbit(p)-1, so it covers the rows touched by
+    all of them; buffer 0 is y itself.  the buffers cost sum of their
+    lengths in extra writes and reads.  when that exceeds nnz, i.e.,
+    the number of atomic updates they would save, we do not make
+    them and the chunks update y atomically instead.
+*/
+static sparse_part_t * coo_partition(sparse_t A, int n) {
+  nnz_t nnz = A.nnz;
+  coo_elem_t * elems = A.coo.elems;
+  sparse_part_t * part = mk_sparse_part(n);
+  idx_t * row_lo = (idx_t *)xalloc(sizeof(idx_t) * n);
+  idx_t * row_hi = (idx_t *)xalloc(sizeof(idx_t) * n);
+  for (int p = 0; p <= n; p++) {
+    part->elem_start[p] = (nnz_t)((long)nnz * p / n);
+  }
+  /* the range of rows each chunk touches */
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n; p++) {
+    idx_t lo = A.M, hi = 0;
+    for (nnz_t k = part->elem_start[p]; k < part->elem_start[p + 1]; k++) {
+      idx_t i = elems[k].i;
+      if (i < lo) lo = i;
+      if (i + 1 > hi) hi = i + 1;
+    }
+    row_lo[p] = lo;
+    row_hi[p] = hi;
+  }
+  /* the rows of the buffers of the reduction tree */
+  idx_t * buf_lo  = (idx_t *)xalloc(sizeof(idx_t) * n);
+  idx_t * buf_hi  = (idx_t *)xalloc(sizeof(idx_t) * n);
+  nnz_t * buf_off = (nnz_t *)xalloc(sizeof(nnz_t) * n);
+  long buf_sz = 0;
+  buf_lo[0] = 0;
+  buf_hi[0] = A.M;
+  buf_off[0] = 0;
+  for (int p = 1; p < n; p++) {
+    int q_end = p + (p & -p);
+    idx_t lo = A.M, hi = 0;
+    for (int q = p; q < q_end && q < n; q++) {
+      if (row_lo[q] < lo) lo = row_lo[q];
+      if (row_hi[q] > hi) hi = row_hi[q];
+    }
+    if (hi < lo) hi = lo;       /* all chunks empty */
+    buf_lo[p] = lo;
+    buf_hi[p] = hi;
+    buf_off[p] = buf_sz;
+    buf_sz += hi - lo;
+  }
+  xfree(row_lo);
+  xfree(row_hi);
+  if (buf_sz <= (long)nnz) {
+    part->buf = (real_acc *)xalloc(sizeof(real_acc) * (buf_sz > 0 ? buf_sz : 1));
+    part->buf_lo = buf_lo;
+    part->buf_hi = buf_hi;
+    part->buf_off = buf_off;
+  } else {
+    xfree(buf_lo);
+    xfree(buf_hi);
+    xfree(buf_off);
+  }
+  printf("%s:%d:coo_partition: %s (%ld private elements for %ld non-zeros)\n",
+         __FILE__, __LINE__, (part->buf ? "privatized" : "atomic"),
+         buf_sz, (long)nnz);
+  return part;
+}
+
+/** 
+    @brief partition elements of a coo_sorted matrix into n equal chunks
+    @param (A) a sparse matrix in coo_sorted format
+    @param (n) the number of parts
+    @return the partition
+    @details row_start[p] is the row of the first element of chunk p
+    (M if the chunk is empty).  a row may straddle chunks, so the
+    kernels leave the first and last row of each chunk in carry
+    (see spmv_coo_sorted_chunk).
+*/
+static sparse_part_t * coo_sorted_partition(sparse_t A, int n) {
+  nnz_t nnz = A.nnz;
+  coo_elem_t * elems = A.coo.elems;
+  sparse_part_t * part = mk_sparse_part(n);
+  for (int p = 0; p <= n; p++) {
+    nnz_t k = (nnz_t)((long)nnz * p / n);
+    part->elem_start[p] = k;
+    part->row_start[p] = (k < nnz ? elems[k].i : A.M);
+  }
+  part->carry = (real_acc *)xalloc(sizeof(real_acc) * 2 * n);
+  return part;
+}
+
+/** 
+    @brief build the partition of A among n threads, if its format
+    and the algorithm use one
+    @param (algo) the algorithm that is going to work on A
+    @param (A) the reference to a sparse matrix
+    @param (n) the number of parts (threads)
+    @details an existing partition is discarded and rebuilt
+*/
+static void sparse_partition(spmv_algo_t algo, sparse_t& A, int n) {
+  sparse_part_destroy(A.part);
+  A.part = 0;
+  if (algo == spmv_algo_serial || algo == spmv_algo_cuda) return;
+  switch (A.format) {
+  case sparse_format_coo:
+    A.part = coo_partition(A, n);
+    break;
+  case sparse_format_coo_sorted:
+    A.part = coo_sorted_partition(A, n);
+    break;
+  case sparse_format_csr:
+    A.part = csr_partition(A, n);
+    break;
+  case sparse_format_sell:
+    A.part = sell_partition(A, n);
+    break;
+  case sparse_format_bcsr:
+    A.part = bcsr_partition(A, n);
+    break;
+  case sparse_format_csr_soa:
+    A.part = csr_soa_partition(A, n);
+    break;
+  case sparse_format_csr_delta:
+    A.part = csr_delta_partition(A, n);
+    break;
+  case sparse_format_tiled:
+    A.part = tiled_partition(A, n);
+    break;
+  case sparse_format_csr_sym:
+    A.part = csr_sym_partition(A, n);
+    break;
+  default:
+    break;
+  }
+}
+
+/*********************************************************
+ *
+ * copy data from host to device (CUDA)
+ *
+ *********************************************************/
+
+#if __NVCC__
+static int coo_to_dev(sparse_t& A);
+#include "include/coo_to_dev.cc"
+
+static int csr_to_dev(sparse_t& A);
+#include "include/csr_to_dev.cc"
+
+/** 
+    @brief make a deivce copy of a sparse matrix.
+    @param (A) the reference to a matrix whose elem_dev has not 
+    been set (i.e., = NULL)
+    @return 1 if succeed, 0 if failed.
+    @sa coo_to_dev
+    @sa csr_to_dev
+    @sa vec_to_dev
+*/
+static int sparse_to_dev(sparse_t& A) {
+  switch (A.format) {
+  case sparse_format_coo: {
+    return coo_to_dev(A);
+  }
+  case sparse_format_coo_sorted: {
+    return coo_to_dev(A);
+  }
+  case sparse_format_csr: {
+    return csr_to_dev(A);
+  }
+  default: {
+    fprintf(stderr,
+            "error:%s:%d: invalid format %d\n",
+            __FILE__, __LINE__, A.format);
+    return 0;
+  }
+  }
+}
+
+static int vec_to_dev(vec_t& v);
+#include "include/vec_to_dev.cc"
+
+#endif
+
+/*********************************************************
+ *
+ * per-thread work of parallel spmv (--imbalance)
+ *
+ *********************************************************/
+
+/**
+   @brief the work a thread has done in the current spmv call
+   @details padded to a cache line, as each thread updates its own
+ */
+typedef struct {
+  long t_begin;                 /**< when it started its first piece of work (-1 if none) */
+  long t_end;                   /**< when it finished its last piece of work */
+  long busy;                    /**< the total time of its pieces of work */
+  long nnz;                     /**< the elements it processed */
+  char pad[32];                 /**< pad to 64 bytes */
+} thread_work_t;
+
+/**
+   @brief a record of the ring buffer of thread_trace_t (24 bytes)
+   @details times are nano seconds since the start of the call,
+   saturated to 32 bits (4 sec)
+ */
+typedef struct {
+  uint32_t call;                /**< the number of the spmv call */
+  uint8_t format;               /**< sparse_format_t of the matrix */
+  uint8_t algo;                 /**< spmv_algo_t */
+  uint16_t thread;              /**< the thread number */
+  uint32_t t_begin;             /**< when the thread started its work (0 if none) */
+  uint32_t t_end;               /**< when the thread finished its work */
+  int64_t nnz;                  /**< the elements the thread processed */
+} thread_trace_rec_t;
+
+/**
+   @brief imbalance of all calls for a format and an algorithm
+ */
+typedef struct {
+  long calls;                   /**< the number of calls */
+  double busy_ratio;            /**< sum of max/mean of busy time of threads */
+  double busy_ratio_max;        /**< the largest max/mean of busy time */
+  double nnz_ratio;             /**< sum of max/mean of elements of threads */
+} thread_imbalance_t;
+
+/**
+   @brief the header of a file thread_trace_dump writes, followed by
+   n_recs thread_trace_rec_t's, oldest first
+ */
+typedef struct {
+  char magic[8];                /**< "spmvthr" */
+  int version;                  /**< thread_trace_version */
+  int rec_sz;                   /**< sizeof(thread_trace_rec_t) */
+  long n_recs;                  /**< the number of records in the file */
+  long n_total;                 /**< the number of records ever written (the oldest n_total - n_recs were overwritten) */
+} thread_trace_header_t;
+
+/** @brief the version of thread_trace_header_t */
+static const int thread_trace_version = 1;
+/** @brief the number of records the ring buffer keeps */
+static const long thread_trace_capacity = 1L << 16;
+
+/**
+   @brief per-thread start/end time and elements of each parallel
+   spmv call
+   @details kernels record their pieces of work with
+   thread_work_begin / thread_work_end, which do nothing (but test a
+   pointer) unless --imbalance is given.  spmv brackets each call by
+   thread_trace_call_begin / thread_trace_call_end, which appends a
+   record per thread to a ring buffer of thread_trace_capacity
+   records and adds the call's imbalance to its format and
+   algorithm.  the imbalance is max/mean of busy time, where an idle
+   thread counts as 0, so a perfect partition is 1.0 and a single
+   thread doing everything is the number of threads.
+ */
+typedef struct {
+  int n_threads;                /**< the number of threads */
+  thread_work_t * work;         /**< work[t] : the work of thread t in the current call */
+  long t_call;                  /**< when the current call started */
+  long n_calls;                 /**< the number of calls so far */
+  thread_trace_rec_t * ring;    /**< the ring buffer */
+  long n_recs;                  /**< the number of records ever written (ring[n_recs % capacity] is next) */
+  thread_imbalance_t imb[sparse_format_invalid][spmv_algo_invalid]; /**< imbalance of each format and algorithm */
+} thread_trace_t;
+
+/** @brief the trace of the current run (null unless --imbalance) */
+static thread_trace_t * thread_trace = 0;
+
+/**
+   @brief start tracing work of threads (set thread_trace)
+ */
+static void thread_trace_start() {
+  thread_trace_t * tt = (thread_trace_t *)xalloc(sizeof(thread_trace_t));
+  memset(tt, 0, sizeof(thread_trace_t));
+  tt->n_threads = get_n_threads();
+  tt->work = (thread_work_t *)xalloc_aligned(64, sizeof(thread_work_t) * tt->n_threads);
+  tt->ring = (thread_trace_rec_t *)xalloc(sizeof(thread_trace_rec_t) * thread_trace_capacity);
+  thread_trace = tt;
+}
+
+/**
+   @brief the start of a piece of work of the calling thread
+   @return the current time if tracing, 0 otherwise
+ */
+static inline long thread_work_begin() {
+  return (thread_trace ? cur_time_ns() : 0);
+}
+
+/**
+   @brief the end of a piece of work of the calling thread
+   @param (t0) what thread_work_begin returned
+   @param (nnz) the elements processed by the piece
+ */
+static inline void thread_work_end(long t0, long nnz) {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return;
+  int t = get_thread_num();
+  if (t >= tt->n_threads) return;
+  long t1 = cur_time_ns();
+  thread_work_t * w = tt->work + t;
+  if (w->t_begin < 0) w->t_begin = t0;
+  w->t_end = t1;
+  w->busy += t1 - t0;
+  w->nnz += nnz;
+}
+
+/**
+   @brief the start of an spmv call
+ */
+static void thread_trace_call_begin() {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return;
+  for (int t = 0; t < tt->n_threads; t++) {
+    thread_work_t * w = tt->work + t;
+    w->t_begin = -1;
+    w->t_end = w->busy = w->nnz = 0;
+  }
+  tt->t_call = cur_time_ns();
+}
+
+/**
+   @brief nano seconds since the start of the call, saturated to 32 bits
+ */
+static uint32_t thread_trace_rel(long t_call, long t) {
+  long d = t - t_call;
+  if (d < 0) d = 0;
+  if (d > (long)UINT32_MAX) d = (long)UINT32_MAX;
+  return (uint32_t)d;
+}
+
+/**
+   @brief the end of an spmv call
+   @param (format) the format of the matrix
+   @param (algo) the algorithm
+ */
+static void thread_trace_call_end(sparse_format_t format, spmv_algo_t algo) {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return;
+  int n = tt->n_threads;
+  long busy_max = 0, busy_sum = 0, nnz_max = 0, nnz_sum = 0;
+  for (int t = 0; t < n; t++) {
+    thread_work_t * w = tt->work + t;
+    thread_trace_rec_t * r = tt->ring + tt->n_recs % thread_trace_capacity;
+    r->call = (uint32_t)tt->n_calls;
+    r->format = (uint8_t)format;
+    r->algo = (uint8_t)algo;
+    r->thread = (uint16_t)t;
+    r->t_begin = (w->t_begin < 0 ? 0 : thread_trace_rel(tt->t_call, w->t_begin));
+    r->t_end = (w->t_begin < 0 ? 0 : thread_trace_rel(tt->t_call, w->t_end));
+    r->nnz = w->nnz;
+    tt->n_recs++;
+    if (w->busy > busy_max) busy_max = w->busy;
+    if (w->nnz > nnz_max) nnz_max = w->nnz;
+    busy_sum += w->busy;
+    nnz_sum += w->nnz;
+  }
+  tt->n_calls++;
+  if (busy_sum == 0) return;    /* the kernel is not instrumented */
+  thread_imbalance_t * imb = &tt->imb[format][algo];
+  double busy_ratio = busy_max * (double)n / busy_sum;
+  imb->calls++;
+  imb->busy_ratio += busy_ratio;
+  if (busy_ratio > imb->busy_ratio_max) imb->busy_ratio_max = busy_ratio;
+  imb->nnz_ratio += (nnz_sum > 0 ? nnz_max * (double)n / nnz_sum : 1.0);
+}
+
+/**
+   @brief print the imbalance of each format and algorithm
+ */
+static void thread_trace_report() {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return;
+  printf("%s:%d:thread_trace_report: %ld spmv calls, %d threads"
+         " (imbalance = max/mean over threads; 1.0 is perfect)\n",
+         __FILE__, __LINE__, tt->n_calls, tt->n_threads);
+  printf("%-10s %-8s %7s %10s %10s %10s\n",
+         "format", "algo", "calls", "busy avg", "busy max", "nnz avg");
+  for (int f = 0; f < (int)sparse_format_invalid; f++) {
+    for (int a = 0; a < (int)spmv_algo_invalid; a++) {
+      thread_imbalance_t * imb = &tt->imb[f][a];
+      if (imb->calls == 0) continue;
+      printf("%-10s %-8s %7ld %10.3f %10.3f %10.3f\n",
+             sparse_format_table.t[f].name, spmv_algo_table.t[a].name,
+             imb->calls, imb->busy_ratio / imb->calls, imb->busy_ratio_max,
+             imb->nnz_ratio / imb->calls);
+    }
+  }
+}
+
+/**
+   @brief write the ring buffer to a file
+   @param (file) the file name
+   @return 1 if succeed, 0 if failed
+   @details a thread_trace_header_t followed by the records, oldest
+   first
+ */
+static int thread_trace_dump(const char * file) {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return 1;
+  FILE * fp = fopen(file, "wb");
+  if (!fp) {
+    perror("fopen");
+    fprintf(stderr, "error:%s:%d: could not open %s\n",
+            __FILE__, __LINE__, file);
+    return 0;
+  }
+  long n = (tt->n_recs < thread_trace_capacity ? tt->n_recs : thread_trace_capacity);
+  long first = tt->n_recs - n;
+  thread_trace_header_t h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, "spmvthr", 8);
+  h.version = thread_trace_version;
+  h.rec_sz = (int)sizeof(thread_trace_rec_t);
+  h.n_recs = n;
+  h.n_total = tt->n_recs;
+  int ok = (fwrite(&h, sizeof(h), 1, fp) == 1);
+  /* the oldest record to the end of the array, then the rest */
+  long i0 = first % thread_trace_capacity;
+  long n0 = (i0 + n <= thread_trace_capacity ? n : thread_trace_capacity - i0);
+  ok = ok && fwrite(tt->ring + i0, sizeof(thread_trace_rec_t), n0, fp) == (size_t)n0;
+  ok = ok && fwrite(tt->ring, sizeof(thread_trace_rec_t), n - n0, fp) == (size_t)(n - n0);
+  ok = (fclose(fp) == 0) && ok;
+  if (!ok) {
+    fprintf(stderr, "error:%s:%d: could not write %s\n",
+            __FILE__, __LINE__, file);
+    return 0;
+  }
+  printf("%s:%d:thread_trace_dump: wrote %ld of %ld records to %s\n",
+         __FILE__, __LINE__, n, tt->n_recs, file);
+  return 1;
+}
+
+/**
+   @brief stop tracing work of threads (release thread_trace)
+ */
+static void thread_trace_stop() {
+  thread_trace_t * tt = thread_trace;
+  if (!tt) return;
+  thread_trace = 0;
+  xfree(tt->work);
+  xfree(tt->ring);
+  xfree(tt);
+}
+
+/** ************************************************************
+    SpMV, finally
+    there are matrix of procedures depending on the sparse matrix
+    format and the algorithm
+
+spmv
+               | serial | parallel | cuda | task | udr  |
+    -----------+--------+----------+------+------+------+
+    coo        | [T1]   | [M1]     | [M3] | N/S  | N/S  |
+    coo_sorted | [T1]   | [M1]     | [M3] | [O5] | [O7] |
+    csr        | [T1]   | [M2]     | [M4] | [O6] | [O8] |
+    sell       | yes    | yes      | N/S  | yes  | yes  |
+    bcsr       | yes    | yes      | N/S  | yes  | yes  |
+    csr_soa    | yes    | yes      | N/S  | yes  | yes  |
+    csr_delta  | yes    | yes      | N/S  | yes  | yes  |
+    tiled      | yes    | yes      | N/S  | yes  | yes  |
+    csr_sym    | yes    | yes      | N/S  | yes  | yes  |
+
+vec_norm2, scalar_vec (they do not depend on the format of A)
+               | serial | parallel | cuda | task | udr  |
+    -----------+--------+----------+------+------+------+
+               | [T1]   | [M1]     | [M3] | yes  | yes  |
+
+    
+*************************************************************/
+
+
+/** 
+    @brief y = A * x in serial for coo format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+    @details the sums are accumulated in y itself, so with real_lo
+    (--precision mixed) each addition is rounded to real_lo
+*/
+template<typename V>
+static int spmv_coo_serial(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  idx_t M = A.M;
+  nnz_t nnz = A.nnz;
+  basic_coo_elem<V> * elems = A.coo.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+  /* initialize y */
+  for (idx_t i = 0; i < M; i++) {
+    y[i] = 0.0;
+  }
+  /* work on all non-zeros */
+  for (nnz_t k = 0; k < nnz; k++) {
+    basic_coo_elem<V> * e = elems + k;
+    idx_t i = e->i;
+    idx_t j = e->j;
+    V     a = e->a;
+    real_acc ax = (real_acc)a * x[j];
+    y[i] += ax;
+  }
+  return 1;                     /* OK */
+}
+
+#include "include/spmv_coo_parallel.cc"
+#if __NVCC__
+#include "include/spmv_coo_cuda.cc"
+#endif                                 
+#include "include/spmv_coo_task.cc"
+#include "include/spmv_coo_udr.cc"
+
+/** 
+    @brief y = A * x for coo format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_coo(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_coo_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_coo_parallel(A, x, y);
+#if __NVCC__
+  case spmv_algo_cuda:
+    return spmv_coo_cuda(A, x, y);
+#endif
+  case spmv_algo_task:
+    return spmv_coo_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_coo_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x in serial for coo_sorted format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+*/
+template<typename V>
+static int spmv_coo_sorted_serial(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  /* the same no matter whether elements are sorted. 
+     just call spmv_coo_serial and we are done */
+  return spmv_coo_serial(A, vx, vy);
+}
+
+#include "include/spmv_coo_sorted_parallel.cc"
+#if __NVCC__
+#include "include/spmv_coo_sorted_cuda.cc"
+#endif                                 
+#include "include/spmv_coo_sorted_task.cc"
+#include "include/spmv_coo_sorted_udr.cc"
+
+
+/** 
+    @brief y = A * x for coo_sorted format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_coo_sorted(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_coo_sorted_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_coo_sorted_parallel(A, x, y);
+#if __NVCC__
+  case spmv_algo_cuda:
+    return spmv_coo_sorted_cuda(A, x, y);
+#endif
+  case spmv_algo_task:
+    return spmv_coo_sorted_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_coo_sorted_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x in serial for csr format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+template<typename V>
+static int spmv_csr_serial(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  idx_t M = A.M;
+  nnz_t * row_start = A.csr.row_start;
+  basic_csr_elem<V> * elems = A.csr.elems;
+  V * x = vx.elems;
+  V * y = vy.elems;
+  for (idx_t i = 0; i < M; i++) {
+    nnz_t start = row_start[i];
+    nnz_t end = row_start[i + 1];
+    real_acc s = 0.0;
+    for (nnz_t k = start; k < end; k++) {
+      basic_csr_elem<V> * e = elems + k;
+      idx_t j = e->j;
+      V     a = e->a;
+      s += (real_acc)a * x[j];
+    }
+    y[i] = (V)s;
+  }
+  return 1;
+}
+
+#include "include/spmv_csr_parallel.cc"
+#if __NVCC__
+#include "include/spmv_csr_cuda.cc"
+#endif
+#include "include/spmv_csr_task.cc"
+#include "include/spmv_csr_udr.cc"
+
+
+/** 
+    @brief y = A * x for csr format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_csr_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_csr_parallel(A, x, y);
+#if __NVCC__
+  case spmv_algo_cuda:
+    return spmv_csr_cuda(A, x, y);
+#endif
+  case spmv_algo_task:
+    return spmv_csr_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_csr_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for rows [i0, i1) of a csr_soa matrix
+    @param (A) a sparse matrix in csr_soa format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+*/
+template<typename V>
+static inline void spmv_csr_soa_rows(basic_sparse<V> A, V * x, V * y,
+                                     idx_t i0, idx_t i1) {
+  nnz_t * row_start = A.csr_soa.row_start;
+  idx_t * col_idx = (idx_t *)__builtin_assume_aligned(A.csr_soa.col_idx, 64);
+  V * vals = (V *)__builtin_assume_aligned(A.csr_soa.vals, 64);
+  for (idx_t i = i0; i < i1; i++) {
+    nnz_t start = row_start[i];
+    nnz_t end = row_start[i + 1];
+    real_acc s = 0.0;
+    for (nnz_t k = start; k < end; k++) {
+      s += (real_acc)vals[k] * x[col_idx[k]];
+    }
+    y[i] = (V)s;
+  }
+}
+
+/** 
+    @brief y = A * x in serial for csr_soa format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+template<typename V>
+static int spmv_csr_soa_serial(basic_sparse<V> A, basic_vec<V> vx, basic_vec<V> vy) {
+  spmv_csr_soa_rows(A, vx.elems, vy.elems, 0, A.M);
+  return 1;
+}
+
+#include "include/spmv_csr_soa_parallel.cc"
+#include "include/spmv_csr_soa_task.cc"
+#include "include/spmv_csr_soa_udr.cc"
+
+/** 
+    @brief y = A * x for csr_soa format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr_soa(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_csr_soa_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_csr_soa_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_csr_soa_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_csr_soa_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for rows [i0, i1) of a csr_delta matrix whose
+    columns are encoded in words of type W
+    @param (A) a sparse matrix in csr_delta format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @details columns are decoded on the fly (see csr_delta_t); an
+    escape is a rarely taken branch
+*/
+template<typename W>
+static void spmv_csr_delta_rows(sparse_t A, real * x, real * y,
+                                idx_t i0, idx_t i1) {
+  const W esc = (W)~(W)0;
+  const int n_esc_words = sizeof(idx_t) / sizeof(W);
+  nnz_t * row_start = A.csr_delta.row_start;
+  W * code = (W *)A.csr_delta.code;
+  real * vals = A.csr_delta.vals;
+  nnz_t p = A.csr_delta.code_start[i0];
+  for (idx_t i = i0; i < i1; i++) {
+    nnz_t start = row_start[i];
+    nnz_t end = row_start[i + 1];
+    idx_t j = 0;
+    real s = 0.0;
+    for (nnz_t k = start; k < end; k++) {
+      W w = code[p++];
+      if (__builtin_expect(w != esc, 1)) {
+        j += w;
+      } else {
+        unsigned long u = 0;
+        for (int q = 0; q < n_esc_words; q++) {
+          u |= (unsigned long)code[p++] << (8 * sizeof(W) * q);
+        }
+        j = (idx_t)u;
+      }
+      s += vals[k] * x[j];
+    }
+    y[i] = s;
+  }
+}
+
+/** 
+    @brief y = A * x for rows [i0, i1) of a csr_delta matrix
+    @param (A) a sparse matrix in csr_delta format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @details dispatch to the spmv_csr_delta_rows instance of A's word width
+*/
+static void spmv_csr_delta_range(sparse_t A, real * x, real * y,
+                                 idx_t i0, idx_t i1) {
+  if (A.csr_delta.width == 1) {
+    spmv_csr_delta_rows<uint8_t>(A, x, y, i0, i1);
+  } else {
+    spmv_csr_delta_rows<uint16_t>(A, x, y, i0, i1);
+  }
+}
+
+/** 
+    @brief y = A * x in serial for csr_delta format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr_delta_serial(sparse_t A, vec_t vx, vec_t vy) {
+  spmv_csr_delta_range(A, vx.elems, vy.elems, 0, A.M);
+  return 1;
+}
+
+#include "include/spmv_csr_delta_parallel.cc"
+#include "include/spmv_csr_delta_task.cc"
+#include "include/spmv_csr_delta_udr.cc"
+
+/** 
+    @brief y = A * x for csr_delta format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr_delta(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_csr_delta_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_csr_delta_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_csr_delta_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_csr_delta_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for a row block of a tiled matrix
+    @param (A) a sparse matrix in tiled format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (I) the row block to work on
+    @details the tiles of the row block are stored one column segment
+    after another, so going through its tile rows in the storage
+    order reads x one segment at a time, while all of them
+    accumulate into the same (L2-resident) R elements of y.
+*/
+static inline void spmv_tiled_row_block(sparse_t A, real * x, real * y, idx_t I) {
+  tiled_t * T = &A.tiled;
+  idx_t S = T->n_col_segs;
+  idx_t * row = T->row;
+  nnz_t * row_start = T->row_start;
+  idx_t * col = T->col;
+  real * val = T->val;
+  idx_t i1 = (I * T->R + T->R < A.M ? I * T->R + T->R : A.M);
+  for (idx_t i = I * T->R; i < i1; i++) {
+    y[i] = 0.0;
+  }
+  for (nnz_t r = T->tile_start[I * S]; r < T->tile_start[I * S + S]; r++) {
+    real s = 0.0;
+    for (nnz_t k = row_start[r]; k < row_start[r + 1]; k++) {
+      s += val[k] * x[col[k]];
+    }
+    y[row[r]] += s;
+  }
+}
+
+/** 
+    @brief y = A * x in serial for tiled format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_tiled_serial(sparse_t A, vec_t vx, vec_t vy) {
+  for (idx_t I = 0; I < A.tiled.n_row_blocks; I++) {
+    spmv_tiled_row_block(A, vx.elems, vy.elems, I);
+  }
+  return 1;
+}
+
+#include "include/spmv_tiled_parallel.cc"
+#include "include/spmv_tiled_task.cc"
+#include "include/spmv_tiled_udr.cc"
+
+/** 
+    @brief y = A * x for tiled format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_tiled(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_tiled_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_tiled_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_tiled_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_tiled_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for a chunk of a sell matrix
+    @param (A) a sparse matrix in sell format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (c) the chunk to work on
+    @details the sell_C rows of the chunk are computed together, one
+    column of the chunk at a time.  with AVX-512 (AVX2), a column is
+    a single (two) SIMD multiply-add(s) whose x operands are fetched
+    by a vector gather, as in 05simd/08indirect.c, of 32-bit or
+    (with -DIDX_64) 64-bit indices.  otherwise the compiler is left
+    to vectorize the loop over the rows.
+*/
+static inline void spmv_sell_chunk(sparse_t A, real * x, real * y, idx_t c) {
+  nnz_t begin = A.sell.chunk_start[c];
+  nnz_t end = A.sell.chunk_start[c + 1];
+  idx_t * col = A.sell.col;
+  real * val = A.sell.val;
+  real s[sell_C];
+  /* the gathers below take col as 32-bit or 64-bit lanes */
+#if IDX_64
+  static_assert(sizeof(idx_t) == 8, "the gathers take 64-bit indices");
+#else
+  static_assert(sizeof(idx_t) == 4, "the gathers take 32-bit indices");
+#endif
+#if __AVX512F__
+  static_assert(sell_C == 8, "sell_C must be 8 doubles for AVX-512");
+  /* the masked gathers with all lanes on are plain gathers,
+     with the pass-through operand defined */
+  __m512d zero = _mm512_setzero_pd();
+  __m512d acc = zero;
+  for (nnz_t k = begin; k < end; k += sell_C) {
+    __m512d a = _mm512_loadu_pd(&val[k]);
+#if IDX_64
+    __m512i j = _mm512_loadu_si512((__m512i *)&col[k]);
+    __m512d xj = _mm512_mask_i64gather_pd(zero, 0xff, j, x, sizeof(real));
+#else
+    __m256i j = _mm256_loadu_si256((__m256i *)&col[k]);
+    __m512d xj = _mm512_mask_i32gather_pd(zero, 0xff, j, x, sizeof(real));
+#endif
+    acc = _mm512_fmadd_pd(a, xj, acc);
+  }
+  _mm512_storeu_pd(s, acc);
+#elif __AVX2__
+  static_assert(sell_C == 8, "sell_C must be 2 x 4 doubles for AVX2");
+  __m256d zero = _mm256_setzero_pd();
+  __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  __m256d acc0 = zero;
+  __m256d acc1 = zero;
+  for (nnz_t k = begin; k < end; k += sell_C) {
+    __m256d a0 = _mm256_loadu_pd(&val[k]);
+    __m256d a1 = _mm256_loadu_pd(&val[k + 4]);
+#if IDX_64
+    __m256i j0 = _mm256_loadu_si256((__m256i *)&col[k]);
+    __m256i j1 = _mm256_loadu_si256((__m256i *)&col[k + 4]);
+    __m256d x0 = _mm256_mask_i64gather_pd(zero, x, j0, all, sizeof(real));
+    __m256d x1 = _mm256_mask_i64gather_pd(zero, x, j1, all, sizeof(real));
+#else
+    __m128i j0 = _mm_loadu_si128((__m128i *)&col[k]);
+    __m128i j1 = _mm_loadu_si128((__m128i *)&col[k + 4]);
+    __m256d x0 = _mm256_mask_i32gather_pd(zero, x, j0, all, sizeof(real));
+    __m256d x1 = _mm256_mask_i32gather_pd(zero, x, j1, all, sizeof(real));
+#endif
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(a0, x0));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(a1, x1));
+  }
+  _mm256_storeu_pd(s, acc0);
+  _mm256_storeu_pd(s + 4, acc1);
+#else
+  for (int r = 0; r < sell_C; r++) {
+    s[r] = 0.0;
+  }
+  for (nnz_t k = begin; k < end; k += sell_C) {
+#pragma omp simd
+    for (int r = 0; r < sell_C; r++) {
+      s[r] += val[k + r] * x[col[k + r]];
+    }
+  }
+#endif
+  idx_t * row = A.sell.row + c * sell_C;
+  for (int r = 0; r < sell_C; r++) {
+    if (row[r] >= 0) {
+      y[row[r]] = s[r];
+    }
+  }
+}
+
+/** 
+    @brief y = A * x in serial for sell format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+    @details every row is in exactly one slot, so y needs no
+    initialization
+*/
+static int spmv_sell_serial(sparse_t A, vec_t vx, vec_t vy) {
+  idx_t n_chunks = A.sell.n_chunks;
+  real * x = vx.elems;
+  real * y = vy.elems;
+  for (idx_t c = 0; c < n_chunks; c++) {
+    spmv_sell_chunk(A, x, y, c);
+  }
+  return 1;
+}
+
+#include "include/spmv_sell_parallel.cc"
+#include "include/spmv_sell_task.cc"
+#include "include/spmv_sell_udr.cc"
+
+/** 
+    @brief y = A * x for sell format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_sell(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_sell_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_sell_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_sell_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_sell_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for block rows [I0, I1) of a bcsr matrix with
+    R x C blocks
+    @param (A) a sparse matrix in bcsr format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (I0) the first block row
+    @param (I1) the end of block rows (one past the last)
+    @details R and C are compile-time constants, so the loops over a
+    block are fully unrolled, the R sums of a block row stay in
+    registers and each x[j] loaded is reused by the R rows of a block.
+    a block in the last block column may stick out of x, in which
+    case its columns are checked one by one.
+*/
+template<int R, int C>
+static void spmv_bcsr_rows(sparse_t A, real * x, real * y, idx_t I0, idx_t I1) {
+  idx_t M = A.M;
+  idx_t N = A.N;
+  nnz_t * block_row_start = A.bcsr.block_row_start;
+  idx_t * block_col = A.bcsr.block_col;
+  real * val = A.bcsr.val;
+  for (idx_t I = I0; I < I1; I++) {
+    real s[R];
+    for (int r = 0; r < R; r++) {
+      s[r] = 0.0;
+    }
+    for (nnz_t b = block_row_start[I]; b < block_row_start[I + 1]; b++) {
+      idx_t j0 = block_col[b] * C;
+      real * v = val + b * R * C;
+      real xb[C];
+      if (j0 + C <= N) {
+        for (int c = 0; c < C; c++) {
+          xb[c] = x[j0 + c];
+        }
+      } else {
+        for (int c = 0; c < C; c++) {
+          xb[c] = (j0 + c < N ? x[j0 + c] : 0.0);
+        }
+      }
+      for (int r = 0; r < R; r++) {
+        for (int c = 0; c < C; c++) {
+          s[r] += v[r * C + c] * xb[c];
+        }
+      }
+    }
+    for (int r = 0; r < R; r++) {
+      if (I * R + r < M) {
+        y[I * R + r] = s[r];
+      }
+    }
+  }
+}
+
+/** 
+    @brief y = A * x for block rows [I0, I1) of a bcsr matrix
+    @param (A) a sparse matrix in bcsr format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (I0) the first block row
+    @param (I1) the end of block rows (one past the last)
+    @return 1 if succeed, 0 if failed
+    @details dispatch to the spmv_bcsr_rows instance of A's block shape
+*/
+static int spmv_bcsr_range(sparse_t A, real * x, real * y, idx_t I0, idx_t I1) {
+  int R = A.bcsr.R;
+  int C = A.bcsr.C;
+  if (R == 1 && C == 1) {
+    spmv_bcsr_rows<1,1>(A, x, y, I0, I1);
+  } else if (R == 2 && C == 2) {
+    spmv_bcsr_rows<2,2>(A, x, y, I0, I1);
+  } else if (R == 4 && C == 4) {
+    spmv_bcsr_rows<4,4>(A, x, y, I0, I1);
+  } else if (R == 8 && C == 1) {
+    spmv_bcsr_rows<8,1>(A, x, y, I0, I1);
+  } else {
+    fprintf(stderr,
+            "error:%s:%d: unsupported block shape %dx%d\n",
+            __FILE__, __LINE__, R, C);
+    return 0;
+  }
+  return 1;
+}
+
+/** 
+    @brief y = A * x in serial for bcsr format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_bcsr_serial(sparse_t A, vec_t vx, vec_t vy) {
+  return spmv_bcsr_range(A, vx.elems, vy.elems, 0, A.bcsr.n_block_rows);
+}
+
+#include "include/spmv_bcsr_parallel.cc"
+#include "include/spmv_bcsr_task.cc"
+#include "include/spmv_bcsr_udr.cc"
+
+/** 
+    @brief y = A * x for bcsr format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_bcsr(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_bcsr_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_bcsr_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_bcsr_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_bcsr_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y += A * x for rows [i0, i1) of a csr_sym matrix, and the
+    mirrors of their elements
+    @param (A) a sparse matrix in csr_sym format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (far) elements of y at or beyond row lim are added to far
+    instead (indexed by rows, as y)
+    @param (lim) see far
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @details element (i,j) adds a x[j] to y[i] and, if j != i, its
+    mirror (j,i) adds a x[i] to y[j], so A is read once for both
+    triangles.  j >= i, so the rows written are [i0, the largest
+    column of the rows]
+*/
+static inline void spmv_csr_sym_rows(sparse_t A, real * x, real * y,
+                                     real * far, idx_t lim,
+                                     idx_t i0, idx_t i1) {
+  nnz_t * row_start = A.csr.row_start;
+  csr_elem_t * elems = A.csr.elems;
+  for (idx_t i = i0; i < i1; i++) {
+    real xi = x[i];
+    real s = 0.0;
+    for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+      idx_t j = elems[k].j;
+      real a = elems[k].a;
+      s += a * x[j];
+      if (j != i) {
+        if (j < lim) {
+          y[j] += a * xi;
+        } else {
+          far[j] += a * xi;
+        }
+      }
+    }
+    y[i] += s;
+  }
+}
+
+/** 
+    @brief y = A * x in serial for csr_sym format
+    @param (A) a sparse matrix
+    @param (vx) a vector
+    @param (vy) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr_sym_serial(sparse_t A, vec_t vx, vec_t vy) {
+  real * y = vy.elems;
+  for (idx_t i = 0; i < A.M; i++) {
+    y[i] = 0.0;
+  }
+  spmv_csr_sym_rows(A, vx.elems, y, y, A.M, 0, A.M);
+  return 1;
+}
+
+#include "include/spmv_csr_sym_parallel.cc"
+#include "include/spmv_csr_sym_task.cc"
+#include "include/spmv_csr_sym_udr.cc"
+
+/** 
+    @brief y = A * x for csr_sym format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_csr_sym(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (algo) {
+  case spmv_algo_serial:
+    return spmv_csr_sym_serial(A, x, y);
+  case spmv_algo_parallel:
+    return spmv_csr_sym_parallel(A, x, y);
+  case spmv_algo_task:
+    return spmv_csr_sym_task(A, x, y);
+  case spmv_algo_udr:
+    return spmv_csr_sym_udr(A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algorithm %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x for any format, with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+*/
+static int spmv_dispatch(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  switch (A.format) {
+  case sparse_format_coo:
+    return spmv_coo(algo, A, x, y);
+  case sparse_format_coo_sorted:
+    return spmv_coo_sorted(algo, A, x, y);
+  case sparse_format_csr:
+    return spmv_csr(algo, A, x, y);
+  case sparse_format_sell:
+    return spmv_sell(algo, A, x, y);
+  case sparse_format_bcsr:
+    return spmv_bcsr(algo, A, x, y);
+  case sparse_format_csr_soa:
+    return spmv_csr_soa(algo, A, x, y);
+  case sparse_format_csr_delta:
+    return spmv_csr_delta(algo, A, x, y);
+  case sparse_format_tiled:
+    return spmv_tiled(algo, A, x, y);
+  case sparse_format_csr_sym:
+    return spmv_csr_sym(algo, A, x, y);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid format %d\n",
+            __FILE__, __LINE__, A.format);
+    return 0;
+  }
+}
+
+/** 
+    @brief y = A * x with the specified algorithm
+    @param (algo) algorithm
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+    @details the work of each thread in parallel, task and udr is
+    recorded in thread_trace (--imbalance)
+*/
+static int spmv(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
+  assert(x.n == A.N);
+  assert(y.n == A.M);
+  int traced = (thread_trace
+                && (algo == spmv_algo_parallel
+                    || algo == spmv_algo_task
+                    || algo == spmv_algo_udr));
+  if (traced) thread_trace_call_begin();
+  int ok = spmv_dispatch(algo, A, x, y);
+  if (traced) thread_trace_call_end(A.format, algo);
+  return ok;
+}
+
+/*********************************************************
+ *
+ * square norm of a vector
+ *
+ *********************************************************/
+
+/** 
+    @brief square norm of a vector in serial
+    @param (v) a vector
+    @return the square norm of v (v[0]^2 + ... + v[n-1]^2)
+*/
+template<typename V>
+static real_acc vec_norm2_serial(basic_vec<V> v) {
+  real_acc s = 0.0;
+  V * x = v.elems;
+  idx_t n = v.n;
+  for (idx_t i = 0; i < n; i++) {
+    s += (real_acc)x[i] * x[i];
+  }
+  return s;
+}
+
+#include "include/vec_norm2_parallel.cc"
+#if __NVCC__
+#include "include/vec_norm2_cuda.cc"
+#endif
+#include "include/vec_norm2_task.cc"
+#include "include/vec_norm2_udr.cc"
+
+/** 
+    @brief square norm of a vector with the specified algorithm
+    @param (algo) algorithm (serial, parallel, task, cuda, ...)
+    @param (v) a vector
+    @return the square norm of v (v[0]^2 + ... + v[n-1]^2)
+*/
+static real vec_norm2(spmv_algo_t algo, vec_t v) {
+  switch(algo) {
+  case spmv_algo_serial:
+    return vec_norm2_serial(v);
+  case spmv_algo_parallel:
+    return vec_norm2_parallel(v);
+#if __NVCC__
+  case spmv_algo_cuda:
+    return vec_norm2_cuda(v);
+#endif
+  case spmv_algo_task:
+    return vec_norm2_task(v);
+  case spmv_algo_udr:
+    return vec_norm2_udr(v);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algo %d\n",
+            __FILE__, __LINE__, algo);
+    return -1.0;
+  }
+}
+  
+/** 
+    @brief k x v in serial
+    @param (k) a scalar
+    @param (v) a vector
+    @return 1 if succeed, 0 if failed
+    @details multiply each element of v by k
+*/
+template<typename V>
+static int scalar_vec_serial(real k, basic_vec<V> v) {
+  idx_t n = v.n;
+  V * x = v.elems;
+  for (idx_t i = 0; i < n; i++) {
+    x[i] *= k;
+  }
+  return 1;
+}
+
+#include "include/scalar_vec_parallel.cc"
+#if __NVCC__
+#include "include/scalar_vec_cuda.cc"
+#endif
+#include "include/scalar_vec_task.cc"
+#include "include/scalar_vec_udr.cc"
+
+/** 
+    @brief k x v in parallel with the specified algorithm
+    @param (algo) algorithm (serial, parallel, task, cuda, etc.)
+    @param (k) a scalar
+    @param (v) a vector
+    @details multiply each element of v by k
+*/
+static int scalar_vec(spmv_algo_t algo, real k, vec_t v) {
+  switch(algo) {
+  case spmv_algo_serial:
+    return scalar_vec_serial(k, v);
+  case spmv_algo_parallel:
+    return scalar_vec_parallel(k, v);
+#if __NVCC__
+  case spmv_algo_cuda:
+    return scalar_vec_cuda(k, v);
+#endif
+  case spmv_algo_task:
+    return scalar_vec_task(k, v);
+  case spmv_algo_udr:
+    return scalar_vec_udr(k, v);
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algo %d\n",
+            __FILE__, __LINE__, algo);
+    return 0;
+  }
+}
+  
+/** 
+    @brief normalize a vector with the specified algortihm
+    @param (algo) algorithm (serial, parallel, task, cuda, etc.)
+    @param (v) a vector
+    @return |v|
+    @details make v a unit-length vector (i.e., v = v/|v|)
+*/
+static real vec_normalize(spmv_algo_t algo, vec_t v) {
+  real s2 = vec_norm2(algo, v);
+  if (s2 < 0.0) return -1.0;
+  real s = sqrt(s2);
+  if (!scalar_vec(algo, 1/s, v)) return -1.0;
+  return s;
+}
+
+/** 
+    @brief y = c (A x) for rows [i0, i1) of A, and the square norm of
+    those elements of y
+    @param (A) a sparse matrix in csr or csr_soa format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (c) a scalar
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @return y[i0]^2 + ... + y[i1-1]^2
+*/
+static real spmv_rows_scaled(sparse_t A, real * x, real * y, real c,
+                             idx_t i0, idx_t i1) {
+  real s2 = 0.0;
+  if (A.format == sparse_format_csr) {
+    nnz_t * row_start = A.csr.row_start;
+    csr_elem_t * elems = A.csr.elems;
+    for (idx_t i = i0; i < i1; i++) {
+      real s = 0.0;
+      for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+        s += elems[k].a * x[elems[k].j];
+      }
+      s *= c;
+      y[i] = s;
+      s2 += s * s;
+    }
+  } else {
+    assert(A.format == sparse_format_csr_soa);
+    nnz_t * row_start = A.csr_soa.row_start;
+    idx_t * col_idx = A.csr_soa.col_idx;
+    real * vals = A.csr_soa.vals;
+    for (idx_t i = i0; i < i1; i++) {
+      real s = 0.0;
+      for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+        s += vals[k] * x[col_idx[k]];
+      }
+      s *= c;
+      y[i] = s;
+      s2 += s * s;
+    }
+  }
+  return s2;
+}
+
+/** 
+    @brief y = c (A x) and |y|^2 in a single pass (--fused-norm)
+    @param (algo) serial, or anything else to run in parallel
+    @param (A) a sparse matrix in csr or csr_soa format
+    @param (x) a vector
+    @param (y) a vector
+    @param (c) a scalar
+    @return |y|^2
+    @details each thread computes its rows in A.part, as
+    spmv_csr_parallel does; there are no task or udr versions, so
+    they run as parallel (repeat_spmv says so) and are traced as
+    parallel for --imbalance.  c = 1/|x| makes y = A (x/|x|) without
+    a pass to normalize x, and |y|^2 is summed while y[i] is still
+    in a register instead of by another pass over y.
+*/
+static real spmv_scaled(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y, real c) {
+  sparse_part_t * part = (algo == spmv_algo_serial ? 0 : A.part);
+  int n_parts = (part ? part->n : 1);
+  nnz_t * row_start = (A.format == sparse_format_csr
+                       ? A.csr.row_start : A.csr_soa.row_start);
+  real s2 = 0.0;
+  if (part) thread_trace_call_begin();
+#pragma omp parallel for schedule(static, 1) reduction(+:s2) if(part)
+  for (int p = 0; p < n_parts; p++) {
+    idx_t i0 = (part ? part->row_start[p] : 0);
+    idx_t i1 = (part ? part->row_start[p + 1] : A.M);
+    long t0 = thread_work_begin();
+    s2 += spmv_rows_scaled(A, x.elems, y.elems, c, i0, i1);
+    thread_work_end(t0, row_start[i1] - row_start[i0]);
+  }
+  if (part) thread_trace_call_end(A.format, spmv_algo_parallel);
+  return s2;
+}
+
+/**
+   @brief the maximum number of kernels in an iteration of the main
+   loop that spmv_prof_t tells apart
+ */
+enum { max_prof_kernels = 4 };
+
+/**
+   @brief per-kernel times and hardware event counts of the main
+   loop of repeat_spmv (--profile)
+   @details each thread counts its own events (perf_event_open counts
+   the calling thread only), so counters are opened, read and summed
+   in parallel regions.  this relies on the OpenMP runtime running
+   every parallel region with the same threads, which GCC and LLVM
+   do as long as the number of threads does not change; a read by
+   a thread that did not open the counters is not counted (n_lost).
+ */
+typedef struct {
+  long repeat;                  /**< the number of iterations */
+  int n_kernels;                /**< the number of kernels per iteration */
+  const char * kernels[max_prof_kernels]; /**< name of each kernel */
+  double flops[max_prof_kernels]; /**< flops of a call to each kernel */
+  double bytes[max_prof_kernels]; /**< bytes a call to each kernel moves at least (sparse_spmv_traffic) */
+  long * ns;                    /**< ns[r * n_kernels + k] : time of kernel k in iteration r */
+  int n_threads;                /**< the number of threads */
+  perf_event_counters_t * ec;   /**< ec[t] : counters of thread t */
+  perf_event_values_t * v0;     /**< v0[t] : values of ec[t] when the current kernel started */
+  long long counts[max_prof_kernels][max_perf_events]; /**< counts[k][e] : event e during kernel k, summed over threads and iterations */
+  long n_lost;                  /**< the number of thread reads we could not count */
+  long t0;                      /**< the time the current kernel started */
+} spmv_prof_t;
+
+/**
+   @brief make a profile of the main loop of repeat_spmv
+   @param (events) a comma-separated list of hardware events
+   (perf_event_names), or null to only time kernels
+   @param (repeat) the number of iterations
+   @return the profile
+   @details kernels are added by spmv_prof_kernel.  an event the
+   environment does not support (e.g., in a container or a virtual
+   machine) is warned about once and reported as n/a.
+ */
+static spmv_prof_t * mk_spmv_prof(const char * events, long repeat) {
+  spmv_prof_t * prof = (spmv_prof_t *)xalloc(sizeof(spmv_prof_t));
+  memset(prof, 0, sizeof(spmv_prof_t));
+  prof->repeat = repeat;
+  prof->ns = (long *)xalloc(sizeof(long) * max_prof_kernels * (repeat > 0 ? repeat : 1));
+  int n_threads = get_n_threads();
+  prof->n_threads = n_threads;
+  prof->ec = (perf_event_counters_t *)xalloc(sizeof(perf_event_counters_t) * n_threads);
+  prof->v0 = (perf_event_values_t *)xalloc(sizeof(perf_event_values_t) * n_threads);
+#pragma omp parallel
+  {
+    int t = get_thread_num();
+    prof->ec[t] = mk_perf_event_counters(events ? events : "");
+  }
+  perf_event_counters_t ec = prof->ec[0];
+  for (int e = 0; e < ec.n; e++) {
+    if (ec.fds[e] == -1) {
+      fprintf(stderr,
+              "warning:%s:%d: mk_spmv_prof: cannot count %s"
+              " (no PMU, or see /proc/sys/kernel/perf_event_paranoid)\n",
+              __FILE__, __LINE__, ec.events[e]);
+    }
+  }
+  return prof;
+}
+
+/**
+   @brief destroy a profile made by mk_spmv_prof
+ */
+static void spmv_prof_destroy(spmv_prof_t * prof) {
+  if (!prof) return;
+#pragma omp parallel
+  {
+    int t = get_thread_num();
+    perf_event_counters_destroy(prof->ec[t]);
+  }
+  xfree(prof->ns);
+  xfree(prof->ec);
+  xfree(prof->v0);
+  xfree(prof);
+}
+
+/**
+   @brief add a kernel to a profile
+   @param (prof) a profile (nothing is done if null)
+   @param (name) the name of the kernel
+   @param (flops) flops of a call to the kernel
+   @param (bytes) bytes a call to the kernel moves at least
+   @return the index of the kernel, given to spmv_prof_stop
+ */
+static int spmv_prof_kernel(spmv_prof_t * prof, const char * name,
+                            double flops, double bytes) {
+  if (!prof) return 0;
+  int k = prof->n_kernels++;
+  assert(k < max_prof_kernels);
+  prof->kernels[k] = name;
+  prof->flops[k] = flops;
+  prof->bytes[k] = bytes;
+  return k;
+}
+
+/**
+   @brief mark the start of a kernel
+   @param (prof) a profile (nothing is done if null)
+   @details counters are read before the clock, so reading them is
+   not timed
+ */
+static void spmv_prof_start(spmv_prof_t * prof) {
+  if (!prof) return;
+#pragma omp parallel
+  {
+    int t = get_thread_num();
+    prof->v0[t] = perf_event_counters_get(prof->ec[t]);
+  }
+  prof->t0 = cur_time_ns();
+}
+
+/**
+   @brief mark the end of a kernel started by spmv_prof_start
+   @param (prof) a profile (nothing is done if null)
+   @param (r) the iteration
+   @param (k) the kernel (what spmv_prof_kernel returned)
+ */
+static void spmv_prof_stop(spmv_prof_t * prof, long r, int k) {
+  if (!prof) return;
+  long t1 = cur_time_ns();
+  prof->ns[r * prof->n_kernels + k] = t1 - prof->t0;
+  long n_lost = 0;
+#pragma omp parallel reduction(+:n_lost)
+  {
+    int t = get_thread_num();
+    perf_event_counters_t ec = prof->ec[t];
+    perf_event_values_t v1 = perf_event_counters_get(ec);
+    for (int e = 0; e < ec.n; e++) {
+      if (ec.fds[e] == -1) continue;
+      if (v1.values[e] < 0 || prof->v0[t].values[e] < 0) {
+        n_lost++;
+      } else {
+#pragma omp atomic
+        prof->counts[k][e] += v1.values[e] - prof->v0[t].values[e];
+      }
+    }
+  }
+  prof->n_lost += n_lost;
+}
+
+/**
+   @brief compare two longs (for qsort)
+ */
+static int cmp_long_fun(const void * a_, const void * b_) {
+  const long * a = (const long *)a_;
+  const long * b = (const long *)b_;
+  return (*a > *b) - (*a < *b);
+}
+
+/**
+   @brief measure the memory bandwidth by STREAM triad
+   @param (footprint) the bytes the measured kernels work on
+   @return the bandwidth in bytes per nano second (= GB/s)
+   @details a[i] = b[i] + s * c[i] with arrays of 4x the last level
+   cache (between 32MB and 256MB each), but together no larger than
+   footprint (and at least 8MB each), so a small matrix does not pay
+   for 768MB of arrays.  the triad then sees the same level of the
+   memory hierarchy as the kernels working on footprint bytes; give
+   --peak-bw to compare with another figure instead.  the arrays are
+   first-touched by the threads that use them.  the result is the
+   best of several runs, counting 3 arrays moved as STREAM does (not
+   counting the write-allocate of a).  this is the roof
+   spmv_prof_report compares kernels with.
+ */
+static double stream_triad_bw(long footprint) {
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+  long llc = cache_size(_SC_LEVEL3_CACHE_SIZE, 8L << 20);
+#else
+  long llc = 8L << 20;
+#endif
+  long sz = 4 * llc;
+  if (sz < (32L << 20)) sz = 32L << 20;
+  if (sz > (256L << 20)) sz = 256L << 20;
+  long cap = (footprint / 3 > (8L << 20) ? footprint / 3 : (8L << 20));
+  if (sz > cap) sz = cap;
+  long n = sz / (long)sizeof(real);
+  real * a = (real *)xalloc_aligned(64, sizeof(real) * n);
+  real * b = (real *)xalloc_aligned(64, sizeof(real) * n);
+  real * c = (real *)xalloc_aligned(64, sizeof(real) * n);
+#pragma omp parallel for schedule(static)
+  for (long i = 0; i < n; i++) {
+    a[i] = 0.0;
+    b[i] = 1.0;
+    c[i] = 2.0;
+  }
+  const int n_trials = 5;
+  const real s = 3.0;
+  long best = 0;
+  for (int trial = 0; trial < n_trials; trial++) {
+    long t0 = cur_time_ns();
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < n; i++) {
+      a[i] = b[i] + s * c[i];
+    }
+    long t1 = cur_time_ns();
+    if (trial == 0 || t1 - t0 < best) best = t1 - t0;
+  }
+  /* keep the compiler from dropping the triad */
+  if (a[n - 1] != 7.0) {
+    fprintf(stderr, "bug:%s:%d: stream_triad_bw: wrong result %f\n",
+            __FILE__, __LINE__, a[n - 1]);
+  }
+  xfree(a);
+  xfree(b);
+  xfree(c);
+  double bw = 3.0 * sizeof(real) * n / (double)(best > 0 ? best : 1);
+  printf("%s:%d:stream_triad_bw: %.3f GB/s (3 x %ld MB, best of %d)\n",
+         __FILE__, __LINE__, bw, (long)(sizeof(real) * n) >> 20, n_trials);
+  return bw;
+}
+
+/**
+   @brief print the profile of the main loop
+   @param (prof) a profile (nothing is done if null)
+   @param (peak_bw) the memory bandwidth to compare with (GB/s),
+   measured by stream_triad_bw
+   @details for each kernel, the min/median/max time per call, GFLOPS
+   and GB/s of the median (%peak of GB/s is also the position under
+   the memory roof) and the hardware events per call, then where the
+   whole iteration sits on the roofline.  the arithmetic intensity (AI) is flops
+   per byte of the traffic model, so the memory roof is AI x peak_bw;
+   a kernel at 70% of it or more is bandwidth bound, and the rest of
+   the gap below it is latency, imbalance or instruction overhead.
+   bytes read are estimated as 64 bytes per last level cache miss,
+   which tells whether the model (x read once) holds.
+ */
+static void spmv_prof_report(spmv_prof_t * prof, double peak_bw) {
+  if (!prof || prof->repeat <= 0) return;
+  long R = prof->repeat;
+  int K = prof->n_kernels;
+  long * t = (long *)xalloc(sizeof(long) * R);
+  perf_event_counters_t ec = prof->ec[0];
+  printf("%s:%d:spmv_prof_report: %ld iterations, %d threads, peak %.3f GB/s\n",
+         __FILE__, __LINE__, R, prof->n_threads, peak_bw);
+  printf("%-14s %10s %10s %10s %9s %9s %6s %7s\n",
+         "kernel", "min ms", "median ms", "max ms",
+         "GFLOPS", "GB/s", "%peak", "AI");
+  double total_flops = 0.0, total_bytes = 0.0, total_ns = 0.0;
+  for (int k = 0; k < K; k++) {
+    for (long r = 0; r < R; r++) {
+      t[r] = prof->ns[r * K + k];
+    }
+    qsort(t, R, sizeof(long), cmp_long_fun);
+    double med = (R % 2 ? (double)t[R / 2] : 0.5 * (t[R / 2 - 1] + t[R / 2]));
+    if (med < 1.0) med = 1.0;
+    double flops = prof->flops[k];
+    double bytes = prof->bytes[k];
+    double ai = flops / bytes;
+    double gflops = flops / med;
+    double bw = bytes / med;
+    printf("%-14s %10.3f %10.3f %10.3f %9.3f %9.3f %6.1f %7.3f\n",
+           prof->kernels[k], t[0] * 1.0e-6, med * 1.0e-6, t[R - 1] * 1.0e-6,
+           gflops, bw, 100.0 * bw / peak_bw, ai);
+    total_flops += flops;
+    total_bytes += bytes;
+    total_ns += med;
+  }
+  for (int e = 0; e < ec.n; e++) {
+    printf("%-14s", ec.events[e]);
+    for (int k = 0; k < K; k++) {
+      if (ec.fds[e] == -1) {
+        printf(" %s=n/a", prof->kernels[k]);
+      } else {
+        printf(" %s=%.4g", prof->kernels[k], prof->counts[k][e] / (double)R);
+      }
+    }
+    printf(" (per call)\n");
+    if (ec.fds[e] != -1 && strcmp(ec.events[e], "llc-misses") == 0) {
+      printf("%-14s", "bytes read");
+      for (int k = 0; k < K; k++) {
+        printf(" %s=%.4g (model %.4g)", prof->kernels[k],
+               64.0 * prof->counts[k][e] / (double)R, prof->bytes[k]);
+      }
+      printf(" (per call, 64 x llc-misses)\n");
+    }
+  }
+  if (prof->n_lost) {
+    printf("%s:%d:spmv_prof_report: warning: %ld counter reads were from"
+           " threads that did not open them (not counted)\n",
+           __FILE__, __LINE__, prof->n_lost);
+  }
+  double ai = total_flops / total_bytes;
+  double gflops = total_flops / total_ns;
+  double roof = ai * peak_bw;
+  printf("roofline: AI %.3f flops/byte, %.3f GFLOPS of %.3f GFLOPS memory roof"
+         " (%.1f%%) -> %s\n",
+         ai, gflops, roof, 100.0 * gflops / roof,
+         (gflops >= 0.7 * roof ? "bandwidth bound"
+          : "below the memory roof (latency, imbalance or overhead bound)"));
+  xfree(t);
+}
+
+/** 
+    @brief repeat y = A x; x = tA y; many times, with the
+    specified algorithm
+    @param (algo)
+    @param (A) the reference to a sparse vector
+    @param (tA) the reference to A's transpose
+    @param (x) the reference to a vector
+    @param (y) the reference to a vector
+    @param (repeat) the number of times to repeat
+    @param (fused_norm) 1 to normalize x inside the spmv kernels (see spmv_scaled)
+    @param (prof) if not null, each kernel of the main loop is timed
+    and its hardware events counted into it (see spmv_prof_report)
+    @param (gflops) if not null, GFLOPS of the main loop is stored to it
+    @return the largest singular value of A (= the largest
+    eigenvalue of (tA A))
+    @details it repeats, (repeat + 1) times, 
+        y = Ax; x = tA y; x = x/|x|;
+    the first iteration is the "warm-up", which
+    checks if it does not encounter an error
+    (e.g., kernel launch failure) and makes sure
+    to touch all allocated memory once.
+
+    in the end of each iteration it takes |x| and returns that
+    of the last iteration, which is the largest
+    singular value of A if enough iterations have been made.
+
+    with fused_norm, the main loop instead repeats
+        y = A x (1/|x|); x = tA y (taking |x|);
+    and x is normalized once after the loop, which saves reading x
+    twice and writing it once per iteration.
+*/
+static real repeat_spmv(spmv_algo_t algo,
+                        sparse_t& A, sparse_t& tA,
+                        vec_t& x, vec_t& y, idx_t repeat,
+                        int fused_norm, spmv_prof_t * prof, double * gflops) {
+#if __NVCC__
+  if (algo == spmv_algo_cuda) {
+    /* make device copies of matrix and vectors */
+    sparse_to_dev(A);
+    sparse_to_dev(tA);
+    vec_to_dev(x);
+    vec_to_dev(y);
+  }
+#endif
+  /* split work among threads once for all iterations */
+  int n_threads = get_n_threads();
+  sparse_partition(algo, A, n_threads);
+  sparse_partition(algo, tA, n_threads);
+  if (fused_norm && (algo == spmv_algo_task || algo == spmv_algo_udr)) {
+    printf("%s:%d:repeat_spmv: note: --fused-norm has no %s version;"
+           " the main loop runs parallel\n",
+           __FILE__, __LINE__, spmv_algo_table.t[algo].name);
+  }
+  
+  printf("%s:%d:repeat_spmv: warm up + error check starts\n", __FILE__, __LINE__);
+  fflush(stdout);
+  long t0 = cur_time_ns();
+  /* y = A x and check error */
+  if (!spmv(algo, A, x, y))
+    return -1.0;
+  /* x = tA y and check error */
+  if (!spmv(algo, tA, y, x)) 
+    return -1.0;
+  /* x = x/|x| and check error */
+  if (vec_normalize(algo, x) < 0.0)
+    return -1.0;
+  long t1 = cur_time_ns();
+  printf("%s:%d:repeat_spmv: warm up + error check ends. took %.3f sec\n",
+         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+
+  /* the real iterations to measure */
+  printf("%s:%d:repeat_spmv: main loop starts\n", __FILE__, __LINE__);
+  fflush(stdout);
+  /* csr_sym stores about half of the non-zeros it computes with */
+  long nnz = sparse_nnz_full(A);
+  real lambda = 0.0;
+  long flops = (4 * (long)nnz + 3 * (long)x.n) * (long)repeat;
+  /* y = A x, x = tA y, then |x| (read x) and x = x/|x| (read and write x) */
+  long bytes = (long)(sparse_spmv_traffic(A) + sparse_spmv_traffic(tA)
+                      + 3 * sizeof(real) * x.n);
+  if (fused_norm) {
+    /* y[i] *= 1/|x| (M flops) and |x|^2 (2N flops), without passes over x */
+    flops = (4 * (long)nnz + 2 * (long)x.n + (long)y.n) * (long)repeat;
+    bytes = (long)(sparse_spmv_traffic(A) + sparse_spmv_traffic(tA));
+  }
+  int k_Ax = 0, k_tAy = 0, k_norm = 0;
+  if (fused_norm) {
+    k_Ax  = spmv_prof_kernel(prof, "A x/|x|", 2.0 * nnz + y.n, sparse_spmv_traffic(A));
+    k_tAy = spmv_prof_kernel(prof, "tA y,|x|", 2.0 * nnz + 2.0 * x.n, sparse_spmv_traffic(tA));
+  } else {
+    k_Ax   = spmv_prof_kernel(prof, "A x", 2.0 * nnz, sparse_spmv_traffic(A));
+    k_tAy  = spmv_prof_kernel(prof, "tA y", 2.0 * nnz, sparse_spmv_traffic(tA));
+    k_norm = spmv_prof_kernel(prof, "x/|x|", 3.0 * x.n, 3.0 * sizeof(real) * x.n);
+  }
+  long t2 = cur_time_ns();
+  if (fused_norm) {
+    real c = 1.0;               /* x is a unit vector after the warm up */
+    for (idx_t r = 0; r < repeat; r++) {
+      spmv_prof_start(prof);
+      spmv_scaled(algo, A, x, y, c);        /* y = A * x/|x| */
+      spmv_prof_stop(prof, r, k_Ax);
+      spmv_prof_start(prof);
+      lambda = sqrt(spmv_scaled(algo, tA, y, x, 1.0)); /* x = tA * y (and lambda = |x|) */
+      spmv_prof_stop(prof, r, k_tAy);
+      c = 1.0 / lambda;
+    }
+  } else {
+    for (idx_t r = 0; r < repeat; r++) {
+      spmv_prof_start(prof);
+      spmv(algo,  A, x, y); /* y = A * x   (2 nnz flops) */
+      spmv_prof_stop(prof, r, k_Ax);
+      spmv_prof_start(prof);
+      spmv(algo, tA, y, x); /* x = tA * y  (2 nnz flops) */
+      spmv_prof_stop(prof, r, k_tAy);
+      spmv_prof_start(prof);
+      lambda = vec_normalize(algo, x); /* x = x/|x| (and lambda = |x|) */
+      spmv_prof_stop(prof, r, k_norm);
+    }
+  }
+  long t3 = cur_time_ns();
+  if (fused_norm && repeat > 0) {
+    scalar_vec(algo, 1.0 / lambda, x); /* leave x normalized, as the other loop does */
+  }
+  long dt = t3 - t2;
+  printf("%s:%d:repeat_spmv: main loop ends\n", __FILE__, __LINE__);
+  printf("%ld flops in %.6f sec (%.6f GFLOPS)\n",
+         flops, dt*1.0e-9, flops/(double)dt);
+  if (gflops) *gflops = flops/(double)dt;
+  printf("%ld bytes/iteration (%.6f GB/s)\n",
+         bytes, bytes * (double)repeat / (double)dt);
+  return lambda;
+}
+  
+/** 
+    @brief y = A x and z += tA y for rows [i0, i1) of A
+    @param (A) a sparse matrix in csr or csr_soa format
+    @param (x) elements of vector x
+    @param (y) elements of vector y
+    @param (z) elements of the accumulator (N elements)
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @details (tA y)[j] = sum_i A[i][j] y[i], so row i of A,
+    multiplied by y[i], contributes to z along the same elements that
+    have just made y[i].  the row is still in the cache when it is
+    read the second time, so A is read from the memory only once.
+*/
+static void spmv_ata_rows(sparse_t A, real * x, real * y, real * z,
+                          idx_t i0, idx_t i1) {
+  if (A.format == sparse_format_csr) {
+    nnz_t * row_start = A.csr.row_start;
+    csr_elem_t * elems = A.csr.elems;
+    for (idx_t i = i0; i < i1; i++) {
+      nnz_t start = row_start[i];
+      nnz_t end = row_start[i + 1];
+      real s = 0.0;
+      for (nnz_t k = start; k < end; k++) {
+        s += elems[k].a * x[elems[k].j];
+      }
+      y[i] = s;
+      for (nnz_t k = start; k < end; k++) {
+        z[elems[k].j] += elems[k].a * s;
+      }
+    }
+  } else {
+    assert(A.format == sparse_format_csr_soa);
+    nnz_t * row_start = A.csr_soa.row_start;
+    idx_t * col_idx = A.csr_soa.col_idx;
+    real * vals = A.csr_soa.vals;
+    for (idx_t i = i0; i < i1; i++) {
+      nnz_t start = row_start[i];
+      nnz_t end = row_start[i + 1];
+      real s = 0.0;
+      for (nnz_t k = start; k < end; k++) {
+        s += vals[k] * x[col_idx[k]];
+      }
+      y[i] = s;
+      for (nnz_t k = start; k < end; k++) {
+        z[col_idx[k]] += vals[k] * s;
+      }
+    }
+  }
+}
+
+/** 
+    @brief the accumulators of spmv_ata, one per part of A, each
+    covering only the columns its rows touch
+*/
+typedef struct {
+  int n;                        /**< the number of parts */
+  idx_t * lo;                   /**< accumulator p holds columns [lo[p], hi[p]) */
+  idx_t * hi;                   /**< see lo */
+  size_t * off;                 /**< accumulator p starts at buf[off[p]]; off[n] is the total */
+  real * buf;                   /**< all accumulators */
+} ata_buf_t;
+
+/** 
+    @brief make the accumulators of spmv_ata for A
+    @param (A) a sparse matrix in csr or csr_soa format
+    @param (alloc) 1 to allocate buf, 0 to only compute the ranges
+    @return the accumulators
+    @details part p gets the columns between the smallest and the
+    largest its rows have (the reach of the part, as buf_lo/buf_hi
+    of coo and csr_sym), so a banded or well ordered matrix needs
+    about N accumulators in all rather than N per part.  a matrix
+    whose rows spread over all columns still needs N per part.
+*/
+static ata_buf_t mk_ata_buf(sparse_t A, int alloc) {
+  sparse_part_t * part = A.part;
+  int n = (part ? part->n : 1);
+  ata_buf_t B = { n, (idx_t *)xalloc(sizeof(idx_t) * n),
+                  (idx_t *)xalloc(sizeof(idx_t) * n),
+                  (size_t *)xalloc(sizeof(size_t) * (n + 1)), 0 };
+  int soa = (A.format == sparse_format_csr_soa);
+  nnz_t * row_start = (soa ? A.csr_soa.row_start : A.csr.row_start);
+#pragma omp parallel for schedule(static, 1) if(part)
+  for (int p = 0; p < n; p++) {
+    idx_t i0 = (part ? part->row_start[p] : 0);
+    idx_t i1 = (part ? part->row_start[p + 1] : A.M);
+    idx_t lo = A.N, hi = 0;
+    for (nnz_t k = row_start[i0]; k < row_start[i1]; k++) {
+      idx_t j = (soa ? A.csr_soa.col_idx[k] : A.csr.elems[k].j);
+      if (j < lo) lo = j;
+      if (j + 1 > hi) hi = j + 1;
+    }
+    B.lo[p] = (lo < hi ? lo : 0);
+    B.hi[p] = (lo < hi ? hi : 0);
+  }
+  size_t sz = 0;
+  for (int p = 0; p < n; p++) {
+    B.off[p] = sz;
+    sz += B.hi[p] - B.lo[p];
+  }
+  B.off[n] = sz;
+  if (alloc) {
+    B.buf = (real *)xalloc(sizeof(real) * (sz > 0 ? sz : 1));
+  }
+  return B;
+}
+
+/** 
+    @brief destroy the accumulators made by mk_ata_buf
+*/
+static void ata_buf_destroy(ata_buf_t B) {
+  xfree(B.lo);
+  xfree(B.hi);
+  xfree(B.off);
+  if (B.buf) xfree(B.buf);
+}
+
+/** 
+    @brief x = tA (A x) without tA
+    @param (A) a sparse matrix in csr or csr_soa format
+    @param (x) a vector (input and output)
+    @param (y) a vector that receives A x
+    @param (B) the accumulators (mk_ata_buf)
+    @details each thread sweeps its rows of A (A.part, or all rows
+    if A is not partitioned), scattering into its own accumulator,
+    so no two threads write the same element.  once all threads are
+    done, the columns are split into as many blocks as parts and each
+    block of x gets the sum of the accumulators overlapping it, each
+    clamped to the block, so a column costs only the accumulators
+    that cover it.
+*/
+static void spmv_ata(sparse_t A, vec_t x, vec_t y, ata_buf_t B) {
+  sparse_part_t * part = A.part;
+  int n_parts = B.n;
+  idx_t N = A.N;
+#pragma omp parallel if(part)
+  {
+#pragma omp for schedule(static, 1)
+    for (int p = 0; p < n_parts; p++) {
+      real * z = B.buf + B.off[p];
+      for (idx_t j = 0; j < B.hi[p] - B.lo[p]; j++) {
+        z[j] = 0.0;
+      }
+      idx_t i0 = (part ? part->row_start[p] : 0);
+      idx_t i1 = (part ? part->row_start[p + 1] : A.M);
+      /* z - lo[p] is indexed by columns */
+      spmv_ata_rows(A, x.elems, y.elems, z - B.lo[p], i0, i1);
+    }
+#pragma omp for schedule(static, 1)
+    for (int b = 0; b < n_parts; b++) {
+      idx_t j0 = (idx_t)((long)N * b / n_parts);
+      idx_t j1 = (idx_t)((long)N * (b + 1) / n_parts);
+      real * xe = x.elems;
+      for (idx_t j = j0; j < j1; j++) {
+        xe[j] = 0.0;
+      }
+      for (int p = 0; p < n_parts; p++) {
+        idx_t lo = (B.lo[p] > j0 ? B.lo[p] : j0);
+        idx_t hi = (B.hi[p] < j1 ? B.hi[p] : j1);
+        if (lo >= hi) continue;
+        /* z is indexed by columns */
+        real * z = B.buf + B.off[p] - B.lo[p];
+        for (idx_t j = lo; j < hi; j++) {
+          xe[j] += z[j];
+        }
+      }
+    }
+  }
+}
+
+/** 
+    @brief repeat_spmv, but doing y = A x; x = tA y; in a single
+    sweep over A (--fused)
+    @param (algo) algorithm (serial or parallel; task and udr run
+    as parallel)
+    @param (A) the reference to a sparse matrix in csr or csr_soa format
+    @param (x) the reference to a vector
+    @param (y) the reference to a vector
+    @param (repeat) the number of times to repeat
+    @param (prof) if not null, each kernel of the main loop is timed
+    and its hardware events counted into it (see spmv_prof_report)
+    @param (gflops) if not null, GFLOPS of the main loop is stored to it
+    @return the largest singular value of A, or -1.0 on error
+    @details it never makes tA, so the matrix takes half the memory
+    and each iteration reads it once instead of twice.  the price
+    is an accumulator per part over the columns its rows reach
+    (mk_ata_buf), which are written and then read once per
+    iteration.  when they would take more memory than tA (rows of
+    many threads spreading over most columns), the saving is gone,
+    so it says so, makes tA and runs repeat_spmv instead.
+*/
+static real repeat_spmv_fused(spmv_algo_t algo, sparse_t& A,
+                              vec_t& x, vec_t& y, idx_t repeat,
+                              spmv_prof_t * prof, double * gflops) {
+  int n_threads = get_n_threads();
+  sparse_partition(algo, A, n_threads);
+  ata_buf_t B = mk_ata_buf(A, 0);
+  size_t buf_bytes = sizeof(real) * B.off[B.n];
+  size_t tA_bytes = sparse_size(A);
+  printf("%s:%d:repeat_spmv_fused: accumulators take %ld bytes (tA would take %ld)\n",
+         __FILE__, __LINE__, (long)buf_bytes, (long)tA_bytes);
+  if (buf_bytes > tA_bytes) {
+    ata_buf_destroy(B);
+    printf("%s:%d:repeat_spmv_fused: falls back to tA\n", __FILE__, __LINE__);
+    sparse_t tA = sparse_transpose(A);
+    real lambda = repeat_spmv(algo, A, tA, x, y, repeat, 0, prof, gflops);
+    sparse_destroy(tA);
+    return lambda;
+  }
+  ata_buf_destroy(B);
+  B = mk_ata_buf(A, 1);
+
+  printf("%s:%d:repeat_spmv_fused: warm up + error check starts\n", __FILE__, __LINE__);
+  fflush(stdout);
+  long t0 = cur_time_ns();
+  spmv_ata(A, x, y, B);
+  if (vec_normalize(algo, x) < 0.0) {
+    ata_buf_destroy(B);
+    return -1.0;
+  }
+  long t1 = cur_time_ns();
+  printf("%s:%d:repeat_spmv_fused: warm up + error check ends. took %.3f sec\n",
+         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+
+  printf("%s:%d:repeat_spmv_fused: main loop starts\n", __FILE__, __LINE__);
+  fflush(stdout);
+  long nnz = A.nnz;
+  real lambda = 0.0;
+  long flops = (4 * (long)nnz + 3 * (long)x.n) * (long)repeat;
+  /* A once, x and y, the accumulators written and read, then |x| and x = x/|x| */
+  long bytes = (long)(sparse_spmv_traffic(A) + 2 * buf_bytes
+                      + 3 * sizeof(real) * x.n);
+  int k_ata = spmv_prof_kernel(prof, "tA (A x)", 4.0 * nnz,
+                               sparse_spmv_traffic(A) + 2.0 * buf_bytes);
+  int k_norm = spmv_prof_kernel(prof, "x/|x|", 3.0 * x.n, 3.0 * sizeof(real) * x.n);
+  long t2 = cur_time_ns();
+  for (idx_t r = 0; r < repeat; r++) {
+    spmv_prof_start(prof);
+    spmv_ata(A, x, y, B);            /* x = tA (A x) (4 nnz flops) */
+    spmv_prof_stop(prof, r, k_ata);
+    spmv_prof_start(prof);
+    lambda = vec_normalize(algo, x); /* x = x/|x| (and lambda = |x|) */
+    spmv_prof_stop(prof, r, k_norm);
+  }
+  long t3 = cur_time_ns();
+  long dt = t3 - t2;
+  printf("%s:%d:repeat_spmv_fused: main loop ends\n", __FILE__, __LINE__);
+  printf("%ld flops in %.6f sec (%.6f GFLOPS)\n",
+         flops, dt*1.0e-9, flops/(double)dt);
+  if (gflops) *gflops = flops/(double)dt;
+  printf("%ld bytes/iteration (%.6f GB/s)\n",
+         bytes, bytes * (double)repeat / (double)dt);
+  ata_buf_destroy(B);
+  return lambda;
+}
+
+/** 
+    @brief make a copy of a matrix with its elements rounded to real_lo
+    @param (algo) the algorithm the copy is used with
+    @param (A) a sparse matrix in coo, coo_sorted, csr or csr_soa format
+    @return the copy, partitioned for algo as A would be (its format
+    is invalid if A's format has no real_lo kernels)
+    @details the partitioners look only at the structure, which the
+    copy shares with A, so they run on a shallow copy of A and the
+    copy takes over the partition
+*/
+static sparse_lo_t mk_sparse_lo(spmv_algo_t algo, sparse_t A) {
+  idx_t M = A.M;
+  nnz_t nnz = A.nnz;
+  sparse_lo_t L;
+  L.format = A.format;
+  L.M = M;
+  L.N = A.N;
+  L.nnz = nnz;
+  L.part = 0;
+  L.mapped = 0;
+  switch (A.format) {
+  case sparse_format_coo:
+  case sparse_format_coo_sorted: {
+    basic_coo_elem<real_lo> * elems
+      = (basic_coo_elem<real_lo> *)xalloc(sizeof(basic_coo_elem<real_lo>) * nnz);
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      elems[k].i = A.coo.elems[k].i;
+      elems[k].j = A.coo.elems[k].j;
+      elems[k].a = (real_lo)A.coo.elems[k].a;
+    }
+    L.coo.elems = elems;
+    break;
+  }
+  case sparse_format_csr: {
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    basic_csr_elem<real_lo> * elems
+      = (basic_csr_elem<real_lo> *)xalloc(sizeof(basic_csr_elem<real_lo>) * nnz);
+    memcpy(row_start, A.csr.row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      elems[k].j = A.csr.elems[k].j;
+      elems[k].a = (real_lo)A.csr.elems[k].a;
+    }
+    L.csr.row_start = row_start;
+    L.csr.elems = elems;
+    break;
+  }
+  case sparse_format_csr_soa: {
+    nnz_t * row_start = (nnz_t *)xalloc(sizeof(nnz_t) * (M + 1));
+    idx_t * col_idx = (idx_t *)xalloc_aligned(64, sizeof(idx_t) * nnz);
+    real_lo * vals = (real_lo *)xalloc_aligned(64, sizeof(real_lo) * nnz);
+    memcpy(row_start, A.csr_soa.row_start, sizeof(nnz_t) * (M + 1));
+#pragma omp parallel for
+    for (nnz_t k = 0; k < nnz; k++) {
+      col_idx[k] = A.csr_soa.col_idx[k];
+      vals[k] = (real_lo)A.csr_soa.vals[k];
+    }
+    L.csr_soa.row_start = row_start;
+    L.csr_soa.col_idx = col_idx;
+    L.csr_soa.vals = vals;
+    break;
+  }
+  default:
+    fprintf(stderr,
+            "error:%s:%d: --precision mixed: no real_lo version of %s\n",
+            __FILE__, __LINE__, sparse_format_table.t[A.format].name);
+    L.format = sparse_format_invalid;
+    return L;
+  }
+  /* partition a shallow copy of A, which shares the structure with L */
+  sparse_t B = A;
+  B.part = 0;
+  sparse_partition(algo, B, get_n_threads());
+  L.part = B.part;
+  return L;
+}
+
+/** 
+    @brief destroy a matrix made by mk_sparse_lo
+*/
+static void sparse_lo_destroy(sparse_lo_t L) {
+  sparse_part_destroy(L.part);
+  switch (L.format) {
+  case sparse_format_coo:
+  case sparse_format_coo_sorted:
+    coo_destroy(L);
+    break;
+  case sparse_format_csr:
+    csr_destroy(L);
+    break;
+  case sparse_format_csr_soa:
+    csr_soa_destroy(L);
+    break;
+  default:
+    break;
+  }
+}
+
+/** 
+    @brief the number of bytes y = A * x moves for a matrix made by
+    mk_sparse_lo (see sparse_spmv_traffic)
+*/
+static size_t sparse_lo_spmv_traffic(sparse_lo_t L) {
+  size_t sz = 0;
+  switch (L.format) {
+  case sparse_format_coo:
+  case sparse_format_coo_sorted:
+    sz = sparse_coo_size(L);
+    break;
+  case sparse_format_csr:
+    sz = sparse_csr_size(L);
+    break;
+  case sparse_format_csr_soa:
+    sz = sparse_csr_soa_size(L);
+    break;
+  default:
+    break;
+  }
+  return sz + sizeof(real_lo) * ((size_t)L.N + (size_t)L.M);
+}
+
+/** 
+    @brief y = A * x for a matrix made by mk_sparse_lo, with the
+    specified algorithm
+    @param (algo) algorithm (any but cuda)
+    @param (A) a sparse matrix
+    @param (x) a vector
+    @param (y) a vector
+    @return 1 if succeed, 0 if failed
+    @details the same kernels as spmv_coo, spmv_coo_sorted, spmv_csr
+    and spmv_csr_soa, instantiated with V = real_lo
+*/
+static int spmv_lo(spmv_algo_t algo, sparse_lo_t A, vec_lo_t x, vec_lo_t y) {
+  switch (A.format) {
+  case sparse_format_coo:
+    switch (algo) {
+    case spmv_algo_serial:   return spmv_coo_serial(A, x, y);
+    case spmv_algo_parallel: return spmv_coo_parallel(A, x, y);
+    case spmv_algo_task:     return spmv_coo_task(A, x, y);
+    case spmv_algo_udr:      return spmv_coo_udr(A, x, y);
+    default: break;
+    }
+    break;
+  case sparse_format_coo_sorted:
+    switch (algo) {
+    case spmv_algo_serial:   return spmv_coo_sorted_serial(A, x, y);
+    case spmv_algo_parallel: return spmv_coo_sorted_parallel(A, x, y);
+    case spmv_algo_task:     return spmv_coo_sorted_task(A, x, y);
+    case spmv_algo_udr:      return spmv_coo_sorted_udr(A, x, y);
+    default: break;
+    }
+    break;
+  case sparse_format_csr:
+    switch (algo) {
+    case spmv_algo_serial:   return spmv_csr_serial(A, x, y);
+    case spmv_algo_parallel: return spmv_csr_parallel(A, x, y);
+    case spmv_algo_task:     return spmv_csr_task(A, x, y);
+    case spmv_algo_udr:      return spmv_csr_udr(A, x, y);
+    default: break;
+    }
+    break;
+  case sparse_format_csr_soa:
+    switch (algo) {
+    case spmv_algo_serial:   return spmv_csr_soa_serial(A, x, y);
+    case spmv_algo_parallel: return spmv_csr_soa_parallel(A, x, y);
+    case spmv_algo_task:     return spmv_csr_soa_task(A, x, y);
+    case spmv_algo_udr:      return spmv_csr_soa_udr(A, x, y);
+    default: break;
+    }
+    break;
+  default:
+    break;
+  }
+  fprintf(stderr,
+          "error:%s:%d: --precision mixed: no real_lo version of %s with %s\n",
+          __FILE__, __LINE__, sparse_format_table.t[A.format].name,
+          spmv_algo_table.t[algo].name);
+  return 0;
+}
+
+/** 
+    @brief normalize a vector of real_lo with the specified algorithm,
+    summing squares in real_acc
+    @param (algo) algorithm (any but cuda)
+    @param (v) a vector
+    @return |v|, or -1.0 on error
+    @sa vec_normalize
+*/
+static real vec_lo_normalize(spmv_algo_t algo, vec_lo_t v) {
+  real_acc s2;
+  switch (algo) {
+  case spmv_algo_serial:   s2 = vec_norm2_serial(v);   break;
+  case spmv_algo_parallel: s2 = vec_norm2_parallel(v); break;
+  case spmv_algo_task:     s2 = vec_norm2_task(v);     break;
+  case spmv_algo_udr:      s2 = vec_norm2_udr(v);      break;
+  default:
+    fprintf(stderr,
+            "error:%s:%d: invalid algo %d\n",
+            __FILE__, __LINE__, algo);
+    return -1.0;
+  }
+  real_acc s = sqrt(s2);
+  switch (algo) {
+  case spmv_algo_serial:   scalar_vec_serial(1/s, v);   break;
+  case spmv_algo_parallel: scalar_vec_parallel(1/s, v); break;
+  case spmv_algo_task:     scalar_vec_task(1/s, v);     break;
+  case spmv_algo_udr:      scalar_vec_udr(1/s, v);      break;
+  default:                 break;
+  }
+  return s;
+}
+
+/** 
+    @brief repeat_spmv with matrix elements and vectors in real_lo
+    and row sums and dot products accumulated in real_acc
+    @param (algo) algorithm (any but cuda)
+    @param (A) a sparse matrix in coo, coo_sorted, csr or csr_soa format
+    @param (tA) A's transpose, in the same format
+    @param (x0) the initial vector (the same one repeat_spmv starts from)
+    @param (repeat) the number of times to repeat
+    @return the largest singular value of A, or -1.0 on error
+    @details A and tA are first copied by mk_sparse_lo (not timed)
+    and the kernels of their format and algo run on the copies
+    (spmv_lo)
+*/
+static real repeat_spmv_mixed(spmv_algo_t algo, sparse_t A, sparse_t tA,
+                              vec_t x0, idx_t repeat) {
+  sparse_lo_t L = mk_sparse_lo(algo, A);
+  sparse_lo_t tL = mk_sparse_lo(algo, tA);
+  if (L.format == sparse_format_invalid || tL.format == sparse_format_invalid) {
+    sparse_lo_destroy(L);
+    sparse_lo_destroy(tL);
+    return -1.0;
+  }
+  vec_lo_t x = { x0.n, (real_lo *)xalloc(sizeof(real_lo) * x0.n) };
+  vec_lo_t y = { L.M, (real_lo *)xalloc(sizeof(real_lo) * L.M) };
+  for (idx_t i = 0; i < x.n; i++) {
+    x.elems[i] = (real_lo)x0.elems[i];
+  }
+  real lambda = -1.0;
+  /* warm up + error check */
+  if (spmv_lo(algo, L, x, y) && spmv_lo(algo, tL, y, x)
+      && vec_lo_normalize(algo, x) >= 0.0) {
+    printf("%s:%d:repeat_spmv_mixed: main loop starts\n", __FILE__, __LINE__);
+    fflush(stdout);
+    long flops = (4 * (long)L.nnz + 3 * (long)x.n) * (long)repeat;
+    long bytes = (long)(sparse_lo_spmv_traffic(L) + sparse_lo_spmv_traffic(tL)
+                        + 3 * sizeof(real_lo) * x.n);
+    long t0 = cur_time_ns();
+    for (idx_t r = 0; r < repeat; r++) {
+      spmv_lo(algo, L, x, y);
+      spmv_lo(algo, tL, y, x);
+      lambda = vec_lo_normalize(algo, x);
+    }
+    long t1 = cur_time_ns();
+    long dt = t1 - t0;
+    printf("%s:%d:repeat_spmv_mixed: main loop ends\n", __FILE__, __LINE__);
+    printf("%ld flops in %.6f sec (%.6f GFLOPS, mixed)\n",
+           flops, dt*1.0e-9, flops/(double)dt);
+    printf("%ld bytes/iteration (%.6f GB/s, mixed)\n",
+           bytes, bytes * (double)repeat / (double)dt);
+  }
+  vec_destroy(x);
+  vec_destroy(y);
+  sparse_lo_destroy(L);
+  sparse_lo_destroy(tL);
+  return lambda;
+}
+
+/** 
+    @brief the largest number of vectors of a block (--spmm)
+*/
+static const int vecs_max_k = 16;
+
+/** 
+    @brief a block of k vectors of n elements each, stored row-major
+    @details the k elements of row i are contiguous, so a non-zero
+    A[i][j] is multiplied by row j of the block in a SIMD sweep over
+    the k vectors, and A is read once for all of them
+*/
+typedef struct {
+  idx_t n;                      /**< number of rows (elements of each vector) */
+  int k;                        /**< number of vectors */
+  real * elems;                 /**< element i of vector c is elems[i * k + c] (64-byte aligned) */
+} vecs_t;
+
+/** 
+    @brief make a block of k random vectors of n elements
+    @param (n) the number of elements of each vector
+    @param (k) the number of vectors
+    @param (rg) random number generator state (passed to erand48)
+    @return the block
+*/
+static vecs_t mk_vecs_random(idx_t n, int k, unsigned short rg[3]) {
+  real * x = (real *)xalloc_aligned(64, sizeof(real) * (size_t)n * k);
+  for (size_t i = 0; i < (size_t)n * k; i++) {
+    x[i] = erand48(rg);
+  }
+  vecs_t X = { n, k, x };
+  return X;
+}
+
+/** 
+    @brief make a block of k zero vectors of n elements
+    @param (n) the number of elements of each vector
+    @param (k) the number of vectors
+    @return the block
+*/
+static vecs_t mk_vecs_zero(idx_t n, int k) {
+  real * x = (real *)xalloc_aligned(64, sizeof(real) * (size_t)n * k);
+#pragma omp parallel for
+  for (idx_t i = 0; i < n; i++) {
+    for (int c = 0; c < k; c++) {
+      x[(size_t)i * k + c] = 0.0;
+    }
+  }
+  vecs_t X = { n, k, x };
+  return X;
+}
+
+/** 
+    @brief destroy a block of vectors
+*/
+static void vecs_destroy(vecs_t X) {
+  xfree(X.elems);
+}
+
+/** 
+    @brief Y = A X for rows [i0, i1) of a csr matrix
+    @param (A) a sparse matrix in csr format
+    @param (x) elements of block X (A.N x K, row-major)
+    @param (y) elements of block Y (A.M x K, row-major)
+    @param (i0) the first row
+    @param (i1) the end of rows (one past the last)
+    @details K is a compile-time constant so the loops over the
+    vectors are fully vectorized (K doubles are K/8 AVX-512 or K/4
+    AVX2 registers) and s stays in registers
 */
-static sparse_t mk_sparse_matrix(cmdline_options_t opt,
-                                 idx_t M, idx_t N, idx_t nnz,
-                                 unsigned short rg[3]) {
-  sparse_t A = mk_sparse_matrix_coo(opt, M, N, nnz, rg);
-  sparse_t B = sparse_coo_to_any(A, opt.format);
-  sparse_destroy(A);
-  return B;
+template<int K>
+static void spmm_csr_rows(sparse_t A, real * x, real * y, idx_t i0, idx_t i1) {
+  nnz_t * row_start = A.csr.row_start;
+  csr_elem_t * elems = A.csr.elems;
+  for (idx_t i = i0; i < i1; i++) {
+    real s[K];
+#pragma omp simd
+    for (int c = 0; c < K; c++) {
+      s[c] = 0.0;
+    }
+    for (nnz_t k = row_start[i]; k < row_start[i + 1]; k++) {
+      real a = elems[k].a;
+      real * xj = x + (size_t)elems[k].j * K;
+#pragma omp simd
+      for (int c = 0; c < K; c++) {
+        s[c] += a * xj[c];
+      }
+    }
+    real * yi = y + (size_t)i * K;
+#pragma omp simd
+    for (int c = 0; c < K; c++) {
+      yi[c] = s[c];
+    }
+  }
 }
 
-/*********************************************************
- *
- * transpose a sparse matrix
- *
- *********************************************************/
+/** 
+    @brief Y = A X for a csr matrix
+    @param (A) a sparse matrix in csr format
+    @param (X) a block of A.N x k
+    @param (Y) a block of A.M x k
+    @return 1 if succeed, 0 if failed
+    @details each thread computes its rows in A.part (see
+    csr_partition), or a single thread all rows if A is not
+    partitioned
+*/
+static int spmm_csr(sparse_t A, vecs_t X, vecs_t Y) {
+  assert(A.format == sparse_format_csr);
+  assert(X.n == A.N);
+  assert(Y.n == A.M);
+  assert(X.k == Y.k);
+  int k = X.k;
+  if (k != 4 && k != 8 && k != 16) {
+    fprintf(stderr,
+            "error:%s:%d: spmm_csr: %d vectors not supported (4, 8 or 16)\n",
+            __FILE__, __LINE__, k);
+    return 0;
+  }
+  sparse_part_t * part = A.part;
+  int n_parts = (part ? part->n : 1);
+#pragma omp parallel for schedule(static, 1) if(part)
+  for (int p = 0; p < n_parts; p++) {
+    idx_t i0 = (part ? part->row_start[p] : 0);
+    idx_t i1 = (part ? part->row_start[p + 1] : A.M);
+    if (k == 4) {
+      spmm_csr_rows<4>(A, X.elems, Y.elems, i0, i1);
+    } else if (k == 8) {
+      spmm_csr_rows<8>(A, X.elems, Y.elems, i0, i1);
+    } else {
+      spmm_csr_rows<16>(A, X.elems, Y.elems, i0, i1);
+    }
+  }
+  return 1;
+}
 
 /** 
-    @brief transpose a matrix in coordinate list format
-    @param (A) a sparse matrix in coo or coo_sorted format
-    @return the transposed sparse matrix in coo format
-    @sa sparse_transpose
+    @brief the Gram matrix of a block, G = tX X
+    @param (X) a block of vectors
+    @param (g) the upper half of G (g[c * k + d] for c <= d) is
+    stored to it (X.k x X.k elements)
+    @param (parallel) 1 to use all threads
 */
-static sparse_t coo_transpose(sparse_t A) {
-  printf("%s:%d:coo_transpose starts ...\n", __FILE__, __LINE__);
-  long t0 = cur_time_ns();
-  assert(A.format == sparse_format_coo
-         || A.format == sparse_format_coo_sorted);
-  idx_t nnz = A.nnz;
-  coo_elem_t * B_elems = 0;
-  B_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz);
-  memcpy(B_elems, A.coo.elems, sizeof(coo_elem_t) * nnz);
-  for (idx_t k = 0; k < nnz; k++) {
-    idx_t i = B_elems[k].i;
-    idx_t j = B_elems[k].j;
-    B_elems[k].i = j;
-    B_elems[k].j = i;
+static void vecs_gram(vecs_t X, real * g, int parallel) {
+  (void)parallel;               /* only in if() clauses, ignored without OpenMP */
+  int k = X.k;
+  idx_t n = X.n;
+  real * x = X.elems;
+  for (int a = 0; a < k * k; a++) {
+    g[a] = 0.0;
+  }
+#pragma omp parallel for if(parallel) reduction(+:g[:k * k])
+  for (idx_t i = 0; i < n; i++) {
+    real * xi = x + (size_t)i * k;
+    for (int c = 0; c < k; c++) {
+      for (int d = c; d < k; d++) {
+        g[c * k + d] += xi[c] * xi[d];
+      }
+    }
   }
-  coo_t coo = { B_elems };
-  sparse_t B = { sparse_format_coo, A.N, A.M, nnz, { .coo = coo } };
-  long t1 = cur_time_ns();
-  printf("%s:%d:coo_transpose ends. took %.3f sec\n",
-         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
-  return B;
 }
 
 /** 
-    @brief transpose a matrix in any format
+    @brief a vector is taken as linearly dependent on the previous
+    ones (in vecs_orthonormalize) when what is left of its squared
+    norm after removing them is below this fraction of it
+    @details CholeskyQR loses accuracy when the condition number of
+    X squared times the machine epsilon approaches 1, so vectors
+    much closer than this to the others are no better than noise
+*/
+static const real vecs_dependent_tol = 1.0e-14;
+
+/** 
+    @brief orthonormalize the vectors of a block (X = Q, where X = Q R)
+    @param (X) a block of vectors (input and output)
+    @param (rg) random number generator state to replace linearly
+    dependent vectors
+    @param (parallel) 1 to use all threads
+    @return 1 if succeed, 0 if X has fewer elements than vectors
+    @details CholeskyQR2: the Gram matrix G = tX X is factored into
+    tR R (Cholesky) and X = X R^-1, twice, as a single round loses
+    orthogonality when X is ill-conditioned.  a round reads X only
+    twice, where Gram-Schmidt would read it k(k+1)/2 times, and its
+    serial part (k x k) does not depend on n.  a vector (numerically)
+    linearly dependent on the previous ones, as happens when the rank
+    of A is below k, is replaced by a random one and the rounds start
+    over; a random vector is almost surely independent of the others,
+    and iterations then drive it to a singular vector of its own.
+*/
+static int vecs_orthonormalize(vecs_t X, unsigned short rg[3], int parallel) {
+  int k = X.k;
+  idx_t n = X.n;
+  real * x = X.elems;
+  assert(k <= vecs_max_k);
+  if (n < k) {
+    fprintf(stderr,
+            "error:%s:%d: vecs_orthonormalize: %d vectors of %ld elements"
+            " cannot be orthonormal\n",
+            __FILE__, __LINE__, k, (long)n);
+    return 0;
+  }
+  for (int round = 0; round < 2; round++) {
+    real g[vecs_max_k * vecs_max_k];
+    vecs_gram(X, g, parallel);
+    /* G = tR R */
+    real R[vecs_max_k * vecs_max_k];
+    int dependent = -1;
+    for (int c = 0; c < k && dependent == -1; c++) {
+      real s = g[c * k + c];
+      for (int e = 0; e < c; e++) {
+        s -= R[e * k + c] * R[e * k + c];
+      }
+      if (!(s > vecs_dependent_tol * g[c * k + c])) {
+        dependent = c;
+        break;
+      }
+      R[c * k + c] = sqrt(s);
+      for (int d = c + 1; d < k; d++) {
+        real t = g[c * k + d];
+        for (int e = 0; e < c; e++) {
+          t -= R[e * k + c] * R[e * k + d];
+        }
+        R[c * k + d] = t / R[c * k + c];
+      }
+    }
+    if (dependent != -1) {
+      for (idx_t i = 0; i < n; i++) {
+        x[(size_t)i * k + dependent] = erand48(rg);
+      }
+      round = -1;
+      continue;
+    }
+    /* each row of X := (the row) R^-1, by forward substitution */
+#pragma omp parallel for if(parallel)
+    for (idx_t i = 0; i < n; i++) {
+      real * xi = x + (size_t)i * k;
+      for (int d = 0; d < k; d++) {
+        real t = xi[d];
+        for (int c = 0; c < d; c++) {
+          t -= xi[c] * R[c * k + d];
+        }
+        xi[d] = t / R[d * k + d];
+      }
+    }
+  }
+  return 1;
+}
+
+/** 
+    @brief the eigenvalues of a small symmetric matrix, in
+    decreasing order
+    @param (h) the upper half of a k x k symmetric matrix (h[c * k + d]
+    for c <= d); destroyed
+    @param (k) the size of the matrix
+    @param (w) the eigenvalues are stored to it (k elements)
+    @details cyclic Jacobi: each sweep zeroes every off-diagonal
+    element by a plane rotation, until they are negligible.  k is at
+    most vecs_max_k, so it costs nothing next to a single spmm.
+*/
+static void sym_eigenvalues(real * h, int k, real * w) {
+  /* fill the lower half so rotations can use both */
+  for (int c = 0; c < k; c++) {
+    for (int d = c + 1; d < k; d++) {
+      h[d * k + c] = h[c * k + d];
+    }
+  }
+  for (int sweep = 0; sweep < 64; sweep++) {
+    real off = 0.0, diag = 0.0;
+    for (int c = 0; c < k; c++) {
+      diag += h[c * k + c] * h[c * k + c];
+      for (int d = c + 1; d < k; d++) {
+        off += h[c * k + d] * h[c * k + d];
+      }
+    }
+    if (off <= 1.0e-30 * diag) break;
+    for (int p = 0; p < k; p++) {
+      for (int q = p + 1; q < k; q++) {
+        real hpq = h[p * k + q];
+        if (hpq == 0.0) continue;
+        real theta = (h[q * k + q] - h[p * k + p]) / (2.0 * hpq);
+        real t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+        real cs = 1.0 / sqrt(t * t + 1.0);
+        real sn = t * cs;
+        /* h := tJ h J, J rotating columns p and q */
+        for (int r = 0; r < k; r++) {
+          real hrp = h[r * k + p];
+          real hrq = h[r * k + q];
+          h[r * k + p] = cs * hrp - sn * hrq;
+          h[r * k + q] = sn * hrp + cs * hrq;
+        }
+        for (int r = 0; r < k; r++) {
+          real hpr = h[p * k + r];
+          real hqr = h[q * k + r];
+          h[p * k + r] = cs * hpr - sn * hqr;
+          h[q * k + r] = sn * hpr + cs * hqr;
+        }
+      }
+    }
+  }
+  for (int c = 0; c < k; c++) {
+    w[c] = h[c * k + c];
+  }
+  /* insertion sort, decreasing */
+  for (int c = 1; c < k; c++) {
+    real v = w[c];
+    int d = c;
+    for (; d > 0 && w[d - 1] < v; d--) {
+      w[d] = w[d - 1];
+    }
+    w[d] = v;
+  }
+}
+
+/** 
+    @brief block power (subspace) iteration, repeating Y = A X;
+    X = tA Y; X = orthonormalize(X); with k vectors at a time (--spmm)
+    @param (algo) algorithm (everything but serial and cuda runs rows
+    of each thread with parallel for, as csr does)
     @param (A) a sparse matrix
-    @return the transposed matrix in the same format with A
-    @sa coo_transpose
+    @param (tA) A's transpose
+    @param (k) the number of vectors (4, 8 or 16)
+    @param (repeat) the number of times to repeat
+    @param (rg) random number generator state to make the initial block
+    (and to replace vectors that become linearly dependent)
+    @param (lambda) estimates of the k largest eigenvalues of tA A
+    are stored to it, in decreasing order
+    @return lambda[0], the largest singular value of A in the same
+    sense as repeat_spmv returns, or -1.0 on error
+    @details A and tA are first converted to csr (not timed).  each
+    non-zero is read once and does 2k flops instead of 2, so the
+    arithmetic intensity of the matrix part grows about k times.
+    after the loop (not timed), the Rayleigh-Ritz step takes the
+    eigenvalues of the k x k matrix tX tA A X = t(A X) (A X) as
+    lambda; they converge to the eigenvalues as the space spanned by
+    X does to that of the eigenvectors, whichever order X has.
 */
-static sparse_t sparse_transpose(sparse_t A) {
-  switch (A.format) {
-  case sparse_format_coo: {
-    return coo_transpose(A);
+static real repeat_spmm(spmv_algo_t algo, sparse_t A, sparse_t tA, int k,
+                        idx_t repeat, unsigned short rg[3], real * lambda) {
+  if (algo == spmv_algo_cuda) {
+    fprintf(stderr,
+            "error:%s:%d: --spmm is not supported with cuda\n",
+            __FILE__, __LINE__);
+    return -1.0;
   }
-  case sparse_format_coo_sorted: {
-    sparse_t B = coo_transpose(A);
-    sparse_t C = sparse_coo_to_coo(B, sparse_format_coo_sorted);
-    sparse_destroy(B);
-    return C;
+  int parallel = (algo != spmv_algo_serial);
+  int convert = (A.format != sparse_format_csr);
+  sparse_t B = (convert ? sparse_any_to_any(A, sparse_format_csr) : A);
+  sparse_t tB = (convert ? sparse_any_to_any(tA, sparse_format_csr) : tA);
+  sparse_t C = B;
+  sparse_t tC = tB;
+  C.part = tC.part = 0;
+  if (parallel) {
+    int n_threads = get_n_threads();
+    C.part = csr_partition(C, n_threads);
+    tC.part = csr_partition(tC, n_threads);
   }
-  case sparse_format_csr: {
-    sparse_t B = sparse_csr_to_coo_sorted(A);
-    sparse_t C = coo_transpose(B);
-    sparse_t D = sparse_coo_to_csr(C);
+  vecs_t X = mk_vecs_random(C.N, k, rg);
+  vecs_t Y = mk_vecs_zero(C.M, k);
+  /* warm up */
+  int ok = (spmm_csr(C, X, Y)
+            && spmm_csr(tC, Y, X)
+            && vecs_orthonormalize(X, rg, parallel));
+
+  if (ok) {
+    printf("%s:%d:repeat_spmm: main loop starts\n", __FILE__, __LINE__);
+    fflush(stdout);
+    long nnz = C.nnz;
+    long n = C.N;
+    /* 2k flops per non-zero, twice, and about 2 n k^2 flops per round
+       of orthonormalization (G = tX X and X R^-1), twice */
+    long flops = (4 * nnz * k + 4 * n * k * k) * (long)repeat;
+    /* A and tA once, X and Y read and written once by spmm, then
+       X read twice and written once per round of orthonormalization */
+    long bytes = (long)(sparse_size(C) + sparse_size(tC)
+                        + sizeof(real) * (size_t)k * (2 * C.M + 8 * C.N));
+    long bytes_1 = (long)(sparse_spmv_traffic(C) + sparse_spmv_traffic(tC)
+                          + 3 * sizeof(real) * C.N);
+    long t0 = cur_time_ns();
+    for (idx_t r = 0; r < repeat && ok; r++) {
+      spmm_csr(C, X, Y);        /* Y = A X  (2k nnz flops) */
+      spmm_csr(tC, Y, X);       /* X = tA Y (2k nnz flops) */
+      ok = vecs_orthonormalize(X, rg, parallel);
+    }
+    long t1 = cur_time_ns();
+    long dt = t1 - t0;
+    printf("%s:%d:repeat_spmm: main loop ends\n", __FILE__, __LINE__);
+    printf("%ld flops in %.6f sec (%.6f GFLOPS, %d vectors)\n",
+           flops, dt*1.0e-9, flops/(double)dt, k);
+    printf("%ld bytes/iteration (%.6f GB/s, %d vectors)\n",
+           bytes, bytes * (double)repeat / (double)dt, k);
+    printf("arithmetic intensity %.3f flops/byte (%.3f with a single vector)\n",
+           flops / (double)repeat / bytes,
+           (4 * nnz + 3 * n) / (double)bytes_1);
+  }
+  if (ok) {
+    /* Rayleigh-Ritz: eigenvalues of t(A X) (A X) */
+    real h[vecs_max_k * vecs_max_k];
+    ok = spmm_csr(C, X, Y);
+    vecs_gram(Y, h, parallel);
+    sym_eigenvalues(h, k, lambda);
+  }
+  vecs_destroy(X);
+  vecs_destroy(Y);
+  sparse_part_destroy(C.part);
+  sparse_part_destroy(tC.part);
+  if (convert) {
     sparse_destroy(B);
-    sparse_destroy(C);
-    return D;
+    sparse_destroy(tB);
   }
-  default: {
-    fprintf(stderr,
-            "error:%s:%d: invalid format %d\n",
-            __FILE__, __LINE__, A.format);
-    return mk_sparse_invalid();
+  return (ok ? lambda[0] : -1.0);
+}
+
+/** 
+    @brief make a random vector of n elements
+    @param (n) the number of elements of the vector
+    @param (rg) random number generator state (passed to erand48)
+    @return a vector of n elements
+*/
+static vec_t mk_vec_random(idx_t n, unsigned short rg[3]) {
+  real * x = (real *)xalloc(sizeof(real) * n);
+  for (idx_t i = 0; i < n; i++) {
+    x[i] = erand48(rg);
+  }
+  vec_t v = { n, x };
+  return v;
+}
+
+/** 
+    @brief make a random unit-length vector of n elements
+    @param (n) the number of elements of the vector
+    @param (rg) random number generator state (passed to erand48)
+    @return a vector of n elements
+*/
+static vec_t mk_vec_unit_random(idx_t n, unsigned short rg[3]) {
+  vec_t x = mk_vec_random(n, rg);
+  vec_normalize(spmv_algo_serial, x);
+  return x;
+}
+
+/** 
+    @brief make a zero vector of n elements
+    @param (n) the number of elements of the vector
+    @return a zero vector of n elements
+*/
+static vec_t mk_vec_zero(idx_t n) {
+  real * x = (real *)xalloc(sizeof(real) * n);
+  for (idx_t i = 0; i < n; i++) {
+    x[i] = 0.0;
+  }
+  vec_t v = { n, x };
+  return v;
+}
+
+/** 
+    @brief compare two elements in an array of nnz_t 
+    @param (a_) the pointer to an element 1
+    @param (b_) the pointer to an element 2
+*/
+static int cmp_nnz_fun(const void * a_, const void * b_) {
+  nnz_t * a = (nnz_t *)a_;
+  nnz_t * b = (nnz_t *)b_;
+  return (*a > *b) - (*a < *b);
+}
+
+/** 
+    @brief dump a sparse matrix A into img_width x img_height bitmap
+    (gnuplot file) with the specified filename.
+    @param (A) a sparse matrix to dump
+    @param (file) the file name to dump A into 
+    @param (max_points) the maximum number of points dumped into the file
+    @param (seed) the random number seed to choose elements to dump
+*/
+
+static int dump_sparse_file(sparse_t A, char * file, nnz_t max_points, long seed) {
+  printf("%s:%d:dump_sparse_file:"
+         " dumping to matrix %ld x %ld (%ld nnz) -> %s\n",
+         __FILE__, __LINE__,
+         (long)A.M, (long)A.N, (long)A.nnz, file);
+  fflush(stdout);
+  sparse_t B = sparse_any_to_any(A, sparse_format_coo);
+  idx_t M = B.M;
+  idx_t N = B.N;
+  nnz_t nnz = B.nnz;
+  coo_elem_t * elems = B.coo.elems;
+
+  nnz_t * row_nnz = (nnz_t *)malloc(sizeof(nnz_t) * M);
+  for (idx_t i = 0; i < M; i++) {
+    row_nnz[i] = 0;
+  }
+  /* randomly choose up to max_points */
+  unsigned short rg[3] = {
+    (unsigned short)((seed >> 32) & ((1 << 16) - 1)),
+    (unsigned short)((seed >> 16) & ((1 << 16) - 1)),
+    (unsigned short)((seed >> 0 ) & ((1 << 16) - 1)),
+  };
+  nnz_t * chosen = (nnz_t *)malloc(sizeof(nnz_t) * max_points);
+  nnz_t n_points = 0;
+  for (nnz_t k = 0; k < nnz; k++) {
+    /* count non-zeros in each row */
+    idx_t i = elems[k].i;
+    row_nnz[i]++;
+    /* choose it with an equal probability */
+    if (n_points < max_points) {
+      chosen[n_points] = k;
+      n_points++;
+    } else {
+      if (erand48(rg) < (double)n_points / (double)max_points) {
+        nnz_t replaced = nrand48(rg) % n_points;
+        chosen[replaced] = k;
+      }
+    }
+  }
+  qsort((void *)chosen, n_points, sizeof(nnz_t), cmp_nnz_fun);
+    
+  FILE * wp = fopen(file, "w");
+  if (!wp) {
+    perror(file);
+    return 0;
+  }
+  fprintf(wp, "# add -e 'term=\"png\"' etc. to the gnuplot commad line to generate a file instead of showing it on the screen. e.g. gnuplot -e 'term=\"png\"' x.gnuplot\n");
+  fprintf(wp, "if (exists(\"term\")) set terminal term\n");
+  
+  fprintf(wp, "# add -e 'nnz_mat=\"FILENAME\"' etc. to the gnuplot commad line to output non-zero matrix to the specified file name . e.g. gnuplot -e 'term=\"png\"' -e 'nnz_mat=\"nnz_mat.png\"' x.gnuplot\n");
+  fprintf(wp, "if (exists(\"nnz_mat\")) set output nnz_mat\n");
+  fprintf(wp, "set title \"nnz_mat : matrix of non zero elements\"\n");
+  fprintf(wp, "set xlabel \"row\"\n");
+  fprintf(wp, "set xrange [0:%ld]\n", (long)M);
+  fprintf(wp, "set ylabel \"column\"\n");
+  fprintf(wp, "set yrange [0:%ld]\n", (long)N);
+  fprintf(wp, "$mat << EOD\n");
+  for (nnz_t i = 0; i < n_points; i++) {
+    nnz_t k = chosen[i];
+    coo_elem_t * e = elems + k;
+    fprintf(wp, "%ld %ld %f\n", (long)e->i, (long)e->j, e->a);
   }
+  fprintf(wp, "EOD\n");
+  fprintf(wp, "plot '$mat' with points\n");
+  fprintf(wp, "if (!exists(\"nnz_mat\")) pause -1\n");
+
+  /* reset everything to go ahead to the second graph */
+  fprintf(wp, "reset\n");
+  
+  /* non-zero distribution */
+  fprintf(wp, "# add -e 'nnz_row=\"FILENAME\"' etc. to the gnuplot commad line to output non-zero distribution over rows. e.g. gnuplot -e 'term=\"png\"' -e 'nnz_mat=\"nnz_mat.png\"' x.gnuplot\n");
+  fprintf(wp, "if (exists(\"nnz_row\")) set output nnz_row\n");
+  
+  fprintf(wp, "set title \"nnz_row : the number of non zeros in each row\"\n");
+  fprintf(wp, "set xlabel \"row\"\n");
+  fprintf(wp, "set xrange [0:%ld]\n", (long)M);
+  fprintf(wp, "set ylabel \"the number of non zeros\"\n");
+  fprintf(wp, "set yrange [0:]\n");
+  fprintf(wp, "$row_nnz << EOD\n");
+  for (idx_t i = 0; i < M; i++) {
+    fprintf(wp, "%ld %ld\n", (long)i, (long)row_nnz[i]);
   }
+  fprintf(wp, "EOD\n");
+  fprintf(wp, "plot '$row_nnz' with lines title \"\"\n");
+  fprintf(wp, "if (!exists(\"nnz_row\")) pause -1\n");
+  
+  fclose(wp);
+  xfree(row_nnz);
+  printf("%s:%d:dump_sparse_file: done\n",
+         __FILE__, __LINE__);
+  fflush(stdout);
+  return 1;
 }
 
+
+
+
+/** 
+    @brief the main function
+*/
 /*********************************************************
  *
- * copy data from host to device (CUDA)
+ * reordering rows and columns
  *
  *********************************************************/
 
-#if __NVCC__
-static int coo_to_dev(sparse_t& A);
-#include "include/coo_to_dev.cc"
-
-static int csr_to_dev(sparse_t& A);
-#include "include/csr_to_dev.cc"
-
 /** 
-    @brief make a deivce copy of a sparse matrix.
-    @param (A) the reference to a matrix whose elem_dev has not 
-    been set (i.e., = NULL)
-    @return 1 if succeed, 0 if failed.
-    @sa coo_to_dev
-    @sa csr_to_dev
-    @sa vec_to_dev
+    @brief bandwidth and profile of a matrix
 */
-static int sparse_to_dev(sparse_t& A) {
-  switch (A.format) {
-  case sparse_format_coo: {
-    return coo_to_dev(A);
-  }
-  case sparse_format_coo_sorted: {
-    return coo_to_dev(A);
-  }
-  case sparse_format_csr: {
-    return csr_to_dev(A);
-  }
-  default: {
-    fprintf(stderr,
-            "error:%s:%d: invalid format %d\n",
-            __FILE__, __LINE__, A.format);
-    return 0;
-  }
-  }
-}
-
-static int vec_to_dev(vec_t& v);
-#include "include/vec_to_dev.cc"
-
-#endif
-
-/** ************************************************************
-    SpMV, finally
-    there are matrix of procedures depending on the sparse matrix
-    format and the algorithm
-
-spmv
-               | serial | parallel | cuda | task | udr  |
-    -----------+--------+----------+------+------+------+
-    coo        | [T1]   | [M1]     | [M3] | N/S  | N/S  |
-    coo_sorted | [T1]   | [M1]     | [M3] | [O5] | [O7] |
-    csr        | [T1]   | [M2]     | [M4] | [O6] | [O8] |
-
-vec_norm2, scalar_vec
-               | serial | parallel | cuda | task | udr  |
-    -----------+--------+----------+------+------+------+
-    coo        | [T1]   | [M1]     | [M3] | N/S  | N/S  |
-    coo_sorted | [T1]   | [M1]     | [M3] | [M1] | [
-    csr        | [T1]   | [M1]     | [M3] | [M1] |
-
-    
-*************************************************************/
-
+typedef struct {
+  long bandwidth;               /**< max |i - j| over non-zeros */
+  long profile;                 /**< sum over rows of (the last column - the first column + 1) */
+} sparse_shape_t;
 
 /** 
-    @brief y = A * x in serial for coo format
-    @param (A) a sparse matrix
-    @param (vx) a vector
-    @param (vy) a vector
-    @return 1 if succeed, 0 if failed
+    @brief bandwidth and profile of a matrix in coo format
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @return its bandwidth and profile
+    @details the profile is the total span of x the rows read; the
+    smaller, the more likely x[j] is found in the cache
 */
-static int spmv_coo_serial(sparse_t A, vec_t vx, vec_t vy) {
+static sparse_shape_t coo_shape(sparse_t A) {
   idx_t M = A.M;
-  idx_t nnz = A.nnz;
+  nnz_t nnz = A.nnz;
   coo_elem_t * elems = A.coo.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  /* initialize y */
+  idx_t * lo = (idx_t *)xalloc(sizeof(idx_t) * M);
+  idx_t * hi = (idx_t *)xalloc(sizeof(idx_t) * M);
+#pragma omp parallel for
   for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+    lo[i] = A.N;
+    hi[i] = -1;
   }
-  /* work on all non-zeros */
-  for (idx_t k = 0; k < nnz; k++) {
-    coo_elem_t * e = elems + k;
-    idx_t i = e->i;
-    idx_t j = e->j;
-    real  a = e->a;
-    real ax = a * x[j];
-    y[i] += ax;
+  long bw = 0;
+#pragma omp parallel for reduction(max:bw)
+  for (nnz_t k = 0; k < nnz; k++) {
+    idx_t i = elems[k].i;
+    idx_t j = elems[k].j;
+    long d = (i > j ? (long)i - j : (long)j - i);
+    if (d > bw) bw = d;
+    idx_t l = lo[i];
+    while (j < l && !__sync_bool_compare_and_swap(&lo[i], l, j)) {
+      l = lo[i];
+    }
+    idx_t h = hi[i];
+    while (j > h && !__sync_bool_compare_and_swap(&hi[i], h, j)) {
+      h = hi[i];
+    }
   }
-  return 1;                     /* OK */
+  long profile = 0;
+#pragma omp parallel for reduction(+:profile)
+  for (idx_t i = 0; i < M; i++) {
+    if (hi[i] >= lo[i]) profile += hi[i] - lo[i] + 1;
+  }
+  xfree(lo);
+  xfree(hi);
+  sparse_shape_t s = { bw, profile };
+  return s;
 }
 
-#include "include/spmv_coo_parallel.cc"
-#if __NVCC__
-#include "include/spmv_coo_cuda.cc"
-#endif                                 
-#include "include/spmv_coo_task.cc"
-#include "include/spmv_coo_udr.cc"
+/** 
+    @brief a vertex and its degree, to sort vertices by degree
+*/
+typedef struct {
+  nnz_t deg;                    /**< the degree (negated to sort in decreasing order) */
+  idx_t v;                      /**< the vertex */
+} deg_vertex_t;
 
 /** 
-    @brief y = A * x for coo format, with the specified algorithm
-    @param (algo) algorithm
-    @param (A) a sparse matrix
-    @param (x) a vector
-    @param (y) a vector
-    @return 1 if succeed, 0 if failed
+    @brief compare two vertices by degree, then by index (callback for qsort)
 */
-static int spmv_coo(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
-  switch (algo) {
-  case spmv_algo_serial:
-    return spmv_coo_serial(A, x, y);
-  case spmv_algo_parallel:
-    return spmv_coo_parallel(A, x, y);
-#if __NVCC__
-  case spmv_algo_cuda:
-    return spmv_coo_cuda(A, x, y);
-#endif
-  case spmv_algo_task:
-    return spmv_coo_task(A, x, y);
-  case spmv_algo_udr:
-    return spmv_coo_udr(A, x, y);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid algorithm %d\n",
-            __FILE__, __LINE__, algo);
-    return 0;
-  }
+static int cmp_deg_vertex_fun(const void * a_, const void * b_) {
+  const deg_vertex_t * a = (const deg_vertex_t *)a_;
+  const deg_vertex_t * b = (const deg_vertex_t *)b_;
+  if (a->deg != b->deg) return (a->deg < b->deg ? -1 : 1);
+  return (a->v > b->v) - (a->v < b->v);
 }
 
 /** 
-    @brief y = A * x in serial for coo_sorted format
-    @param (A) a sparse matrix
-    @param (vx) a vector
-    @param (vy) a vector
+    @brief reverse Cuthill-McKee ordering of rows and columns
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @param (deg) deg[v] is the number of non-zeros of row v (v < M)
+    or column v - M (v >= M)
+    @param (row_perm) the new index of each row is stored to it
+    @param (col_perm) the new index of each column is stored to it
+    @details the matrix is taken as a bipartite graph of M row
+    vertices and N column vertices, which works for rectangular and
+    nonsymmetric matrices alike.  a breadth first search starts from
+    a vertex of the smallest degree, visits neighbors in increasing
+    order of degree and restarts from the next smallest unvisited
+    vertex for each connected component.  rows and columns are
+    numbered in the reverse of the visit order, which brings rows
+    sharing columns (and columns shared by rows) next to each other.
+    it is serial.
 */
-static int spmv_coo_sorted_serial(sparse_t A, vec_t vx, vec_t vy) {
-  /* the same no matter whether elements are sorted. 
-     just call spmv_coo_serial and we are done */
-  return spmv_coo_serial(A, vx, vy);
+static void reorder_rcm(sparse_t A, nnz_t * deg,
+                        idx_t * row_perm, idx_t * col_perm) {
+  idx_t M = A.M;
+  idx_t N = A.N;
+  idx_t V = M + N;
+  nnz_t nnz = A.nnz;
+  coo_elem_t * elems = A.coo.elems;
+  /* adjacency lists of the bipartite graph */
+  nnz_t * adj_start = (nnz_t *)xalloc(sizeof(nnz_t) * (V + 1));
+  idx_t * adj = (idx_t *)xalloc(sizeof(idx_t) * 2 * (size_t)nnz);
+  memcpy(adj_start, deg, sizeof(nnz_t) * V);
+  adj_start[V] = 0;
+  parallel_exclusive_scan(adj_start, V + 1);
+  nnz_t * p = (nnz_t *)xalloc(sizeof(nnz_t) * V);
+  memcpy(p, adj_start, sizeof(nnz_t) * V);
+  for (nnz_t k = 0; k < nnz; k++) {
+    idx_t i = elems[k].i;
+    idx_t j = M + elems[k].j;
+    adj[p[i]++] = j;
+    adj[p[j]++] = i;
+  }
+  xfree(p);
+  /* vertices in increasing order of degree, to choose roots */
+  deg_vertex_t * key = (deg_vertex_t *)xalloc(sizeof(deg_vertex_t) * V);
+  for (idx_t v = 0; v < V; v++) {
+    key[v].deg = deg[v];
+    key[v].v = v;
+  }
+  qsort(key, V, sizeof(deg_vertex_t), cmp_deg_vertex_fun);
+  idx_t * queue = (idx_t *)xalloc(sizeof(idx_t) * V);
+  deg_vertex_t * nbr = (deg_vertex_t *)xalloc(sizeof(deg_vertex_t) * V);
+  char * visited = (char *)xalloc(V);
+  for (idx_t v = 0; v < V; v++) {
+    visited[v] = 0;
+  }
+  idx_t tail = 0;
+  for (idx_t r = 0; r < V; r++) {
+    idx_t root = key[r].v;
+    if (visited[root]) continue;
+    visited[root] = 1;
+    idx_t head = tail;
+    queue[tail++] = root;
+    while (head < tail) {
+      idx_t v = queue[head++];
+      idx_t n = 0;
+      for (nnz_t k = adj_start[v]; k < adj_start[v + 1]; k++) {
+        idx_t w = adj[k];
+        if (!visited[w]) {
+          visited[w] = 1;
+          nbr[n].deg = deg[w];
+          nbr[n].v = w;
+          n++;
+        }
+      }
+      qsort(nbr, n, sizeof(deg_vertex_t), cmp_deg_vertex_fun);
+      for (idx_t k = 0; k < n; k++) {
+        queue[tail++] = nbr[k].v;
+      }
+    }
+  }
+  assert(tail == V);
+  /* number rows and columns in the reverse order of visits */
+  idx_t ni = 0, nj = 0;
+  for (idx_t q = V - 1; q >= 0; q--) {
+    idx_t v = queue[q];
+    if (v < M) {
+      row_perm[v] = ni++;
+    } else {
+      col_perm[v - M] = nj++;
+    }
+  }
+  assert(ni == M);
+  assert(nj == N);
+  xfree(adj_start);
+  xfree(adj);
+  xfree(key);
+  xfree(queue);
+  xfree(nbr);
+  xfree(visited);
 }
 
-#include "include/spmv_coo_sorted_parallel.cc"
-#if __NVCC__
-#include "include/spmv_coo_sorted_cuda.cc"
-#endif                                 
-#include "include/spmv_coo_sorted_task.cc"
-#include "include/spmv_coo_sorted_udr.cc"
-
-
 /** 
-    @brief y = A * x for coo_sorted format, with the specified algorithm
-    @param (algo) algorithm
-    @param (A) a sparse matrix
-    @param (x) a vector
-    @param (y) a vector
-    @return 1 if succeed, 0 if failed
+    @brief order n vertices by decreasing degree
+    @param (n) the number of vertices
+    @param (deg) the degree of each vertex
+    @param (perm) the new index of each vertex is stored to it
+    @details ties are broken by the original index
 */
-static int spmv_coo_sorted(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
-  switch (algo) {
-  case spmv_algo_serial:
-    return spmv_coo_sorted_serial(A, x, y);
-  case spmv_algo_parallel:
-    return spmv_coo_sorted_parallel(A, x, y);
-#if __NVCC__
-  case spmv_algo_cuda:
-    return spmv_coo_sorted_cuda(A, x, y);
-#endif
-  case spmv_algo_task:
-    return spmv_coo_sorted_task(A, x, y);
-  case spmv_algo_udr:
-    return spmv_coo_sorted_udr(A, x, y);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid algorithm %d\n",
-            __FILE__, __LINE__, algo);
-    return 0;
+static void reorder_degree(idx_t n, nnz_t * deg, idx_t * perm) {
+  deg_vertex_t * key = (deg_vertex_t *)xalloc(sizeof(deg_vertex_t) * n);
+#pragma omp parallel for
+  for (idx_t v = 0; v < n; v++) {
+    key[v].deg = -deg[v];
+    key[v].v = v;
+  }
+  qsort(key, n, sizeof(deg_vertex_t), cmp_deg_vertex_fun);
+#pragma omp parallel for
+  for (idx_t r = 0; r < n; r++) {
+    perm[key[r].v] = r;
   }
+  xfree(key);
 }
 
 /** 
-    @brief y = A * x in serial for csr format
-    @param (A) a sparse matrix
-    @param (vx) a vector
-    @param (vy) a vector
-    @return 1 if succeed, 0 if failed
+    @brief move hubs (vertices of above average degree) to the front
+    @param (n) the number of vertices
+    @param (deg) the degree of each vertex
+    @param (perm) the new index of each vertex is stored to it
+    @details unlike reorder_degree, hubs and the others each keep
+    their original order, so whatever locality the input order has
+    survives, while the frequently accessed x[j] of hub columns are
+    packed into a few cache lines
 */
-static int spmv_csr_serial(sparse_t A, vec_t vx, vec_t vy) {
-  idx_t M = A.M;
-  idx_t * row_start = A.csr.row_start;
-  csr_elem_t * elems = A.csr.elems;
-  real * x = vx.elems;
-  real * y = vy.elems;
-  for (idx_t i = 0; i < M; i++) {
-    y[i] = 0.0;
+static void reorder_hub(idx_t n, nnz_t * deg, idx_t * perm) {
+  long total = 0;
+#pragma omp parallel for reduction(+:total)
+  for (idx_t v = 0; v < n; v++) {
+    total += deg[v];
   }
-  for (idx_t i = 0; i < M; i++) {
-    idx_t start = row_start[i];
-    idx_t end = row_start[i + 1];
-    for (idx_t k = start; k < end; k++) {
-      csr_elem_t * e = elems + k;
-      idx_t j = e->j;
-      real  a = e->a;
-      y[i] += a * x[j];
-    }
+  idx_t n_hubs = 0;
+  for (idx_t v = 0; v < n; v++) {
+    if ((long)deg[v] * n > total) n_hubs++;
   }
-  return 1;
+  idx_t h = 0, o = n_hubs;
+  for (idx_t v = 0; v < n; v++) {
+    perm[v] = ((long)deg[v] * n > total ? h++ : o++);
+  }
+  assert(h == n_hubs);
+  assert(o == n);
 }
 
-#include "include/spmv_csr_parallel.cc"
-#if __NVCC__
-#include "include/spmv_csr_cuda.cc"
-#endif
-#include "include/spmv_csr_task.cc"
-#include "include/spmv_csr_udr.cc"
-
-
 /** 
-    @brief y = A * x for csr format, with the specified algorithm
-    @param (algo) algorithm
+    @brief permute rows and columns of a matrix
     @param (A) a sparse matrix
-    @param (x) a vector
-    @param (y) a vector
-    @return 1 if succeed, 0 if failed
+    @param (row_perm) row i moves to row_perm[i]
+    @param (col_perm) column j moves to col_perm[j]
+    @return the permuted matrix in the same format as A
 */
-static int spmv_csr(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
-  switch (algo) {
-  case spmv_algo_serial:
-    return spmv_csr_serial(A, x, y);
-  case spmv_algo_parallel:
-    return spmv_csr_parallel(A, x, y);
-#if __NVCC__
-  case spmv_algo_cuda:
-    return spmv_csr_cuda(A, x, y);
-#endif
-  case spmv_algo_task:
-    return spmv_csr_task(A, x, y);
-  case spmv_algo_udr:
-    return spmv_csr_udr(A, x, y);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid algorithm %d\n",
-            __FILE__, __LINE__, algo);
-    return 0;
+static sparse_t sparse_permute(sparse_t A, idx_t * row_perm, idx_t * col_perm) {
+  sparse_t B = sparse_any_to_any(A, sparse_format_coo);
+  coo_elem_t * elems = B.coo.elems;
+  nnz_t nnz = B.nnz;
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    elems[k].i = row_perm[elems[k].i];
+    elems[k].j = col_perm[elems[k].j];
   }
+  /* B may have come as coo_sorted; it is no longer sorted */
+  B.format = sparse_format_coo;
+  sparse_t C = sparse_coo_to_any(B, A.format);
+  sparse_destroy(B);
+  return C;
 }
 
 /** 
-    @brief y = A * x for any format, with the specified algorithm
-    @param (algo) algorithm
+    @brief make row and column permutations of a matrix
     @param (A) a sparse matrix
-    @param (x) a vector
-    @param (y) a vector
-    @return 1 if succeed, 0 if failed
+    @param (kind) how to reorder (reorder_kind_t)
+    @param (row_perm) the new index of each row is stored to it
+    @param (col_perm) the new index of each column is stored to it
+    @details it also prints the bandwidth and profile (see
+    coo_shape) before and after.  rcm falls back to degree when
+    M + N vertices do not fit idx_t.
 */
-static int spmv(spmv_algo_t algo, sparse_t A, vec_t x, vec_t y) {
-  assert(x.n == A.N);
-  assert(y.n == A.M);
-  switch (A.format) {
-  case sparse_format_coo:
-    return spmv_coo(algo, A, x, y);
-  case sparse_format_coo_sorted:
-    return spmv_coo_sorted(algo, A, x, y);
-  case sparse_format_csr:
-    return spmv_csr(algo, A, x, y);
-  default:
+static void mk_reorder(sparse_t A, int kind, idx_t * row_perm, idx_t * col_perm) {
+  printf("%s:%d:mk_reorder (%s) starts ...\n",
+         __FILE__, __LINE__, reorder_kind_names[kind]);
+  long t0 = cur_time_ns();
+  sparse_t B = sparse_any_to_any(A, sparse_format_coo);
+  idx_t M = B.M;
+  idx_t N = B.N;
+  nnz_t nnz = B.nnz;
+  coo_elem_t * elems = B.coo.elems;
+  /* deg[i] (i < M) : non-zeros of row i, deg[M + j] : those of column j */
+  if (kind == reorder_kind_rcm && (long)M + (long)N >= (long)IDX_MAX) {
+    /* rcm numbers rows and columns as vertices 0 .. M + N - 1 */
     fprintf(stderr,
-            "error:%s:%d: invalid format %d\n",
-            __FILE__, __LINE__, A.format);
-    return 0;
+            "warning:%s:%d: mk_reorder: %ld + %ld vertices do not fit idx_t,"
+            " reorder by degree instead\n",
+            __FILE__, __LINE__, (long)M, (long)N);
+    kind = reorder_kind_degree;
+  }
+  nnz_t * deg = (nnz_t *)xalloc(sizeof(nnz_t) * ((size_t)M + N));
+#pragma omp parallel for
+  for (long v = 0; v < (long)M + N; v++) {
+    deg[v] = 0;
+  }
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+#pragma omp atomic
+    deg[elems[k].i]++;
+#pragma omp atomic
+    deg[M + elems[k].j]++;
+  }
+  switch (kind) {
+  case reorder_kind_rcm:
+    reorder_rcm(B, deg, row_perm, col_perm);
+    break;
+  case reorder_kind_degree:
+    reorder_degree(M, deg, row_perm);
+    reorder_degree(N, deg + M, col_perm);
+    break;
+  case reorder_kind_hub:
+    reorder_hub(M, deg, row_perm);
+    reorder_hub(N, deg + M, col_perm);
+    break;
+  default:
+    for (idx_t i = 0; i < M; i++) row_perm[i] = i;
+    for (idx_t j = 0; j < N; j++) col_perm[j] = j;
+    break;
+  }
+  xfree(deg);
+  sparse_shape_t before = coo_shape(B);
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+    elems[k].i = row_perm[elems[k].i];
+    elems[k].j = col_perm[elems[k].j];
   }
+  sparse_shape_t after = coo_shape(B);
+  sparse_destroy(B);
+  long t1 = cur_time_ns();
+  printf("%s:%d:mk_reorder ends. bandwidth %ld -> %ld, profile %ld -> %ld (%.3f x)."
+         " took %.3f sec\n",
+         __FILE__, __LINE__, before.bandwidth, after.bandwidth,
+         before.profile, after.profile,
+         (before.profile > 0 ? after.profile / (double)before.profile : 1.0),
+         (t1 - t0) * 1.0e-9);
 }
 
 /*********************************************************
  *
- * square norm of a vector
+ * choosing format, algorithm and threads (--autotune)
  *
  *********************************************************/
 
 /** 
-    @brief square norm of a vector in serial
-    @param (v) a vector
-    @return the square norm of v (v[0]^2 + ... + v[n-1]^2)
+    @brief a choice of format, algorithm and the number of threads
 */
-static real vec_norm2_serial(vec_t v) {
-  real s = 0.0;
-  real * x = v.elems;
-  idx_t n = v.n;
-  for (idx_t i = 0; i < n; i++) {
-    s += x[i] * x[i];
+typedef struct {
+  sparse_format_t format;       /**< format */
+  spmv_algo_t algo;             /**< algorithm */
+  int n_threads;                /**< the number of threads */
+  double gflops;                /**< GFLOPS of y = A x on the sample (0 if none worked) */
+} spmv_tune_t;
+
+/** @brief the number of buckets of the row length histogram of
+    mk_tune_key (bucket 0 for empty rows and 1 + ceil(log2(len)) for
+    the others) */
+enum { tune_hist_n = 65 };
+
+/** 
+    @brief make the fingerprint of a matrix that identifies it in
+    the tune file
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @param (n_threads) the number of threads available
+    @param (row_major) 1 if only csr and csr_soa are allowed (see
+    spmv_autotune)
+    @param (mixed) 1 if only formats having real_lo kernels are allowed
+    @param (key) the key is written to it
+    @param (sz) the size of key
+    @details M, N, nnz, the histogram of row lengths (log2 buckets),
+    the number of threads, as the best choice on a machine depends
+    on how many threads it has, and row_major and mixed, as the
+    choices allowed with --fused, --fused-norm and --precision mixed
+    are not those of plain y = A x.
+*/
+static void mk_tune_key(sparse_t A, int n_threads, int row_major, int mixed,
+                        char * key, size_t sz) {
+  idx_t M = A.M;
+  nnz_t nnz = A.nnz;
+  coo_elem_t * elems = A.coo.elems;
+  nnz_t * len = (nnz_t *)xalloc(sizeof(nnz_t) * M);
+#pragma omp parallel for
+  for (idx_t i = 0; i < M; i++) {
+    len[i] = 0;
+  }
+#pragma omp parallel for
+  for (nnz_t k = 0; k < nnz; k++) {
+#pragma omp atomic
+    len[elems[k].i]++;
+  }
+  long hist[tune_hist_n] = { 0 };
+  for (idx_t i = 0; i < M; i++) {
+    hist[len[i] == 0 ? 0 : 1 + n_bits(len[i])]++;
+  }
+  xfree(len);
+  int n = snprintf(key, sz, "M=%ld N=%ld nnz=%ld threads=%d row_major=%d mixed=%d rows=",
+                   (long)M, (long)A.N, (long)nnz, n_threads, row_major, mixed);
+  for (int b = 0; b < tune_hist_n && n < (int)sz; b++) {
+    if (hist[b]) {
+      n += snprintf(key + n, sz - n, "%s%d:%ld", (key[n - 1] == '=' ? "" : ","),
+                    b, hist[b]);
+    }
   }
-  return s;
 }
 
-#include "include/vec_norm2_parallel.cc"
-#if __NVCC__
-#include "include/vec_norm2_cuda.cc"
-#endif
-#include "include/vec_norm2_task.cc"
-#include "include/vec_norm2_udr.cc"
+/** 
+    @brief find a format by name, without complaining
+    @return the format, or sparse_format_invalid if there is none
+*/
+static sparse_format_t find_sparse_format(const char * s) {
+  sparse_format_table_entry_t * t = sparse_format_table.t;
+  for (int i = 0; i < (int)sparse_format_invalid; i++) {
+    if (strcmp(s, t[i].name) == 0) return t[i].idx;
+  }
+  return sparse_format_invalid;
+}
 
 /** 
-    @brief square norm of a vector with the specified algorithm
-    @param (algo) algorithm (serial, parallel, task, cuda, ...)
-    @param (v) a vector
-    @return the square norm of v (v[0]^2 + ... + v[n-1]^2)
+    @brief find an algorithm by name, without complaining
+    @return the algorithm, or spmv_algo_invalid if there is none
 */
-static real vec_norm2(spmv_algo_t algo, vec_t v) {
-  switch(algo) {
-  case spmv_algo_serial:
-    return vec_norm2_serial(v);
-  case spmv_algo_parallel:
-    return vec_norm2_parallel(v);
-#if __NVCC__
-  case spmv_algo_cuda:
-    return vec_norm2_cuda(v);
-#endif
-  case spmv_algo_task:
-    return vec_norm2_task(v);
-  case spmv_algo_udr:
-    return vec_norm2_udr(v);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid algo %d\n",
-            __FILE__, __LINE__, algo);
-    return -1.0;
+static spmv_algo_t find_spmv_algo(const char * s) {
+  spmv_algo_table_entry_t * t = spmv_algo_table.t;
+  for (int i = 0; i < (int)spmv_algo_invalid; i++) {
+    if (strcmp(s, t[i].name) == 0) return t[i].idx;
   }
+  return spmv_algo_invalid;
 }
-  
+
 /** 
-    @brief k x v in serial
-    @param (k) a scalar
-    @param (v) a vector
+    @brief look up the choice for a matrix in the tune file
+    @param (file) the tune file
+    @param (key) the fingerprint of the matrix (mk_tune_key)
+    @param (t) the choice is stored to it if found
+    @return 1 if found, 0 otherwise
+    @details each line is the key, a tab, and the format, algorithm,
+    the number of threads and GFLOPS separated by spaces.  if the
+    key appears more than once, the last line wins.
+*/
+static int tune_lookup(const char * file, const char * key, spmv_tune_t * t) {
+  FILE * fp = fopen(file, "r");
+  if (!fp) return 0;
+  char line[4096];
+  size_t key_len = strlen(key);
+  int found = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    if (strncmp(line, key, key_len) != 0 || line[key_len] != '\t') continue;
+    char format[64], algo[64];
+    spmv_tune_t c;
+    if (sscanf(line + key_len + 1, "%63s %63s %d %lf",
+               format, algo, &c.n_threads, &c.gflops) != 4) continue;
+    c.format = find_sparse_format(format);
+    c.algo = find_spmv_algo(algo);
+    if (c.format == sparse_format_invalid || c.algo == spmv_algo_invalid
+        || c.n_threads < 1) continue;
+    *t = c;
+    found = 1;
+  }
+  fclose(fp);
+  return found;
+}
+
+/** 
+    @brief append the choice for a matrix to the tune file
+    @param (file) the tune file
+    @param (key) the fingerprint of the matrix (mk_tune_key)
+    @param (t) the choice
     @return 1 if succeed, 0 if failed
-    @details multiply each element of v by k
 */
-static int scalar_vec_serial(real k, vec_t v) {
-  idx_t n = v.n;
-  real * x = v.elems;
-  for (idx_t i = 0; i < n; i++) {
-    x[i] *= k;
+static int tune_save(const char * file, const char * key, spmv_tune_t t) {
+  FILE * fp = fopen(file, "a");
+  if (!fp) {
+    perror("fopen");
+    fprintf(stderr, "warning:%s:%d: could not save the choice to %s\n",
+            __FILE__, __LINE__, file);
+    return 0;
+  }
+  fprintf(fp, "%s\t%s %s %d %.6f\n", key,
+          sparse_format_table.t[t.format].name, spmv_algo_table.t[t.algo].name,
+          t.n_threads, t.gflops);
+  if (fclose(fp) != 0) {
+    fprintf(stderr, "warning:%s:%d: could not save the choice to %s\n",
+            __FILE__, __LINE__, file);
+    return 0;
   }
   return 1;
 }
 
-#include "include/scalar_vec_parallel.cc"
-#if __NVCC__
-#include "include/scalar_vec_cuda.cc"
-#endif
-#include "include/scalar_vec_task.cc"
-#include "include/scalar_vec_udr.cc"
-
 /** 
-    @brief k x v in parallel with the specified algorithm
-    @param (algo) algorithm (serial, parallel, task, cuda, etc.)
-    @param (k) a scalar
-    @param (v) a vector
-    @details multiply each element of v by k
+    @brief take a sample of rows of a matrix
+    @param (A) a sparse matrix in coo or coo_sorted format
+    @param (target) the number of non-zeros the sample should have
+    @return a matrix in coo format having a slice at the start of
+    each of 64 row blocks of A, with all columns, renumbered to
+    consecutive rows
+    @details slices rather than scattered rows keep the locality of
+    neighboring rows, and taking them from all over A keeps its mix
+    of short and long rows.
 */
-static int scalar_vec(spmv_algo_t algo, real k, vec_t v) {
-  switch(algo) {
-  case spmv_algo_serial:
-    return scalar_vec_serial(k, v);
-  case spmv_algo_parallel:
-    return scalar_vec_parallel(k, v);
-#if __NVCC__
-  case spmv_algo_cuda:
-    return scalar_vec_cuda(k, v);
-#endif
-  case spmv_algo_task:
-    return scalar_vec_task(k, v);
-  case spmv_algo_udr:
-    return scalar_vec_udr(k, v);
-  default:
-    fprintf(stderr,
-            "error:%s:%d: invalid algo %d\n",
-            __FILE__, __LINE__, algo);
-    return 0;
+static sparse_t mk_tune_sample(sparse_t A, nnz_t target) {
+  idx_t M = A.M;
+  nnz_t nnz = A.nnz;
+  coo_elem_t * elems = A.coo.elems;
+  const long n_blocks = 64;
+  long bs = (M + n_blocks - 1) / n_blocks;
+  if (bs < 1) bs = 1;
+  long keep = (nnz <= target ? bs : (long)((double)bs * target / nnz) + 1);
+  if (keep > bs) keep = bs;
+  idx_t * row = (idx_t *)xalloc(sizeof(idx_t) * M);
+  idx_t M_s = 0;
+  for (idx_t i = 0; i < M; i++) {
+    row[i] = (i % bs < keep ? M_s++ : -1);
+  }
+  nnz_t nnz_s = 0;
+#pragma omp parallel for reduction(+:nnz_s)
+  for (nnz_t k = 0; k < nnz; k++) {
+    nnz_s += (row[elems[k].i] >= 0);
+  }
+  coo_elem_t * s_elems = (coo_elem_t *)xalloc(sizeof(coo_elem_t) * nnz_s);
+  nnz_t q = 0;
+  for (nnz_t k = 0; k < nnz; k++) {
+    idx_t i = row[elems[k].i];
+    if (i >= 0) {
+      s_elems[q].i = i;
+      s_elems[q].j = elems[k].j;
+      s_elems[q].a = elems[k].a;
+      q++;
+    }
   }
+  assert(q == nnz_s);
+  xfree(row);
+  coo_t coo = { s_elems };
+  sparse_t S = { sparse_format_coo, M_s, A.N, nnz_s, { .coo = coo }, 0, 0 };
+  return S;
 }
-  
+
 /** 
-    @brief normalize a vector with the specified algortihm
-    @param (algo) algorithm (serial, parallel, task, cuda, etc.)
-    @param (v) a vector
-    @return |v|
-    @details make v a unit-length vector (i.e., v = v/|v|)
+    @brief the best GFLOPS of y = S x with an algorithm and a
+    number of threads
+    @param (algo) the algorithm
+    @param (S) the reference to a sparse matrix (it is partitioned)
+    @param (n_threads) the number of threads
+    @param (x) a vector
+    @param (y) a vector
+    @return GFLOPS of the fastest call, or 0.0 if it failed
+    @details after a warm-up call, it repeats at least 3 calls and
+    up to 50 ms (or 100 calls), which also lets spmv_csr_task adapt
+    its grain
 */
-static real vec_normalize(spmv_algo_t algo, vec_t v) {
-  real s2 = vec_norm2(algo, v);
-  if (s2 < 0.0) return -1.0;
-  real s = sqrt(s2);
-  if (!scalar_vec(algo, 1/s, v)) return -1.0;
-  return s;
+static double tune_time(spmv_algo_t algo, sparse_t& S, int n_threads,
+                        vec_t x, vec_t y) {
+  set_n_threads(n_threads);
+  sparse_partition(algo, S, n_threads);
+  if (!spmv(algo, S, x, y)) return 0.0;
+  long best = 0, total = 0;
+  for (int c = 0; c < 100 && (c < 3 || total < 50000000L); c++) {
+    long t0 = cur_time_ns();
+    spmv(algo, S, x, y);
+    long t1 = cur_time_ns();
+    if (c == 0 || t1 - t0 < best) best = t1 - t0;
+    total += t1 - t0;
+  }
+  return 2.0 * S.nnz / (double)(best > 0 ? best : 1);
 }
 
 /** 
-    @brief repeat y = A x; x = tA y; many times, with the
-    specified algorithm
-    @param (algo)
-    @param (A) the reference to a sparse vector
-    @param (tA) the reference to A's transpose
-    @param (x) the reference to a vector
-    @param (y) the reference to a vector
-    @param (repeat) the number of times to repeat
-    @return the largest singular value of A (= the largest
-    eigenvalue of (tA A))
-    @details it repeats, (repeat + 1) times, 
-        y = Ax; x = tA y; x = x/|x|;
-    the first iteration is the "warm-up", which
-    checks if it does not encounter an error
-    (e.g., kernel launch failure) and makes sure
-    to touch all allocated memory once.
+    @brief check if autotune may choose a format
+    @param (format) a sparse format
+    @param (row_major) 1 to allow only csr and csr_soa
+    @param (mixed) 1 to allow only formats having real_lo kernels
+    (sparse_lo_format_ok)
+    @return 1 if format is allowed
+*/
+static int tune_format_ok(sparse_format_t format, int row_major, int mixed) {
+  return ((!row_major
+           || format == sparse_format_csr
+           || format == sparse_format_csr_soa)
+          && (!mixed || sparse_lo_format_ok(format)));
+}
 
-    in the end of each iteration it takes |x| and returns that
-    of the last iteration, which is the largest
-    singular value of A if enough iterations have been made.
-    
+/** 
+    @brief choose the format, algorithm and number of threads for A
+    @param (A) a sparse matrix in any format
+    @param (file) the tune file, where choices are looked up and saved
+    @param (row_major) 1 to consider only csr and csr_soa (for --fused
+    and --fused-norm)
+    @param (mixed) 1 to consider only formats having real_lo kernels
+    (for --precision mixed)
+    @return the choice
+    @details the choice is looked up in file by the fingerprint of A
+    (mk_tune_key).  if it is not there (or is a format row_major or
+    mixed does not allow, which a tune file written by hand or by an older
+    version may have), y = S x is timed for every
+    format, algorithm (except cuda and the ones coo lacks) and number
+    of threads (powers of two below the maximum and the maximum) on
+    a sample S of about 2M non-zeros of A (mk_tune_sample), and the
+    fastest is saved to file.  the number of threads the caller
+    started with is restored.
 */
-static real repeat_spmv(spmv_algo_t algo,
-                        sparse_t& A, sparse_t& tA,
-                        vec_t& x, vec_t& y, idx_t repeat) {
-#if __NVCC__
-  if (algo == spmv_algo_cuda) {
-    /* make device copies of matrix and vectors */
-    sparse_to_dev(A);
-    sparse_to_dev(tA);
-    vec_to_dev(x);
-    vec_to_dev(y);
-  }
-#endif
-  
-  printf("%s:%d:repeat_spmv: warm up + error check starts\n", __FILE__, __LINE__);
-  fflush(stdout);
+static spmv_tune_t spmv_autotune(sparse_t A, const char * file, int row_major,
+                                 int mixed) {
+  printf("%s:%d:spmv_autotune starts ...\n", __FILE__, __LINE__);
   long t0 = cur_time_ns();
-  /* y = A x and check error */
-  if (!spmv(algo, A, x, y))
-    return -1.0;
-  /* x = tA y and check error */
-  if (!spmv(algo, tA, y, x)) 
-    return -1.0;
-  /* x = x/|x| and check error */
-  if (vec_normalize(algo, x) < 0.0)
-    return -1.0;
+  int n_max = get_n_threads();
+  int is_coo = (A.format == sparse_format_coo || A.format == sparse_format_coo_sorted);
+  sparse_t B = (is_coo ? A : sparse_any_to_any(A, sparse_format_coo));
+  char key[2048];
+  mk_tune_key(B, n_max, row_major, mixed, key, sizeof(key));
+  spmv_tune_t best = { sparse_format_csr, spmv_algo_serial, 1, 0.0 };
+  int found = tune_lookup(file, key, &best);
+  if (found && !tune_format_ok(best.format, row_major, mixed)) {
+    printf("%s:%d:spmv_autotune: ignore %s found in %s (not allowed)\n",
+           __FILE__, __LINE__, sparse_format_table.t[best.format].name, file);
+    spmv_tune_t c = { sparse_format_csr, spmv_algo_serial, 1, 0.0 };
+    best = c;
+    found = 0;
+  }
+  if (found) {
+    printf("%s:%d:spmv_autotune: found %s %s %d threads (%.3f GFLOPS) in %s\n",
+           __FILE__, __LINE__, sparse_format_table.t[best.format].name,
+           spmv_algo_table.t[best.algo].name, best.n_threads, best.gflops, file);
+  } else {
+    sparse_t S = mk_tune_sample(B, (nnz_t)1 << 21);
+    printf("%s:%d:spmv_autotune: sample %ld x %ld with %ld non-zeros\n",
+           __FILE__, __LINE__, (long)S.M, (long)S.N, (long)S.nnz);
+    vec_t x = mk_vec_zero(S.N);
+    vec_t y = mk_vec_zero(S.M);
+    for (idx_t j = 0; j < S.N; j++) {
+      x.elems[j] = 1.0;
+    }
+    for (int f = 0; f < (int)sparse_format_invalid; f++) {
+      sparse_format_t format = (sparse_format_t)f;
+      if (!tune_format_ok(format, row_major, mixed)) continue;
+      /* S is a slice of A, which is not symmetric even if A is */
+      if (format == sparse_format_csr_sym) continue;
+      sparse_t Sf = sparse_coo_to_any(S, format);
+      if (Sf.format == sparse_format_invalid) continue;
+      for (int a = 0; a < (int)spmv_algo_invalid; a++) {
+        spmv_algo_t algo = (spmv_algo_t)a;
+        if (algo == spmv_algo_cuda) continue;
+        /* not implemented (they exit) */
+        if (format == sparse_format_coo
+            && (algo == spmv_algo_task || algo == spmv_algo_udr)) continue;
+        for (int n = (algo == spmv_algo_serial || n_max == 1 ? 1 : 2); n <= n_max;
+             n = (n < n_max && 2 * n > n_max ? n_max : 2 * n)) {
+          double gflops = tune_time(algo, Sf, n, x, y);
+          printf("%s:%d:spmv_autotune: %-10s %-8s %3d threads %.3f GFLOPS\n",
+                 __FILE__, __LINE__, sparse_format_table.t[format].name,
+                 spmv_algo_table.t[algo].name, n, gflops);
+          if (gflops > best.gflops) {
+            spmv_tune_t c = { format, algo, n, gflops };
+            best = c;
+          }
+          if (algo == spmv_algo_serial) break;
+        }
+      }
+      sparse_destroy(Sf);
+    }
+    set_n_threads(n_max);
+    vec_destroy(x);
+    vec_destroy(y);
+    sparse_destroy(S);
+    tune_save(file, key, best);
+  }
+  if (!is_coo) {
+    sparse_destroy(B);
+  }
   long t1 = cur_time_ns();
-  printf("%s:%d:repeat_spmv: warm up + error check ends. took %.3f sec\n",
-         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+  printf("%s:%d:spmv_autotune ends. %s %s %d threads. took %.3f sec\n",
+         __FILE__, __LINE__, sparse_format_table.t[best.format].name,
+         spmv_algo_table.t[best.algo].name, best.n_threads, (t1 - t0) * 1.0e-9);
+  return best;
+}
 
-  /* the real iterations to measure */
-  printf("%s:%d:repeat_spmv: main loop starts\n", __FILE__, __LINE__);
-  fflush(stdout);
-  long nnz = A.nnz;
-  real lambda = 0.0;
-  long flops = (4 * (long)nnz + 3 * (long)x.n) * (long)repeat;
-  long t2 = cur_time_ns();
-  for (idx_t r = 0; r < repeat; r++) {
-    spmv(algo,  A, x, y); /* y = A * x   (2 nnz flops) */
-    spmv(algo, tA, y, x); /* x = tA * y  (2 nnz flops) */
-    lambda = vec_normalize(algo, x); /* x = x/|x| (and lambda = |x|) */
+/*********************************************************
+ *
+ * on-disk cache of matrices
+ *
+ *********************************************************/
+
+/** @brief the version of the cache file format.  bump it whenever
+    the layout of sparse_t or of any format changes */
+static const int sparse_cache_version = 3;
+/** @brief the first bytes of a cache file */
+static const char sparse_cache_magic[16] = "spmv cache";
+/** @brief the maximum number of arrays of a sparse matrix */
+#define SPARSE_MAX_ARRAYS 8
+
+/** 
+    @brief the header of a cache file
+    @details followed by n_mats sparse_cache_entry_t's, and then the
+    arrays of all matrices, each at a 64-byte aligned offset
+*/
+typedef struct {
+  char magic[16];               /**< sparse_cache_magic */
+  int version;                  /**< sparse_cache_version */
+  int idx_sz;                   /**< sizeof(idx_t) */
+  int nnz_sz;                   /**< sizeof(nnz_t) */
+  int real_sz;                  /**< sizeof(real) */
+  int sparse_sz;                /**< sizeof(sparse_t) */
+  char key[512];                /**< the options the matrices were made with (see sparse_cache_key) */
+  int n_mats;                   /**< 1 (A) or 2 (A and tA) */
+  unsigned short rg[3];         /**< the random number generator state after making A */
+} sparse_cache_header_t;
+
+/** 
+    @brief a matrix in a cache file
+*/
+typedef struct {
+  sparse_t A;                   /**< the matrix (pointers are meaningless) */
+  int n_arrays;                 /**< the number of arrays */
+  size_t off[SPARSE_MAX_ARRAYS]; /**< offset of each array from the beginning of the file */
+  size_t sz[SPARSE_MAX_ARRAYS]; /**< size of each array in bytes */
+} sparse_cache_entry_t;
+
+/** 
+    @brief an array of a sparse matrix
+*/
+typedef struct {
+  void ** p;                    /**< the pointer field of the matrix */
+  size_t sz;                    /**< size in bytes */
+} sparse_array_t;
+
+/** 
+    @brief a mapped cache file
+*/
+typedef struct {
+  void * base;                  /**< the address it is mapped at (null if none) */
+  size_t sz;                    /**< its size */
+} sparse_cache_t;
+
+/** 
+    @brief list the arrays of a sparse matrix
+    @param (A) a sparse matrix
+    @param (a) the arrays are stored to it (at most SPARSE_MAX_ARRAYS)
+    @param (sized) 1 to compute their sizes too
+    @return the number of arrays, or -1 if A's format is invalid
+    @details some sizes are read from A's arrays (e.g., the number of
+    elements of sell is chunk_start[n_chunks]), so pass sized = 0
+    when A's pointers are not valid yet
+*/
+static int sparse_arrays(sparse_t& A, sparse_array_t * a, int sized) {
+  switch (A.format) {
+  case sparse_format_coo:
+  case sparse_format_coo_sorted:
+    a[0] = { (void **)&A.coo.elems, sizeof(coo_elem_t) * A.nnz };
+    return 1;
+  case sparse_format_csr:
+  case sparse_format_csr_sym:
+    a[0] = { (void **)&A.csr.row_start, sizeof(nnz_t) * (A.M + 1) };
+    a[1] = { (void **)&A.csr.elems, sizeof(csr_elem_t) * A.nnz };
+    return 2;
+  case sparse_format_sell: {
+    size_t n_chunks = A.sell.n_chunks;
+    size_t n_elems = (sized ? A.sell.chunk_start[n_chunks] : 0);
+    a[0] = { (void **)&A.sell.chunk_start, sizeof(nnz_t) * (n_chunks + 1) };
+    a[1] = { (void **)&A.sell.row, sizeof(idx_t) * n_chunks * sell_C };
+    a[2] = { (void **)&A.sell.row_len, sizeof(idx_t) * n_chunks * sell_C };
+    a[3] = { (void **)&A.sell.col, sizeof(idx_t) * n_elems };
+    a[4] = { (void **)&A.sell.val, sizeof(real) * n_elems };
+    return 5;
+  }
+  case sparse_format_bcsr: {
+    size_t n_block_rows = A.bcsr.n_block_rows;
+    size_t n_blocks = (sized ? A.bcsr.block_row_start[n_block_rows] : 0);
+    a[0] = { (void **)&A.bcsr.block_row_start, sizeof(nnz_t) * (n_block_rows + 1) };
+    a[1] = { (void **)&A.bcsr.block_col, sizeof(idx_t) * n_blocks };
+    a[2] = { (void **)&A.bcsr.val, sizeof(real) * A.bcsr.R * A.bcsr.C * n_blocks };
+    return 3;
+  }
+  case sparse_format_csr_soa:
+    a[0] = { (void **)&A.csr_soa.row_start, sizeof(nnz_t) * (A.M + 1) };
+    a[1] = { (void **)&A.csr_soa.col_idx, sizeof(idx_t) * A.nnz };
+    a[2] = { (void **)&A.csr_soa.vals, sizeof(real) * A.nnz };
+    return 3;
+  case sparse_format_csr_delta: {
+    size_t n_words = (sized ? A.csr_delta.code_start[A.M] : 0);
+    a[0] = { (void **)&A.csr_delta.row_start, sizeof(nnz_t) * (A.M + 1) };
+    a[1] = { (void **)&A.csr_delta.code_start, sizeof(nnz_t) * (A.M + 1) };
+    a[2] = { (void **)&A.csr_delta.code, (size_t)A.csr_delta.width * n_words };
+    a[3] = { (void **)&A.csr_delta.vals, sizeof(real) * A.nnz };
+    return 4;
+  }
+  case sparse_format_tiled: {
+    size_t n_tiles = (size_t)A.tiled.n_row_blocks * A.tiled.n_col_segs;
+    size_t n_rows = (sized ? A.tiled.tile_start[n_tiles] : 0);
+    a[0] = { (void **)&A.tiled.tile_start, sizeof(nnz_t) * (n_tiles + 1) };
+    a[1] = { (void **)&A.tiled.row, sizeof(idx_t) * n_rows };
+    a[2] = { (void **)&A.tiled.row_start, sizeof(nnz_t) * (n_rows + 1) };
+    a[3] = { (void **)&A.tiled.col, sizeof(idx_t) * A.nnz };
+    a[4] = { (void **)&A.tiled.val, sizeof(real) * A.nnz };
+    return 5;
+  }
+  default:
+    return -1;
   }
-  long t3 = cur_time_ns();
-  long dt = t3 - t2;
-  printf("%s:%d:repeat_spmv: main loop ends\n", __FILE__, __LINE__);
-  printf("%ld flops in %.6f sec (%.6f GFLOPS)\n",
-         flops, dt*1.0e-9, flops/(double)dt);
-  return lambda;
 }
-  
+
 /** 
-    @brief make a random vector of n elements
-    @param (n) the number of elements of the vector
-    @param (rg) random number generator state (passed to erand48)
-    @return a vector of n elements
+    @brief make the key that identifies how matrices were made
+    @param (opt) command line options
+    @param (M) the number of rows
+    @param (N) the number of columns
+    @param (nnz) the number of non-zeros
+    @param (key) the key is written to it
+    @param (sz) the size of key
+    @details it has everything that affects A and tA: the matrix
+    type and its parameters, the format and, for a file, its size
+    and modification time
 */
-static vec_t mk_vec_random(idx_t n, unsigned short rg[3]) {
-  real * x = (real *)xalloc(sizeof(real) * n);
-  for (idx_t i = 0; i < n; i++) {
-    x[i] = erand48(rg);
+static void sparse_cache_key(cmdline_options_t opt, idx_t M, idx_t N, nnz_t nnz,
+                             char * key, size_t sz) {
+  long file_sz = 0, file_mtime = 0;
+  if (opt.matrix_type == sparse_matrix_type_coo_file) {
+    struct stat sb[1];
+    if (stat(opt.coo_file, sb) == 0) {
+      file_sz = sb->st_size;
+      file_mtime = sb->st_mtime;
+    }
   }
-  vec_t v = { n, x };
-  return v;
+  snprintf(key, sz,
+           "format=%d sym=%d type=%d M=%ld N=%ld nnz=%ld rmat=%s seed=%ld"
+           " file=%s,%ld,%ld",
+           (int)opt.format, sparse_sym_detect(opt), (int)opt.matrix_type,
+           (long)M, (long)N, (long)nnz, opt.rmat_str, opt.seed,
+           (opt.matrix_type == sparse_matrix_type_coo_file ? opt.coo_file : ""),
+           file_sz, file_mtime);
 }
 
 /** 
-    @brief make a random unit-length vector of n elements
-    @param (n) the number of elements of the vector
-    @param (rg) random number generator state (passed to erand48)
-    @return a vector of n elements
+    @brief load matrices from a cache file
+    @param (file) the cache file
+    @param (key) the key the matrices must have been made with
+    @param (cache) the mapping is stored to it
+    @param (A) the matrix
+    @param (tA) its transpose (left invalid if the file has none)
+    @param (rg) the random number generator state after making A is
+    restored to it, so the rest of the run is the same as when the
+    matrices were made
+    @return the number of matrices loaded (0 if file does not exist
+    or is not a valid cache for key)
+    @details the file is mmapped and the pointers of A and tA are set
+    to the arrays in it, so nothing is read until the pages are
+    touched.  A and tA are marked mapped, so sparse_destroy leaves
+    them alone; unmap them with sparse_cache_close.
 */
-static vec_t mk_vec_unit_random(idx_t n, unsigned short rg[3]) {
-  vec_t x = mk_vec_random(n, rg);
-  vec_normalize(spmv_algo_serial, x);
-  return x;
+static int sparse_cache_load(const char * file, const char * key,
+                             sparse_cache_t * cache, sparse_t * A, sparse_t * tA,
+                             unsigned short rg[3]) {
+  printf("%s:%d:sparse_cache_load starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  int fd = open(file, O_RDONLY);
+  if (fd == -1) {
+    printf("%s:%d:sparse_cache_load: %s does not exist\n",
+           __FILE__, __LINE__, file);
+    return 0;
+  }
+  struct stat sb[1];
+  if (fstat(fd, sb) == -1 || (size_t)sb->st_size < sizeof(sparse_cache_header_t)) {
+    close(fd);
+    printf("%s:%d:sparse_cache_load: %s is not a cache\n",
+           __FILE__, __LINE__, file);
+    return 0;
+  }
+  size_t sz = sb->st_size;
+  void * base = mmap(0, sz, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror("mmap");
+    return 0;
+  }
+  sparse_cache_header_t * h = (sparse_cache_header_t *)base;
+  const char * why = 0;
+  if (memcmp(h->magic, sparse_cache_magic, sizeof(h->magic)) != 0) {
+    why = "not a cache";
+  } else if (h->version != sparse_cache_version
+             || h->idx_sz != (int)sizeof(idx_t)
+             || h->nnz_sz != (int)sizeof(nnz_t)
+             || h->real_sz != (int)sizeof(real)
+             || h->sparse_sz != (int)sizeof(sparse_t)) {
+    why = "made by another version of this program";
+  } else if (strncmp(h->key, key, sizeof(h->key)) != 0) {
+    why = "made with different options";
+  } else if (h->n_mats < 1 || h->n_mats > 2
+             || sizeof(sparse_cache_header_t)
+             + h->n_mats * sizeof(sparse_cache_entry_t) > sz) {
+    why = "broken";
+  }
+  sparse_t mats[2] = { mk_sparse_invalid(), mk_sparse_invalid() };
+  for (int m = 0; !why && m < h->n_mats; m++) {
+    sparse_cache_entry_t * e = (sparse_cache_entry_t *)(h + 1) + m;
+    sparse_t B = e->A;
+    sparse_array_t a[SPARSE_MAX_ARRAYS] = {};
+    int n_arrays = sparse_arrays(B, a, 0);
+    if (n_arrays != e->n_arrays) {
+      why = "broken";
+      break;
+    }
+    for (int k = 0; k < n_arrays; k++) {
+      if (e->off[k] % 64 != 0 || e->off[k] > sz || e->sz[k] > sz - e->off[k]) {
+        why = "broken";
+        break;
+      }
+      *a[k].p = (char *)base + e->off[k];
+    }
+    B.part = 0;
+    B.mapped = 1;
+    mats[m] = B;
+  }
+  if (why) {
+    printf("%s:%d:sparse_cache_load: %s is %s\n",
+           __FILE__, __LINE__, file, why);
+    munmap(base, sz);
+    return 0;
+  }
+  int n_mats = h->n_mats;
+  memcpy(rg, h->rg, sizeof(h->rg));
+  *A = mats[0];
+  *tA = mats[1];
+  cache->base = base;
+  cache->sz = sz;
+  long t1 = cur_time_ns();
+  printf("%s:%d:sparse_cache_load ends. mapped %ld bytes, %d matrices."
+         " took %.3f sec\n",
+         __FILE__, __LINE__, (long)sz, n_mats, (t1 - t0) * 1.0e-9);
+  return n_mats;
 }
 
 /** 
-    @brief make a zero vector of n elements
-    @param (n) the number of elements of the vector
-    @return a zero vector of n elements
+    @brief write zeros to make the position of a file a multiple of 64
+    @param (wp) the file
+    @param (pos) the current position
+    @return the new position
 */
-static vec_t mk_vec_zero(idx_t n) {
-  real * x = (real *)xalloc(sizeof(real) * n);
-  for (idx_t i = 0; i < n; i++) {
-    x[i] = 0.0;
-  }
-  vec_t v = { n, x };
-  return v;
+static size_t cache_pad(FILE * wp, size_t pos) {
+  static const char zeros[64] = { 0 };
+  size_t r = (64 - pos % 64) % 64;
+  fwrite(zeros, 1, r, wp);
+  return pos + r;
 }
 
 /** 
-    @brief compare two elements in an array of idx_t 
-    @param (a_) the pointer to an element 1
-    @param (b_) the pointer to an element 2
+    @brief save matrices to a cache file
+    @param (file) the cache file
+    @param (key) the key the matrices were made with
+    @param (A) the matrix
+    @param (tA) its transpose (not saved if invalid)
+    @param (rg) the random number generator state after making A
+    @return 1 if succeed, 0 if failed
+    @details it writes to file.tmp and then renames it to file, so
+    a process that has mapped the old file is not affected and an
+    interrupted write leaves no broken cache behind
 */
-static int cmp_idx_fun(const void * a_, const void * b_) {
-  idx_t * a = (idx_t *)a_;
-  idx_t * b = (idx_t *)b_;
-  return *a - *b;
+static int sparse_cache_save(const char * file, const char * key,
+                             sparse_t A, sparse_t tA, unsigned short rg[3]) {
+  printf("%s:%d:sparse_cache_save starts ...\n", __FILE__, __LINE__);
+  long t0 = cur_time_ns();
+  int n_mats = (tA.format == sparse_format_invalid ? 1 : 2);
+  sparse_t mats[2] = { A, tA };
+  sparse_cache_header_t h[1];
+  memset(h, 0, sizeof(h));
+  memcpy(h->magic, sparse_cache_magic, sizeof(h->magic));
+  h->version = sparse_cache_version;
+  h->idx_sz = sizeof(idx_t);
+  h->nnz_sz = sizeof(nnz_t);
+  h->real_sz = sizeof(real);
+  h->sparse_sz = sizeof(sparse_t);
+  snprintf(h->key, sizeof(h->key), "%s", key);
+  h->n_mats = n_mats;
+  memcpy(h->rg, rg, sizeof(h->rg));
+  /* lay out the arrays */
+  sparse_cache_entry_t e[2];
+  sparse_array_t a[2][SPARSE_MAX_ARRAYS] = {};
+  memset(e, 0, sizeof(e));
+  size_t pos = sizeof(sparse_cache_header_t) + n_mats * sizeof(sparse_cache_entry_t);
+  for (int m = 0; m < n_mats; m++) {
+    e[m].A = mats[m];
+    e[m].A.part = 0;
+    e[m].A.mapped = 0;
+    e[m].n_arrays = sparse_arrays(mats[m], a[m], 1);
+    if (e[m].n_arrays < 0) {
+      fprintf(stderr,
+              "error:%s:%d: sparse_cache_save: invalid format %d\n",
+              __FILE__, __LINE__, mats[m].format);
+      return 0;
+    }
+    /* pointers are meaningless in the file; zero them so that the
+       same matrices always make the same file */
+    sparse_array_t b[SPARSE_MAX_ARRAYS] = {};
+    sparse_arrays(e[m].A, b, 0);
+    for (int k = 0; k < e[m].n_arrays; k++) {
+      *b[k].p = 0;
+    }
+    for (int k = 0; k < e[m].n_arrays; k++) {
+      pos = (pos + 63) / 64 * 64;
+      e[m].off[k] = pos;
+      e[m].sz[k] = a[m][k].sz;
+      pos += a[m][k].sz;
+    }
+  }
+  size_t tmp_sz = strlen(file) + 5;
+  char * tmp = (char *)xalloc(tmp_sz);
+  snprintf(tmp, tmp_sz, "%s.tmp", file);
+  FILE * wp = fopen(tmp, "wb");
+  if (!wp) {
+    perror(tmp);
+    xfree(tmp);
+    return 0;
+  }
+  int ok = (fwrite(h, sizeof(sparse_cache_header_t), 1, wp) == 1
+            && fwrite(e, sizeof(sparse_cache_entry_t), n_mats, wp) == (size_t)n_mats);
+  pos = sizeof(sparse_cache_header_t) + n_mats * sizeof(sparse_cache_entry_t);
+  for (int m = 0; ok && m < n_mats; m++) {
+    for (int k = 0; ok && k < e[m].n_arrays; k++) {
+      pos = cache_pad(wp, pos);
+      assert(pos == e[m].off[k]);
+      ok = (fwrite(*a[m][k].p, 1, e[m].sz[k], wp) == e[m].sz[k]);
+      pos += e[m].sz[k];
+    }
+  }
+  if (fclose(wp) != 0) ok = 0;
+  if (ok && rename(tmp, file) != 0) {
+    perror(file);
+    ok = 0;
+  }
+  if (!ok) {
+    fprintf(stderr,
+            "error:%s:%d: sparse_cache_save: could not write %s\n",
+            __FILE__, __LINE__, tmp);
+    unlink(tmp);
+  }
+  xfree(tmp);
+  long t1 = cur_time_ns();
+  printf("%s:%d:sparse_cache_save ends. wrote %ld bytes, %d matrices."
+         " took %.3f sec\n",
+         __FILE__, __LINE__, (long)pos, n_mats, (t1 - t0) * 1.0e-9);
+  return ok;
 }
 
 /** 
-    @brief dump a sparse matrix A into img_width x img_height bitmap
-    (gnuplot file) with the specified filename.
-    @param (A) a sparse matrix to dump
-    @param (file) the file name to dump A into 
-    @param (max_points) the maximum number of points dumped into the file
-    @param (seed) the random number seed to choose elements to dump
+    @brief unmap a cache file mapped by sparse_cache_load
 */
+static void sparse_cache_close(sparse_cache_t cache) {
+  if (cache.base) {
+    munmap(cache.base, cache.sz);
+  }
+}
 
-static int dump_sparse_file(sparse_t A, char * file, idx_t max_points, long seed) {
-  printf("%s:%d:dump_sparse_file:"
-         " dumping to matrix %ld x %ld (%ld nnz) -> %s\n",
-         __FILE__, __LINE__,
-         (long)A.M, (long)A.N, (long)A.nnz, file);
-  fflush(stdout);
-  sparse_t B = sparse_any_to_any(A, sparse_format_coo);
-  idx_t M = B.M;
-  idx_t N = B.N;
-  idx_t nnz = B.nnz;
-  coo_elem_t * elems = B.coo.elems;
+/*********************************************************
+ *
+ * placing arrays on NUMA nodes (--numa, --pin, --numa-report)
+ *
+ *********************************************************/
 
-  idx_t * row_nnz = (idx_t *)malloc(sizeof(idx_t) * M);
-  for (idx_t i = 0; i < M; i++) {
-    row_nnz[i] = 0;
+/** 
+    @brief pin the threads of parallel regions to CPUs
+    @param (spec) the CPUs (see numa_pin_cpus)
+    @return 1 if all threads are pinned, 0 otherwise
+    @details thread t is pinned to the (t mod n)th CPU of spec, as
+    OMP_PLACES={c0},{c1},... OMP_PROC_BIND=close would do, but for
+    a runtime that has already read its environment.  the runtime
+    keeps its threads for later regions, so they stay pinned.
+*/
+static int pin_threads(const char * spec) {
+  int * cpus = (int *)xalloc(sizeof(int) * numa_max_cpus);
+  int n_cpus = numa_pin_cpus(spec, cpus, numa_max_cpus);
+  int n_threads = get_n_threads();
+  int * ok = (int *)xalloc(sizeof(int) * n_threads);
+  for (int t = 0; t < n_threads; t++) {
+    ok[t] = 0;
   }
-  /* randomly choose up to max_points */
-  unsigned short rg[3] = {
-    (unsigned short)((seed >> 32) & ((1 << 16) - 1)),
-    (unsigned short)((seed >> 16) & ((1 << 16) - 1)),
-    (unsigned short)((seed >> 0 ) & ((1 << 16) - 1)),
-  };
-  idx_t * chosen = (idx_t *)malloc(sizeof(idx_t) * max_points);
-  idx_t n_points = 0;
-  for (idx_t k = 0; k < nnz; k++) {
-    /* count non-zeros in each row */
-    idx_t i = elems[k].i;
-    row_nnz[i]++;
-    /* choose it with an equal probability */
-    if (n_points < max_points) {
-      chosen[n_points] = k;
-      n_points++;
-    } else {
-      if (erand48(rg) < n_points / (double)max_points) {
-        idx_t replaced = nrand48(rg) % n_points;
-        chosen[replaced] = k;
-      }
+#pragma omp parallel
+  {
+    int t = get_thread_num();
+    if (t < n_threads) {
+      ok[t] = (numa_pin_self(cpus[t % n_cpus]) == 0);
     }
   }
-  qsort((void *)chosen, n_points, sizeof(idx_t), cmp_idx_fun);
-    
-  FILE * wp = fopen(file, "w");
-  if (!wp) {
-    perror(file);
-    return 0;
+  int n_ok = 0;
+  printf("%s:%d:pin_threads: thread->cpu(node)", __FILE__, __LINE__);
+  for (int t = 0; t < n_threads; t++) {
+    int c = cpus[t % n_cpus];
+    printf(" %d->%d(%d)%s", t, c, numa_cpu_node(c), (ok[t] ? "" : "!"));
+    n_ok += ok[t];
   }
-  fprintf(wp, "# add -e 'term=\"png\"' etc. to the gnuplot commad line to generate a file instead of showing it on the screen. e.g. gnuplot -e 'term=\"png\"' x.gnuplot\n");
-  fprintf(wp, "if (exists(\"term\")) set terminal term\n");
-  
-  fprintf(wp, "# add -e 'nnz_mat=\"FILENAME\"' etc. to the gnuplot commad line to output non-zero matrix to the specified file name . e.g. gnuplot -e 'term=\"png\"' -e 'nnz_mat=\"nnz_mat.png\"' x.gnuplot\n");
-  fprintf(wp, "if (exists(\"nnz_mat\")) set output nnz_mat\n");
-  fprintf(wp, "set title \"nnz_mat : matrix of non zero elements\"\n");
-  fprintf(wp, "set xlabel \"row\"\n");
-  fprintf(wp, "set xrange [0:%ld]\n", (long)M);
-  fprintf(wp, "set ylabel \"column\"\n");
-  fprintf(wp, "set yrange [0:%ld]\n", (long)N);
-  fprintf(wp, "$mat << EOD\n");
-  for (idx_t i = 0; i < n_points; i++) {
-    idx_t k = chosen[i];
-    coo_elem_t * e = elems + k;
-    fprintf(wp, "%ld %ld %f\n", (long)e->i, (long)e->j, e->a);
+  printf("\n");
+  if (n_ok < n_threads) {
+    fprintf(stderr,
+            "warning:%s:%d: could not pin %d of %d threads (marked !)\n",
+            __FILE__, __LINE__, n_threads - n_ok, n_threads);
   }
-  fprintf(wp, "EOD\n");
-  fprintf(wp, "plot '$mat' with points\n");
-  fprintf(wp, "if (!exists(\"nnz_mat\")) pause -1\n");
+  xfree(ok);
+  xfree(cpus);
+  return n_ok == n_threads;
+}
 
-  /* reset everything to go ahead to the second graph */
-  fprintf(wp, "reset\n");
-  
-  /* non-zero distribution */
-  fprintf(wp, "# add -e 'nnz_row=\"FILENAME\"' etc. to the gnuplot commad line to output non-zero distribution over rows. e.g. gnuplot -e 'term=\"png\"' -e 'nnz_mat=\"nnz_mat.png\"' x.gnuplot\n");
-  fprintf(wp, "if (exists(\"nnz_row\")) set output nnz_row\n");
-  
-  fprintf(wp, "set title \"nnz_row : the number of non zeros in each row\"\n");
-  fprintf(wp, "set xlabel \"row\"\n");
-  fprintf(wp, "set xrange [0:%ld]\n", (long)M);
-  fprintf(wp, "set ylabel \"the number of non zeros\"\n");
-  fprintf(wp, "set yrange [0:]\n");
-  fprintf(wp, "$row_nnz << EOD\n");
-  for (idx_t i = 0; i < M; i++) {
-    fprintf(wp, "%ld %ld\n", (long)i, (long)row_nnz[i]);
+/** 
+    @brief check if the partition of a matrix is by rows, which
+    numa_place places arrays along
+    @param (A) a sparse matrix
+    @return 1 if A is csr, csr_soa or csr_sym and partitioned, and
+    part p is always computed by thread p
+    @details csr_sym with colored parts does not qualify, as
+    spmv_csr_sym_parallel_colored hands out the parts of each color
+    by schedule(dynamic, 1), so no thread owns a part
+*/
+static int numa_row_partitioned(sparse_t A) {
+  if (!A.part) return 0;
+  if (A.format == sparse_format_csr_sym) {
+    return A.part->n_colors == 0;
   }
-  fprintf(wp, "EOD\n");
-  fprintf(wp, "plot '$row_nnz' with lines title \"\"\n");
-  fprintf(wp, "if (!exists(\"nnz_row\")) pause -1\n");
-  
-  fclose(wp);
-  xfree(row_nnz);
-  printf("%s:%d:dump_sparse_file: done\n",
-         __FILE__, __LINE__);
-  fflush(stdout);
+  return (A.format == sparse_format_csr
+          || A.format == sparse_format_csr_soa);
+}
+
+/** 
+    @brief copy an array to a new one, each part by the thread that
+    computes it
+    @param (a) the array, which is freed
+    @param (off) part p is bytes [off[p], off[p+1]) of a
+    @param (n) the number of parts
+    @return the new array
+    @details parts go to threads by schedule(static, 1), as in the
+    parallel spmv kernels of the formats numa_row_partitioned
+    accepts, so (with pinned threads) the pages of a part are first
+    touched, and hence allocated, on the node of the thread that
+    reads them later.  task hands out rows dynamically, for which
+    this is only a good guess.  a page straddling two parts goes to
+    either of them.
+*/
+static void * first_touch_copy(void * a, size_t * off, int n) {
+  char * b = (char *)xalloc_aligned(4096, off[n]);
+#pragma omp parallel for schedule(static, 1)
+  for (int p = 0; p < n; p++) {
+    memcpy(b + off[p], (char *)a + off[p], off[p + 1] - off[p]);
+  }
+  xfree(a);
+  return b;
+}
+
+/** 
+    @brief move the arrays of a matrix to the nodes of the threads
+    computing them
+    @param (A) a sparse matrix partitioned by rows (numa_row_partitioned)
+    @return 1 if moved, 0 if A is left as it is
+*/
+static int sparse_first_touch(sparse_t& A) {
+  if (!numa_row_partitioned(A) || A.mapped) {
+    printf("%s:%d:sparse_first_touch: %s %s left where it is\n",
+           __FILE__, __LINE__, sparse_format_table.t[A.format].name,
+           (A.mapped ? "(in a cache file mapping)"
+            : "(no thread owns a part of rows)"));
+    return 0;
+  }
+  sparse_part_t * part = A.part;
+  int n = part->n;
+  size_t * off = (size_t *)xalloc(sizeof(size_t) * (n + 1));
+  /* the last part also has row_start[M] */
+  for (int p = 0; p <= n; p++) {
+    off[p] = sizeof(nnz_t) * (p < n ? part->row_start[p] : A.M + 1);
+  }
+  if (A.format == sparse_format_csr_soa) {
+    A.csr_soa.row_start = (nnz_t *)first_touch_copy(A.csr_soa.row_start, off, n);
+    for (int p = 0; p <= n; p++) {
+      off[p] = sizeof(idx_t) * part->elem_start[p];
+    }
+    A.csr_soa.col_idx = (idx_t *)first_touch_copy(A.csr_soa.col_idx, off, n);
+    for (int p = 0; p <= n; p++) {
+      off[p] = sizeof(real) * part->elem_start[p];
+    }
+    A.csr_soa.vals = (real *)first_touch_copy(A.csr_soa.vals, off, n);
+  } else {
+    A.csr.row_start = (nnz_t *)first_touch_copy(A.csr.row_start, off, n);
+    for (int p = 0; p <= n; p++) {
+      off[p] = sizeof(csr_elem_t) * part->elem_start[p];
+    }
+    A.csr.elems = (csr_elem_t *)first_touch_copy(A.csr.elems, off, n);
+  }
+  xfree(off);
   return 1;
 }
 
+/** 
+    @brief move a vector to the nodes of the threads computing its
+    elements
+    @param (v) a vector
+    @param (part) the partition of the matrix whose rows are the
+    elements of v (null to split v evenly among threads)
+*/
+static void vec_first_touch(vec_t& v, sparse_part_t * part) {
+  int n = (part ? part->n : get_n_threads());
+  size_t * off = (size_t *)xalloc(sizeof(size_t) * (n + 1));
+  for (int p = 0; p <= n; p++) {
+    idx_t i = (part ? part->row_start[p] : (idx_t)((long)v.n * p / n));
+    off[p] = sizeof(real) * i;
+  }
+  assert(off[n] == sizeof(real) * v.n);
+  v.elems = (real *)first_touch_copy(v.elems, off, n);
+  xfree(off);
+}
+
+/** 
+    @brief move a vector to pages interleaved over all nodes
+    @param (v) a vector
+    @return 1 if succeed, 0 if the memory policy could not be set (v
+    is left as it is)
+*/
+static int vec_interleave(vec_t& v) {
+  size_t sz = (sizeof(real) * v.n + 4095) / 4096 * 4096;
+  real * b = (real *)xalloc_aligned(4096, sz);
+  if (numa_interleave(b, sz) == -1) {
+    fprintf(stderr,
+            "warning:%s:%d: could not interleave a vector (%s)\n",
+            __FILE__, __LINE__, strerror(errno));
+    xfree(b);
+    return 0;
+  }
+  memcpy(b, v.elems, sizeof(real) * v.n);
+  xfree(v.elems);
+  v.elems = b;
+  return 1;
+}
 
+/** 
+    @brief place the arrays of A, tA, x and y on nodes (--numa)
+    @param (mode) numa_mode_t
+    @param (algo) the algorithm that is going to work on them
+    @param (A) a sparse matrix
+    @param (tA) its transpose (may be invalid)
+    @param (x) the vector A is multiplied by
+    @param (y) the vector that receives A x
+    @details A and tA are partitioned as repeat_spmv does, which
+    partitions them again in the same way.  y = A x is written by
+    the parts of A and x = tA y by those of tA, so each of them is
+    first touched along the rows of the matrix that writes it.  A x
+    reads x at scattered columns, though, so interleave-x spreads x
+    over all nodes so that no node serves all of it.  serial and
+    cuda are left alone.
+*/
+static void numa_place(int mode, spmv_algo_t algo, sparse_t& A, sparse_t& tA,
+                       vec_t& x, vec_t& y) {
+  if (mode == numa_mode_none) return;
+  if (algo == spmv_algo_serial || algo == spmv_algo_cuda) {
+    printf("%s:%d:numa_place: nothing to place for %s\n",
+           __FILE__, __LINE__, spmv_algo_table.t[algo].name);
+    return;
+  }
+  printf("%s:%d:numa_place (%s) starts ...\n",
+         __FILE__, __LINE__, numa_mode_names[mode]);
+  long t0 = cur_time_ns();
+  int n_threads = get_n_threads();
+  sparse_partition(algo, A, n_threads);
+  sparse_first_touch(A);
+  if (tA.format == sparse_format_csr_sym) {
+    /* it shares the arrays of A, which have just moved */
+    sparse_destroy(tA);
+    tA = sparse_transpose(A);
+    sparse_partition(algo, tA, n_threads);
+  } else if (tA.format != sparse_format_invalid) {
+    sparse_partition(algo, tA, n_threads);
+    sparse_first_touch(tA);
+  }
+  vec_first_touch(y, (numa_row_partitioned(A) ? A.part : 0));
+  if (mode != numa_mode_interleave_x || !vec_interleave(x)) {
+    vec_first_touch(x, (numa_row_partitioned(tA) ? tA.part : 0));
+  }
+  long t1 = cur_time_ns();
+  printf("%s:%d:numa_place ends. took %.3f sec\n",
+         __FILE__, __LINE__, (t1 - t0) * 1.0e-9);
+}
 
+/** 
+    @brief print the number of pages of an array on each node
+    @param (name) the name of the array
+    @param (a) the array
+    @param (sz) its size in bytes
+    @param (n_nodes) the number of nodes
+*/
+static void numa_report_1(const char * name, void * a, size_t sz, int n_nodes) {
+  long * count = (long *)xalloc(sizeof(long) * (n_nodes + 2));
+  numa_page_nodes(a, (char *)a + sz, count, n_nodes);
+  printf("%-8s %10.3f", name, sz / (double)(1 << 20));
+  for (int d = 0; d < n_nodes + 2; d++) {
+    printf(" %8ld", count[d]);
+  }
+  printf("\n");
+  xfree(count);
+}
 
 /** 
-    @brief the main function
+    @brief print how the pages of matrices and vectors are spread
+    over nodes (--numa-report)
+    @param (A) a sparse matrix
+    @param (tA) its transpose (may be invalid)
+    @param (x) a vector
+    @param (y) a vector
 */
+static void numa_report(sparse_t A, sparse_t tA, vec_t x, vec_t y) {
+  int n_nodes = numa_n_nodes();
+  printf("%s:%d:numa_report: 4KB pages of each array on each node\n",
+         __FILE__, __LINE__);
+  printf("%-8s %10s", "array", "MB");
+  for (int d = 0; d < n_nodes; d++) {
+    char h[16];
+    snprintf(h, sizeof(h), "node%d", d);
+    printf(" %8s", h);
+  }
+  printf(" %8s %8s\n", "absent", "unknown");
+  sparse_t mats[2] = { A, tA };
+  const char * mat_names[2] = { "A", "tA" };
+  for (int m = 0; m < 2; m++) {
+    if (mats[m].format == sparse_format_invalid) continue;
+    if (m == 1 && tA.format == sparse_format_csr_sym) {
+      printf("%-8s (shares the arrays of A)\n", "tA");
+      continue;
+    }
+    sparse_array_t a[SPARSE_MAX_ARRAYS] = {};
+    int n_arrays = sparse_arrays(mats[m], a, 1);
+    for (int k = 0; k < n_arrays; k++) {
+      char name[16];
+      snprintf(name, sizeof(name), "%s[%d]", mat_names[m], k);
+      numa_report_1(name, *a[k].p, a[k].sz, n_nodes);
+    }
+  }
+  numa_report_1("x", x.elems, sizeof(real) * x.n, n_nodes);
+  numa_report_1("y", y.elems, sizeof(real) * y.n, n_nodes);
+}
+
 int main(int argc, char ** argv) {
   cmdline_options_t opt = parse_args(argc, argv);
   if (opt.help || opt.error) {
     usage(argv[0]);
     exit(opt.error);
   }
-  idx_t M        = opt.M;
-  idx_t N        = (opt.N ? opt.N : M);
-  idx_t nnz      = (opt.nnz ? opt.nnz : ((long)M * (long)N + 99L) / 100L);
+  long M_        = opt.M;
+  long N_        = (opt.N ? opt.N : M_);
+  long nnz_      = (opt.nnz ? opt.nnz : (M_ * N_ + 99L) / 100L);
+  /* a file gets its shape from the file (checked by read_coo_file) */
+  if (opt.matrix_type != sparse_matrix_type_coo_file
+      && !sparse_shape_ok("main", M_, N_, nnz_)) {
+    cmdline_options_destroy(opt);
+    exit(1);
+  }
+  idx_t M        = (idx_t)M_;
+  idx_t N        = (idx_t)N_;
+  nnz_t nnz      = (nnz_t)nnz_;
   long repeat    = opt.repeat;
   unsigned short rg[3] = {
     (unsigned short)((opt.seed >> 32) & ((1 << 16) - 1)),
@@ -2073,29 +8812,209 @@ int main(int argc, char ** argv) {
   printf("algo : %s\n", opt.algo_str);
 
   //sparse_t A = mk_sparse_random(opt.format, M, N, nnz, rg);
-  sparse_t A = mk_sparse_matrix(opt, M, N, nnz, rg);
+  sparse_cache_t cache = { 0, 0 };
+  char cache_key[512];
+  sparse_cache_key(opt, M, N, nnz, cache_key, sizeof(cache_key));
+  sparse_t A = mk_sparse_invalid();
+  sparse_t tA = mk_sparse_invalid();
+  int n_cached = (opt.cache ? sparse_cache_load(opt.cache, cache_key, &cache, &A, &tA, rg) : 0);
+  if (n_cached == 0) {
+    A = mk_sparse_matrix(opt, M, N, nnz, rg);
+  }
+  if (A.format == sparse_format_invalid) {
+    fprintf(stderr, "error:%s:%d: could not make the matrix\n",
+            __FILE__, __LINE__);
+    cmdline_options_destroy(opt);
+    exit(1);
+  }
   if (opt.dump) {
-    dump_sparse_file(A, opt.dump, opt.dump_points, opt.dump_seed);
+    dump_sparse_file(A, opt.dump, (nnz_t)opt.dump_points, opt.dump_seed);
   }
-  sparse_t tA = sparse_transpose(A);
-  printf("%s:%d:main A is %ld x %ld, has %ld non-zeros and takes %ld bytes\n",
-         __FILE__, __LINE__,
-         (long)A.M, (long)A.N, (long)A.nnz, sparse_size(A));
-  printf("%s:%d:main tA is %ld x %ld, has %ld non-zeros and takes %ld bytes\n",
+  /* --fused never needs tA */
+  if (!opt.fused && tA.format == sparse_format_invalid) {
+    tA = sparse_transpose(A);
+  }
+  /* the transpose of csr_sym is A itself (csr_sym_transpose) */
+  int save_tA = (tA.format != sparse_format_invalid
+                 && tA.format != sparse_format_csr_sym);
+  if (opt.cache && n_cached < (save_tA ? 2 : 1)) {
+    sparse_cache_save(opt.cache, cache_key, A, (save_tA ? tA : mk_sparse_invalid()), rg);
+  }
+  if (opt.autotune) {
+    spmv_tune_t t = spmv_autotune(A, opt.tune_file, opt.fused || opt.fused_norm,
+                                  opt.mixed);
+    set_n_threads(t.n_threads);
+    opt.format = t.format;
+    opt.algo = t.algo;
+    if (A.format != t.format) {
+      sparse_t B = sparse_any_to_any(A, t.format);
+      sparse_destroy(A);
+      A = B;
+    }
+    if (tA.format != sparse_format_invalid && tA.format != t.format) {
+      /* the transpose of csr_sym shares the arrays of A, just freed */
+      sparse_t tB = (tA.format == sparse_format_csr_sym
+                     ? sparse_transpose(A)
+                     : sparse_any_to_any(tA, t.format));
+      sparse_destroy(tA);
+      tA = tB;
+    }
+    printf("autotune : %s %s with %d threads\n",
+           sparse_format_table.t[t.format].name, spmv_algo_table.t[t.algo].name,
+           t.n_threads);
+  }
+  /* after autotune, which may change the number of threads */
+  if (strcmp(opt.pin, "none") != 0) {
+    pin_threads(opt.pin);
+  }
+  printf("%s:%d:main A is %ld x %ld, has %ld non-zeros and takes %ld bytes"
+         " (compression ratio %.3f to csr)\n",
          __FILE__, __LINE__,
-         (long)tA.M, (long)tA.N, (long)tA.nnz, sparse_size(A));
-  vec_t x = mk_vec_unit_random(N, rg);
-  vec_t y = mk_vec_zero(M);
-  real lambda = repeat_spmv(opt.algo, A, tA, x, y, repeat);
+         (long)A.M, (long)A.N, (long)A.nnz, sparse_size(A),
+         sparse_compression_ratio(A));
+  if (tA.format != sparse_format_invalid) {
+    printf("%s:%d:main tA is %ld x %ld, has %ld non-zeros and takes %ld bytes"
+           " (compression ratio %.3f to csr)\n",
+           __FILE__, __LINE__,
+           (long)tA.M, (long)tA.N, (long)tA.nnz, sparse_size(tA),
+           sparse_compression_ratio(tA));
+  }
+  /* the matrix may not be M x N when read from a file */
+  vec_t x = mk_vec_unit_random(A.N, rg);
+  vec_t y = mk_vec_zero(A.M);
+  idx_t * row_perm = 0;
+  idx_t * col_perm = 0;
+  real lambda_orig = 0.0;
+  double gflops_orig = 0.0;
+  if (opt.imbalance) {
+    thread_trace_start();
+  }
+  /* the roof kernels are compared with (--profile) */
+  double peak_bw = opt.peak_bw;
+  if (opt.profile && peak_bw == 0.0) {
+    long footprint = (long)(sparse_size(A) + sizeof(real) * (A.M + A.N));
+    if (tA.format != sparse_format_invalid && tA.format != sparse_format_csr_sym) {
+      footprint += (long)sparse_size(tA);
+    }
+    peak_bw = stream_triad_bw(footprint);
+  }
+  if (opt.reorder != reorder_kind_none) {
+    /* run in the original order to compare with */
+    vec_t xo = mk_vec_zero(A.N);
+    memcpy(xo.elems, x.elems, sizeof(real) * x.n);
+    numa_place(opt.numa, opt.algo, A, tA, xo, y);
+    spmv_prof_t * prof = (opt.profile ? mk_spmv_prof(opt.perf_events, repeat) : 0);
+    lambda_orig = (opt.fused
+                   ? repeat_spmv_fused(opt.algo, A, xo, y, repeat, prof, &gflops_orig)
+                   : repeat_spmv(opt.algo, A, tA, xo, y, repeat, opt.fused_norm, prof, &gflops_orig));
+    if (lambda_orig != -1.0) {
+      spmv_prof_report(prof, peak_bw);
+    }
+    spmv_prof_destroy(prof);
+    vec_destroy(xo);
+    /* A' = Pr A tPc, tA' = Pc tA tPr and x' = Pc x */
+    row_perm = (idx_t *)xalloc(sizeof(idx_t) * A.M);
+    col_perm = (idx_t *)xalloc(sizeof(idx_t) * A.N);
+    mk_reorder(A, opt.reorder, row_perm, col_perm);
+    if (A.format == sparse_format_csr_sym) {
+      /* P A tP stays symmetric; P A tQ (P != Q) does not */
+      memcpy(col_perm, row_perm, sizeof(idx_t) * A.M);
+    }
+    sparse_t B = sparse_permute(A, row_perm, col_perm);
+    sparse_destroy(A);
+    A = B;
+    if (tA.format != sparse_format_invalid) {
+      sparse_t tB = (A.format == sparse_format_csr_sym
+                     ? sparse_transpose(A)
+                     : sparse_permute(tA, col_perm, row_perm));
+      sparse_destroy(tA);
+      tA = tB;
+    }
+    vec_t xp = mk_vec_zero(A.N);
+    for (idx_t j = 0; j < A.N; j++) {
+      xp.elems[col_perm[j]] = x.elems[j];
+    }
+    vec_destroy(x);
+    x = xp;
+  }
+  /* repeat_spmv overwrites x; keep the start for the mixed run */
+  vec_t x0 = mk_vec_zero(opt.mixed ? A.N : 0);
+  memcpy(x0.elems, x.elems, sizeof(real) * x0.n);
+  double gflops = 0.0;
+  numa_place(opt.numa, opt.algo, A, tA, x, y);
+  if (opt.numa_report) {
+    numa_report(A, tA, x, y);
+  }
+  spmv_prof_t * prof = (opt.profile ? mk_spmv_prof(opt.perf_events, repeat) : 0);
+  real lambda = (opt.fused
+                 ? repeat_spmv_fused(opt.algo, A, x, y, repeat, prof, &gflops)
+                 : repeat_spmv(opt.algo, A, tA, x, y, repeat, opt.fused_norm, prof, &gflops));
+  if (lambda != -1.0) {
+    spmv_prof_report(prof, peak_bw);
+  }
+  spmv_prof_destroy(prof);
+  if (row_perm) {
+    /* bring x (the singular vector) back to the original order */
+    vec_t xo = mk_vec_zero(A.N);
+    for (idx_t j = 0; j < A.N; j++) {
+      xo.elems[j] = x.elems[col_perm[j]];
+    }
+    vec_destroy(x);
+    x = xo;
+    printf("reorder %s: %.6f -> %.6f GFLOPS (%.3f x), lambda %.9e -> %.9e\n",
+           reorder_kind_names[opt.reorder], gflops_orig, gflops,
+           (gflops_orig > 0.0 ? gflops / gflops_orig : 0.0),
+           lambda_orig, lambda);
+    xfree(row_perm);
+    xfree(col_perm);
+  }
   if (lambda == -1.0) {
     printf("an error ocurred during repeat_spmv\n");
-  } else {
+  } else if (opt.mixed) {
+    if (tA.format == sparse_format_invalid) {
+      tA = sparse_transpose(A);
+    }
+    real lambda_lo = repeat_spmv_mixed(opt.algo, A, tA, x0, repeat);
+    if (lambda_lo == -1.0) {
+      printf("an error ocurred during repeat_spmv_mixed\n");
+    } else {
+      printf("lambda (mixed) = %.9e (relative difference %.3e)\n",
+             lambda_lo, fabs(lambda_lo - lambda) / fabs(lambda));
+    }
+  }
+  if (lambda != -1.0 && opt.spmm) {
+    if (tA.format == sparse_format_invalid) {
+      tA = sparse_transpose(A);
+    }
+    real * lambdas = (real *)xalloc(sizeof(real) * opt.spmm);
+    real lambda_k = repeat_spmm(opt.algo, A, tA, opt.spmm, repeat, rg, lambdas);
+    if (lambda_k == -1.0) {
+      printf("an error ocurred during repeat_spmm\n");
+    } else {
+      for (int c = 0; c < opt.spmm; c++) {
+        printf("lambda (spmm) [%d] = %.9e\n", c, lambdas[c]);
+      }
+      printf("lambda (spmm) = %.9e (relative difference %.3e)\n",
+             lambda_k, fabs(lambda_k - lambda) / fabs(lambda));
+    }
+    xfree(lambdas);
+  }
+  thread_trace_report();
+  if (opt.imbalance_dump) {
+    thread_trace_dump(opt.imbalance_dump);
+  }
+  thread_trace_stop();
+  if (lambda != -1.0) {
     printf("lambda = %.9e\n", lambda);
   }
+  vec_destroy(x0);
   vec_destroy(x);
   vec_destroy(y);
   sparse_destroy(A);
-  sparse_destroy(tA);
+  if (tA.format != sparse_format_invalid) {
+    sparse_destroy(tA);
+  }
+  sparse_cache_close(cache);
   cmdline_options_destroy(opt);
   return 0;
 }